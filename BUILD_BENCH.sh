@@ -0,0 +1,13 @@
+gcc tools/BubbleBench.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleSoA.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp BubbleRaster.cpp BubbleSprites.cpp Renderer.cpp MonitorLayout.cpp CaptureSource.cpp ImageFile.cpp FrameStats.cpp -O2 -lm -lpthread -o BubbleBench
+gcc tools/CaptureBench.cpp CaptureSource.cpp ImageFile.cpp FrameStats.cpp -O2 -o CaptureBench
+gcc tools/BubbleReplay.cpp BubbleReplay.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o BubbleReplay
+gcc tools/RasterBench.cpp BubbleRaster.cpp BubbleSprites.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o RasterBench
+gcc tools/IdleBench.cpp IdleDetector.cpp -O2 -o IdleBench
+gcc tools/PacingBench.cpp FrameScheduler.cpp -O2 -o PacingBench
+gcc tools/PairBench.cpp BubblePairs.cpp BubblePhysics.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o PairBench
+gcc tools/ConfigBench.cpp Config.cpp FrameStats.cpp -O2 -lpthread -o ConfigBench
+gcc tools/FieldBench.cpp BackgroundField.cpp BubblePhysics.cpp BubblePairs.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp BubbleRaster.cpp BubbleSprites.cpp Renderer.cpp CaptureSource.cpp ImageFile.cpp FrameStats.cpp -O2 -lm -lpthread -o FieldBench
+gcc tools/AllocBench.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp BubbleRaster.cpp BubbleSprites.cpp Renderer.cpp CaptureSource.cpp ImageFile.cpp FrameStats.cpp -O2 -lm -lpthread -o AllocBench
+gcc tools/GridCheck.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o GridCheck
+gcc tools/ClockCheck.cpp SimClock.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o ClockCheck
+gcc tools/SweptCheck.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp FrameStats.cpp -O2 -lm -lpthread -o SweptCheck
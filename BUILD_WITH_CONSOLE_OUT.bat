@@ -1 +1 @@
-gcc HPBubbleScreensaver.cpp -mwindows -mconsole -o HPBubbleScreensaver.exe
\ No newline at end of file
+gcc HPBubbleScreensaver.cpp BubblePhysics.cpp BubblePairs.cpp BackgroundField.cpp BubbleGrid.cpp BubbleParallel.cpp FrameArena.cpp WorkPool.cpp SimClock.cpp TripleBuffer.cpp BubbleRaster.cpp BubbleSprites.cpp Renderer.cpp MonitorLayout.cpp IdleDetector.cpp FrameScheduler.cpp Config.cpp CaptureSource.cpp ImageFile.cpp FrameStats.cpp BubbleReplay.cpp -mwindows -ldwmapi -lwinmm -mconsole -o HPBubbleScreensaver.exe
\ No newline at end of file
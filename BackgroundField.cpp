@@ -0,0 +1,427 @@
+#include "BackgroundField.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BACKGROUND_FIELD_X86
+#include <immintrin.h>
+#endif
+
+// luminance weights (BT.601) out of 256, pixels are 0x00RRGGBB so in memory B, G, R, 0
+const int LUMA_B = 29;
+const int LUMA_G = 150;
+const int LUMA_R = 77;
+
+bool initBackgroundField(BACKGROUND_FIELD* f, int width, int height)
+{
+    memset(f, 0, sizeof(BACKGROUND_FIELD));
+    f->width = width;
+    f->height = height;
+    f->cols = (width + FIELD_CELL - 1) / FIELD_CELL;
+    f->rows = (height + FIELD_CELL - 1) / FIELD_CELL;
+    f->mode = FIELD_OFF;
+
+    int cells = f->cols * f->rows;
+    int tableSize = (f->cols + 1) * (f->rows + 1);
+    f->luminance = (unsigned char*) calloc(cells, 1);
+    f->edge = (unsigned char*) calloc(cells, 1);
+    f->solid = (unsigned char*) calloc(cells, 1);
+    f->changed = (unsigned char*) calloc(cells, 1);
+    f->solidCount = (int*) calloc(tableSize, sizeof(int));
+    f->solidX = (int*) calloc(tableSize, sizeof(int));
+    f->solidY = (int*) calloc(tableSize, sizeof(int));
+
+    if (!f->luminance || !f->edge || !f->solid || !f->changed || !f->solidCount || !f->solidX || !f->solidY) {
+        freeBackgroundField(f);
+        return false;
+    }
+    return true;
+}
+
+void freeBackgroundField(BACKGROUND_FIELD* f)
+{
+    free(f->luminance);
+    free(f->edge);
+    free(f->solid);
+    free(f->changed);
+    free(f->solidCount);
+    free(f->solidX);
+    free(f->solidY);
+    memset(f, 0, sizeof(BACKGROUND_FIELD));
+}
+
+void setBackgroundFieldMode(BACKGROUND_FIELD* f, FIELD_MODE mode, int edgeThreshold, int brightThreshold)
+{
+    if (mode == f->mode && edgeThreshold == f->edgeThreshold && brightThreshold == f->brightThreshold)
+        return;
+
+    f->mode = mode;
+    f->edgeThreshold = edgeThreshold;
+    f->brightThreshold = brightThreshold;
+    memset(f->changed, 1, f->cols * f->rows);
+}
+
+//=======================Scan kernels=====================
+// weighted luminance sum of n pixels, 256 times their summed luminance
+
+static unsigned int lumaSumScalar(const uint32_t* p, int n)
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t c = p[i];
+        sum += LUMA_B * (c & 0xff) + LUMA_G * ((c >> 8) & 0xff) + LUMA_R * ((c >> 16) & 0xff);
+    }
+    return sum;
+}
+
+#ifdef BACKGROUND_FIELD_X86
+// 4 pixels at a time widened to 16 bits, madd gives B * 29 + G * 150 and R * 77 + 0 per pixel
+__attribute__((target("sse2")))
+static unsigned int lumaSumSSE2(const uint32_t* p, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(LUMA_B, LUMA_G, LUMA_R, 0, LUMA_B, LUMA_G, LUMA_R, 0);
+
+    __m128i acc = zero;
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + k));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int) _mm_cvtsi128_si32(acc) + lumaSumScalar(p + k, n - k);
+}
+
+// the same 8 pixels at a time, unpacking within lanes doesn't matter for a sum
+__attribute__((target("avx2")))
+static unsigned int lumaSumAVX2(const uint32_t* p, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weights = _mm256_setr_epi16(LUMA_B, LUMA_G, LUMA_R, 0, LUMA_B, LUMA_G, LUMA_R, 0,
+        LUMA_B, LUMA_G, LUMA_R, 0, LUMA_B, LUMA_G, LUMA_R, 0);
+
+    __m256i acc = zero;
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + k));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), weights));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), weights));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int) _mm_cvtsi128_si32(half) + lumaSumScalar(p + k, n - k);
+}
+#endif
+
+enum { FIELD_KERNEL_UNKNOWN = -1 };
+static int fieldKernel = FIELD_KERNEL_UNKNOWN;
+
+static bool cpuRuns(FIELD_KERNEL kernel)
+{
+#ifdef BACKGROUND_FIELD_X86
+    __builtin_cpu_init();
+    if (kernel == FIELD_KERNEL_AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (kernel == FIELD_KERNEL_SSE2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return kernel == FIELD_KERNEL_SCALAR;
+}
+
+static void pickKernel()
+{
+    fieldKernel = FIELD_KERNEL_SCALAR;
+    if (cpuRuns(FIELD_KERNEL_AVX2))
+        fieldKernel = FIELD_KERNEL_AVX2;
+    else if (cpuRuns(FIELD_KERNEL_SSE2))
+        fieldKernel = FIELD_KERNEL_SSE2;
+}
+
+static unsigned int lumaSum(const uint32_t* p, int n)
+{
+#ifdef BACKGROUND_FIELD_X86
+    if (fieldKernel == FIELD_KERNEL_AVX2)
+        return lumaSumAVX2(p, n);
+    if (fieldKernel == FIELD_KERNEL_SSE2)
+        return lumaSumSSE2(p, n);
+#endif
+    return lumaSumScalar(p, n);
+}
+
+bool useFieldKernel(FIELD_KERNEL kernel)
+{
+    if (!cpuRuns(kernel))
+        return false;
+    fieldKernel = kernel;
+    return true;
+}
+
+const char* fieldKernelName()
+{
+    if (fieldKernel == FIELD_KERNEL_UNKNOWN)
+        pickKernel();
+
+    switch (fieldKernel) {
+    case FIELD_KERNEL_AVX2: return "avx2";
+    case FIELD_KERNEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+//=======================Scanning and rebuilding=====================
+
+// middle of cell c along an axis size pixels long (the last cell can be cut short)
+static int cellCentre(int c, int size)
+{
+    int end = (c + 1) * FIELD_CELL;
+    return (c * FIELD_CELL + (end < size ? end : size)) / 2;
+}
+
+int backgroundFieldScan(BACKGROUND_FIELD* f, const FRAMEBUFFER* fb, int originX, int originY, DIRTY_RECT rect)
+{
+    if (fieldKernel == FIELD_KERNEL_UNKNOWN)
+        pickKernel();
+
+    // the rect in world pixels, clipped to the frame and the world
+    int x0 = originX + (rect.left > 0 ? rect.left : 0);
+    int y0 = originY + (rect.top > 0 ? rect.top : 0);
+    int x1 = originX + (rect.right < fb->width ? rect.right : fb->width);
+    int y1 = originY + (rect.bottom < fb->height ? rect.bottom : fb->height);
+    if (x1 > f->width)
+        x1 = f->width;
+    if (y1 > f->height)
+        y1 = f->height;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    int scanned = 0;
+    int changed = 0;
+    for (int r = y0 / FIELD_CELL; r <= (y1 - 1) / FIELD_CELL; r++) {
+        // only the frame the cell's centre is in scans it
+        int cy = cellCentre(r, f->height) - originY;
+        if (cy < 0 || cy >= fb->height)
+            continue;
+        int py0 = r * FIELD_CELL - originY;
+        int py1 = py0 + FIELD_CELL;
+        py0 = py0 > 0 ? py0 : 0;
+        py1 = py1 < fb->height ? py1 : fb->height;
+        py1 = py1 < f->height - originY ? py1 : f->height - originY;
+
+        for (int c = x0 / FIELD_CELL; c <= (x1 - 1) / FIELD_CELL; c++) {
+            int cx = cellCentre(c, f->width) - originX;
+            if (cx < 0 || cx >= fb->width)
+                continue;
+            int px0 = c * FIELD_CELL - originX;
+            int px1 = px0 + FIELD_CELL;
+            px0 = px0 > 0 ? px0 : 0;
+            px1 = px1 < fb->width ? px1 : fb->width;
+            px1 = px1 < f->width - originX ? px1 : f->width - originX;
+
+            unsigned int sum = 0;
+            const uint32_t* row = fb->pixels + (size_t) py0 * fb->stride + px0;
+            for (int y = py0; y < py1; y++, row += fb->stride)
+                sum += lumaSum(row, px1 - px0);
+
+            // rounded mean
+            unsigned int pixels = (unsigned int) ((px1 - px0) * (py1 - py0)) * 256;
+            unsigned char luminance = (unsigned char) ((sum + pixels / 2) / pixels);
+
+            int i = r * f->cols + c;
+            scanned++;
+            if (luminance != f->luminance[i]) {
+                f->luminance[i] = luminance;
+                f->changed[i] = 1;
+                changed++;
+            }
+        }
+    }
+    // several scans can run at once
+    __atomic_add_fetch(&f->cellsScanned, scanned, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&f->cellsChanged, changed, __ATOMIC_RELAXED);
+    return changed;
+}
+
+static int cellEdge(const BACKGROUND_FIELD* f, int c, int r)
+{
+    int l = f->luminance[r * f->cols + c];
+    int edge = 0;
+    if (c > 0)
+        edge = abs(l - f->luminance[r * f->cols + c - 1]);
+    if (c + 1 < f->cols && abs(l - f->luminance[r * f->cols + c + 1]) > edge)
+        edge = abs(l - f->luminance[r * f->cols + c + 1]);
+    if (r > 0 && abs(l - f->luminance[(r - 1) * f->cols + c]) > edge)
+        edge = abs(l - f->luminance[(r - 1) * f->cols + c]);
+    if (r + 1 < f->rows && abs(l - f->luminance[(r + 1) * f->cols + c]) > edge)
+        edge = abs(l - f->luminance[(r + 1) * f->cols + c]);
+    return edge;
+}
+
+static bool cellSolid(const BACKGROUND_FIELD* f, int i)
+{
+    if (f->mode == FIELD_OFF)
+        return false;
+    if (f->edge[i] >= f->edgeThreshold)
+        return true;
+    return f->mode == FIELD_BRIGHT && f->luminance[i] >= f->brightThreshold;
+}
+
+// returns true if the cell's solidity flipped
+static bool updateCell(BACKGROUND_FIELD* f, int c, int r)
+{
+    int i = r * f->cols + c;
+    f->edge[i] = (unsigned char) cellEdge(f, c, r);
+    unsigned char solid = cellSolid(f, i);
+    if (solid == f->solid[i])
+        return false;
+    f->solid[i] = solid;
+    return true;
+}
+
+static void buildTables(BACKGROUND_FIELD* f)
+{
+    int stride = f->cols + 1;
+    for (int c = 0; c <= f->cols; c++)
+        f->solidCount[c] = f->solidX[c] = f->solidY[c] = 0;
+
+    for (int r = 0; r < f->rows; r++) {
+        int* count = f->solidCount + (r + 1) * stride;
+        int* sumX = f->solidX + (r + 1) * stride;
+        int* sumY = f->solidY + (r + 1) * stride;
+        count[0] = sumX[0] = sumY[0] = 0;
+
+        int rowCount = 0, rowX = 0, rowY = 0;
+        for (int c = 0; c < f->cols; c++) {
+            if (f->solid[r * f->cols + c]) {
+                rowCount++;
+                rowX += c;
+                rowY += r;
+            }
+            count[c + 1] = count[c + 1 - stride] + rowCount;
+            sumX[c + 1] = sumX[c + 1 - stride] + rowX;
+            sumY[c + 1] = sumY[c + 1 - stride] + rowY;
+        }
+    }
+}
+
+bool backgroundFieldRebuild(BACKGROUND_FIELD* f)
+{
+    bool flipped = false;
+    for (int r = 0; r < f->rows; r++) {
+        for (int c = 0; c < f->cols; c++) {
+            if (!f->changed[r * f->cols + c])
+                continue;
+            f->changed[r * f->cols + c] = 0;
+
+            // the neighbours' edges depend on this cell too
+            flipped |= updateCell(f, c, r);
+            if (c > 0)
+                flipped |= updateCell(f, c - 1, r);
+            if (c + 1 < f->cols)
+                flipped |= updateCell(f, c + 1, r);
+            if (r > 0)
+                flipped |= updateCell(f, c, r - 1);
+            if (r + 1 < f->rows)
+                flipped |= updateCell(f, c, r + 1);
+        }
+    }
+
+    if (!flipped)
+        return false;
+
+    buildTables(f);
+    f->version++;
+    f->rebuilds++;
+    return true;
+}
+
+void copyBackgroundField(BACKGROUND_FIELD* dst, const BACKGROUND_FIELD* src)
+{
+    size_t tableSize = sizeof(int) * (src->cols + 1) * (src->rows + 1);
+    memcpy(dst->solidCount, src->solidCount, tableSize);
+    memcpy(dst->solidX, src->solidX, tableSize);
+    memcpy(dst->solidY, src->solidY, tableSize);
+    dst->mode = src->mode;
+    dst->version = src->version;
+}
+
+//=======================Queries=====================
+
+int backgroundFieldSolid(const BACKGROUND_FIELD* f, int c0, int r0, int c1, int r1, int* sumX, int* sumY)
+{
+    c0 = c0 < 0 ? 0 : c0;
+    r0 = r0 < 0 ? 0 : r0;
+    c1 = c1 >= f->cols ? f->cols - 1 : c1;
+    r1 = r1 >= f->rows ? f->rows - 1 : r1;
+    if (c0 > c1 || r0 > r1) {
+        *sumX = *sumY = 0;
+        return 0;
+    }
+
+    // inclusive cells to the table's exclusive corners
+    int stride = f->cols + 1;
+    int a = r0 * stride + c0;
+    int b = r0 * stride + c1 + 1;
+    int c = (r1 + 1) * stride + c0;
+    int d = (r1 + 1) * stride + c1 + 1;
+    *sumX = f->solidX[d] - f->solidX[b] - f->solidX[c] + f->solidX[a];
+    *sumY = f->solidY[d] - f->solidY[b] - f->solidY[c] + f->solidY[a];
+    return f->solidCount[d] - f->solidCount[b] - f->solidCount[c] + f->solidCount[a];
+}
+
+bool backgroundFieldContact(const BACKGROUND_FIELD* f, float x, float y, float r, float* nx, float* ny)
+{
+    float half = r * FIELD_CONTACT_SCALE;
+    int sumX, sumY;
+    int count = backgroundFieldSolid(f,
+        (int) floorf((x - half) / FIELD_CELL), (int) floorf((y - half) / FIELD_CELL),
+        (int) floorf((x + half) / FIELD_CELL), (int) floorf((y + half) / FIELD_CELL), &sumX, &sumY);
+    if (count == 0)
+        return false;
+
+    // middle of the solid cells in pixels
+    float mx = ((float) sumX / count + 0.5f) * FIELD_CELL;
+    float my = ((float) sumY / count + 0.5f) * FIELD_CELL;
+    float dx = x - mx;
+    float dy = y - my;
+    float length = sqrtf(dx * dx + dy * dy);
+
+    // solid all around, or too evenly spread to tell which side it's on
+    if (length < half * 0.25f) {
+        *nx = *ny = 0;
+        return true;
+    }
+    *nx = dx / length;
+    *ny = dy / length;
+    return true;
+}
+
+bool parseFieldMode(const char* name, FIELD_MODE* out)
+{
+    if (!strcmp(name, "off"))
+        *out = FIELD_OFF;
+    else if (!strcmp(name, "edges"))
+        *out = FIELD_EDGES;
+    else if (!strcmp(name, "bright"))
+        *out = FIELD_BRIGHT;
+    else
+        return false;
+    return true;
+}
+
+const char* fieldModeName(FIELD_MODE mode)
+{
+    switch (mode) {
+    case FIELD_EDGES: return "edges";
+    case FIELD_BRIGHT: return "bright";
+    default: return "off";
+    }
+}
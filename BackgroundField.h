@@ -0,0 +1,103 @@
+#ifndef BACKGROUND_FIELD_H
+#define BACKGROUND_FIELD_H
+
+// low resolution map of the desktop behind the bubbles, so they can bounce
+// off window edges and bright parts of the screen
+//
+// the world is cut into FIELD_CELL x FIELD_CELL pixel cells. scanning a
+// captured frame works out each cell's mean luminance (SSE2 / AVX2 integer
+// sums, the same bits as the scalar loop) and rebuilding gives each cell an
+// edge strength, its largest luminance step to a neighbouring cell. a cell is
+// solid when that edge is at least edgeThreshold (window borders, the taskbar)
+// or, with FIELD_BRIGHT, when the cell itself is at least brightThreshold.
+// solid cells are summed into summed area tables (how many, and their column
+// and row totals) so backgroundFieldContact finds out whether anything solid
+// is under a bubble, and which side it's on, in four lookups per table
+// whatever the bubble's size
+//
+// a scan looks at every cell overlapping the rect it's given. the frame
+// pipeline passes the whole frame, a desktop grab doesn't say what changed.
+// after that the update is incremental: only cells whose luminance actually
+// moved get their edges redone, and the tables are only rebuilt when a cell
+// turned solid or stopped being solid, so re-grabbing a desktop that didn't
+// change costs just the scan
+//
+// several frames can feed one field (one per monitor, see MonitorLayout.h),
+// each cell belongs to the frame its centre is in so those scans can run on
+// different threads. a cell across a seam that isn't on the cell grid is the
+// mean of just its own frame's pixels. rebuilding has to wait for all of them
+
+#include "BubbleRaster.h"
+
+const int FIELD_CELL = 16; // pixels per cell side
+
+enum FIELD_MODE {
+    FIELD_OFF,    // nothing is solid
+    FIELD_EDGES,  // cells with an edge through them are solid
+    FIELD_BRIGHT, // edges and bright cells are solid
+};
+
+struct BACKGROUND_FIELD {
+    int cols;
+    int rows;
+    int width;               // world size in pixels
+    int height;
+    FIELD_MODE mode;
+    int edgeThreshold;       // 0 - 255
+    int brightThreshold;     // 0 - 255
+    unsigned char* luminance; // mean of each cell, 0 - 255
+    unsigned char* edge;
+    unsigned char* solid;
+    unsigned char* changed;  // set by scans for rebuild
+    int* solidCount;         // summed area tables, (cols + 1) * (rows + 1) each
+    int* solidX;             // sum of the solid cells' columns
+    int* solidY;             // and rows
+    long long version;       // goes up every time the tables change
+    long long cellsScanned;
+    long long cellsChanged;  // scanned cells whose luminance moved
+    long long rebuilds;      // times the tables were rebuilt
+};
+
+// sized for a width x height world, every cell starts black and nothing is solid
+bool initBackgroundField(BACKGROUND_FIELD* f, int width, int height);
+void freeBackgroundField(BACKGROUND_FIELD* f);
+
+// changes what counts as solid, the next rebuild redoes every cell if it changed
+void setBackgroundFieldMode(BACKGROUND_FIELD* f, FIELD_MODE mode, int edgeThreshold, int brightThreshold);
+
+// downsamples the cells overlapping rect of fb (frame coordinates, the frame's
+// top left is at (originX, originY) in the world) whose centres are inside fb
+// returns how many of them changed
+int backgroundFieldScan(BACKGROUND_FIELD* f, const FRAMEBUFFER* fb, int originX, int originY, DIRTY_RECT rect);
+
+// redoes the edges and solidity of the changed cells and their neighbours and
+// the tables if needed. returns true if the tables changed
+bool backgroundFieldRebuild(BACKGROUND_FIELD* f);
+
+// copies what backgroundFieldContact needs (for handing the field to another thread)
+// dst has to be initialized for the same size
+void copyBackgroundField(BACKGROUND_FIELD* dst, const BACKGROUND_FIELD* src);
+
+// a circle is treated as the square with the same area around it
+const float FIELD_CONTACT_SCALE = 0.886f; // half the square's side over the radius, sqrt(pi) / 2
+
+// true if any solid cell is under a bubble of radius r at (x, y). (*nx, *ny)
+// is then the unit vector from the middle of those cells towards (x, y), or
+// (0, 0) when they're all around it and there's no way out to point at
+bool backgroundFieldContact(const BACKGROUND_FIELD* f, float x, float y, float r, float* nx, float* ny);
+
+// totals of the solid cells in columns c0 - c1 and rows r0 - r1 (inclusive, clamped)
+int backgroundFieldSolid(const BACKGROUND_FIELD* f, int c0, int r0, int c1, int r1, int* sumX, int* sumY);
+
+enum FIELD_KERNEL { FIELD_KERNEL_SCALAR, FIELD_KERNEL_SSE2, FIELD_KERNEL_AVX2 };
+
+// forces the scan kernel (for benchmarks), false if this cpu can't run it
+bool useFieldKernel(FIELD_KERNEL kernel);
+// which kernel the scan picked for this cpu ("avx2", "sse2" or "scalar")
+const char* fieldKernelName();
+
+// "off", "edges" or "bright", false for anything else
+bool parseFieldMode(const char* name, FIELD_MODE* out);
+const char* fieldModeName(FIELD_MODE mode);
+
+#endif
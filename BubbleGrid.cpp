@@ -0,0 +1,253 @@
+#include "BubbleGrid.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+// the finest level never gets more cells than this, however small the smallest bubble
+static int maxFineCells(int capacity)
+{
+    int cells = capacity * 16;
+    return cells > 65536 ? cells : 65536;
+}
+
+static int gridCol(const GRID_LEVEL* level, float x)
+{
+    int c = (int) floorf(x / level->cellSize);
+    if (c < 0) return 0;
+    if (c >= level->cols) return level->cols - 1;
+    return c;
+}
+
+static int gridRow(const GRID_LEVEL* level, float y)
+{
+    int r = (int) floorf(y / level->cellSize);
+    if (r < 0) return 0;
+    if (r >= level->rows) return level->rows - 1;
+    return r;
+}
+
+static void setLevelSize(GRID_LEVEL* level, float cellSize, int width, int height)
+{
+    level->cellSize = cellSize;
+    // positions outside the screen are clamped into the edge cells
+    level->cols = (int) ceilf(width / cellSize) + 1;
+    level->rows = (int) ceilf(height / cellSize) + 1;
+}
+
+bool initBubbleGrid(BUBBLE_GRID* g, float minRadius, float maxRadius, int width, int height, int capacity)
+{
+    if (maxRadius < 1)
+        maxRadius = 1;
+    if (minRadius < 1)
+        minRadius = 1;
+    if (minRadius > maxRadius)
+        minRadius = maxRadius;
+
+    // cells double in size from the smallest bubble's until they fit the biggest
+    GRID_LEVEL finest = {};
+    setLevelSize(&finest, 2 * minRadius, width, height);
+    while (finest.cellSize < 2 * maxRadius && (long long) finest.cols * finest.rows > maxFineCells(capacity))
+        setLevelSize(&finest, finest.cellSize * 2, width, height);
+
+    g->numLevels = 0;
+    int cells = 0;
+    float cellSize = finest.cellSize;
+    while (g->numLevels < MAX_GRID_LEVELS) {
+        GRID_LEVEL* level = &g->levels[g->numLevels++];
+        setLevelSize(level, cellSize, width, height);
+        level->maxRadius = 0;
+        level->firstCell = cells;
+        level->count = 0;
+        cells += level->cols * level->rows;
+        if (cellSize >= 2 * maxRadius)
+            break;
+        cellSize *= 2;
+    }
+    g->capacity = capacity;
+
+    g->cellHead = (int*) malloc(sizeof(int) * cells);
+    g->next = (int*) malloc(sizeof(int) * capacity);
+    g->prev = (int*) malloc(sizeof(int) * capacity);
+    g->cellOf = (int*) malloc(sizeof(int) * capacity);
+    g->levelOf = (unsigned char*) malloc(capacity);
+
+    if (!g->cellHead || !g->next || !g->prev || !g->cellOf || !g->levelOf) {
+        freeBubbleGrid(g);
+        return false;
+    }
+
+    clearBubbleGrid(g);
+    return true;
+}
+
+void freeBubbleGrid(BUBBLE_GRID* g)
+{
+    free(g->cellHead);
+    free(g->next);
+    free(g->prev);
+    free(g->cellOf);
+    free(g->levelOf);
+    g->cellHead = g->next = g->prev = g->cellOf = NULL;
+    g->levelOf = NULL;
+    g->capacity = 0;
+    g->numLevels = 0;
+}
+
+void clearBubbleGrid(BUBBLE_GRID* g)
+{
+    if (g->numLevels == 0)
+        return;
+
+    const GRID_LEVEL* top = &g->levels[g->numLevels - 1];
+    for (int i = 0; i < top->firstCell + top->cols * top->rows; i++)
+        g->cellHead[i] = -1;
+
+    for (int l = 0; l < g->numLevels; l++) {
+        g->levels[l].count = 0;
+        g->levels[l].maxRadius = 0;
+    }
+
+    for (int i = 0; i < g->capacity; i++) {
+        g->next[i] = -1;
+        g->prev[i] = -1;
+        g->cellOf[i] = -1;
+        g->levelOf[i] = 0;
+    }
+}
+
+int bubbleGridLevelFor(const BUBBLE_GRID* g, float r)
+{
+    for (int l = 0; l < g->numLevels - 1; l++) {
+        if (g->levels[l].cellSize >= 2 * r)
+            return l;
+    }
+    return g->numLevels - 1;
+}
+
+static int cellAt(const BUBBLE_GRID* g, int l, float x, float y)
+{
+    const GRID_LEVEL* level = &g->levels[l];
+    return level->firstCell + gridRow(level, y) * level->cols + gridCol(level, x);
+}
+
+static void linkIntoCell(BUBBLE_GRID* g, int index, int cell)
+{
+    int head = g->cellHead[cell];
+    g->prev[index] = -1;
+    g->next[index] = head;
+    if (head != -1)
+        g->prev[head] = index;
+    g->cellHead[cell] = index;
+    g->cellOf[index] = cell;
+}
+
+static void unlinkFromCell(BUBBLE_GRID* g, int index)
+{
+    int cell = g->cellOf[index];
+
+    if (g->prev[index] != -1)
+        g->next[g->prev[index]] = g->next[index];
+    else
+        g->cellHead[cell] = g->next[index];
+
+    if (g->next[index] != -1)
+        g->prev[g->next[index]] = g->prev[index];
+
+    g->next[index] = -1;
+    g->prev[index] = -1;
+    g->cellOf[index] = -1;
+}
+
+void bubbleGridInsert(BUBBLE_GRID* g, int index, float x, float y, float r)
+{
+    int l = bubbleGridLevelFor(g, r);
+    GRID_LEVEL* level = &g->levels[l];
+    // never shrinks, a level's reach only has to be big enough
+    if (r > level->maxRadius)
+        level->maxRadius = r;
+    level->count++;
+    g->levelOf[index] = (unsigned char) l;
+    linkIntoCell(g, index, cellAt(g, l, x, y));
+}
+
+void bubbleGridRemove(BUBBLE_GRID* g, int index)
+{
+    if (g->cellOf[index] == -1)
+        return;
+
+    g->levels[g->levelOf[index]].count--;
+    unlinkFromCell(g, index);
+}
+
+void bubbleGridMove(BUBBLE_GRID* g, int index, float x, float y)
+{
+    int cell = cellAt(g, g->levelOf[index], x, y);
+    if (cell == g->cellOf[index])
+        return;
+
+    unlinkFromCell(g, index);
+    linkIntoCell(g, index, cell);
+}
+
+void bubbleGridCellRange(const BUBBLE_GRID* g, int l, float x, float y, float reach, int* c0, int* r0, int* c1, int* r1)
+{
+    const GRID_LEVEL* level = &g->levels[l];
+    reach += level->maxRadius;
+    *c0 = gridCol(level, x - reach);
+    *c1 = gridCol(level, x + reach);
+    *r0 = gridRow(level, y - reach);
+    *r1 = gridRow(level, y + reach);
+}
+
+int bubbleGridQueryLevel(const BUBBLE_GRID* g, int l, float x, float y, float reach, int* out, int count)
+{
+    const GRID_LEVEL* level = &g->levels[l];
+    if (level->count == 0)
+        return count;
+
+    int c0, r0, c1, r1;
+    bubbleGridCellRange(g, l, x, y, reach, &c0, &r0, &c1, &r1);
+    for (int r = r0; r <= r1; r++) {
+        const int* row = g->cellHead + level->firstCell + r * level->cols;
+        for (int c = c0; c <= c1; c++) {
+            for (int i = row[c]; i != -1; i = g->next[i])
+                out[count++] = i;
+        }
+    }
+    return count;
+}
+
+int bubbleGridQuery(const BUBBLE_GRID* g, float x, float y, float reach, int* out)
+{
+    int count = 0;
+    for (int l = 0; l < g->numLevels; l++)
+        count = bubbleGridQueryLevel(g, l, x, y, reach, out, count);
+    sortGridCandidates(out, count);
+    return count;
+}
+
+static int compareInts(const void* a, const void* b)
+{
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+void sortGridCandidates(int* out, int count)
+{
+    // a big bubble's query picks up every small one it covers
+    if (count > 32) {
+        qsort(out, count, sizeof(int), compareInts);
+        return;
+    }
+
+    for (int k = 1; k < count; k++) {
+        int i = out[k];
+        int j = k;
+        while (j > 0 && out[j - 1] > i) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = i;
+    }
+}
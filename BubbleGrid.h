@@ -0,0 +1,68 @@
+#ifndef BUBBLE_GRID_H
+#define BUBBLE_GRID_H
+
+// hierarchical uniform grid broad phase for bubble collisions
+// each cell holds a doubly linked list of bubble indices so a bubble
+// can be moved between cells in O(1) whenever its position changes
+//
+// a single grid has to size its cells for the biggest bubble, and with
+// foam next to huge bubbles every cell then holds hundreds of tiny ones.
+// so there's a stack of grids (levels), each with cells twice as wide as
+// the one below, and every bubble lives in the first level whose cells are
+// at least as wide as it is. a query looks at each level with its reach
+// grown by that level's biggest bubble, so it only ever visits a few cells
+// per level. with every bubble the same size there's one level, which is
+// exactly the old single grid
+const int MAX_GRID_LEVELS = 12;
+
+struct GRID_LEVEL {
+    float cellSize;
+    float maxRadius; // largest bubble radius stored in this level so far
+    int cols;
+    int rows;
+    int firstCell;   // this level's cells start at cellHead[firstCell]
+    int count;       // bubbles stored in this level
+};
+
+struct BUBBLE_GRID {
+    int numLevels;
+    GRID_LEVEL levels[MAX_GRID_LEVELS];
+    int capacity;    // number of bubbles the per-bubble arrays can hold
+    int* cellHead;   // first bubble in each cell (every level's, back to back), -1 if empty
+    int* next;       // next bubble in the same cell, -1 at end of list
+    int* prev;       // previous bubble in the same cell, -1 at head of list
+    int* cellOf;     // cell each bubble currently lives in, -1 if not inserted
+    unsigned char* levelOf; // level each bubble lives in
+};
+
+// the finest cells are 2 * minRadius and the coarsest at least 2 * maxRadius,
+// so a contact between two bubbles of one level only spans neighbouring cells
+// (pass the same radius twice for one level). bubbles outside that range still
+// work, they just go in the first or last level
+bool initBubbleGrid(BUBBLE_GRID* g, float minRadius, float maxRadius, int width, int height, int capacity);
+void freeBubbleGrid(BUBBLE_GRID* g);
+void clearBubbleGrid(BUBBLE_GRID* g);
+
+// level a bubble of radius r goes in
+int bubbleGridLevelFor(const BUBBLE_GRID* g, float r);
+
+void bubbleGridInsert(BUBBLE_GRID* g, int index, float x, float y, float r);
+void bubbleGridRemove(BUBBLE_GRID* g, int index);
+// relinks bubble only if it crossed into another cell
+void bubbleGridMove(BUBBLE_GRID* g, int index, float x, float y);
+
+// column and row range of level's cells that can hold a bubble touching
+// a circle of radius reach at (x, y)
+void bubbleGridCellRange(const BUBBLE_GRID* g, int level, float x, float y, float reach, int* c0, int* r0, int* c1, int* r1);
+
+// appends every bubble index in level that could touch a circle of radius reach
+// at (x, y) to out[count...] (unsorted) and returns the new count
+int bubbleGridQueryLevel(const BUBBLE_GRID* g, int level, float x, float y, float reach, int* out, int count);
+
+// the same over every level, sorted ascending so callers visit candidates in array order
+int bubbleGridQuery(const BUBBLE_GRID* g, float x, float y, float reach, int* out);
+
+// sorts a candidate list ascending
+void sortGridCandidates(int* out, int count);
+
+#endif
@@ -0,0 +1,141 @@
+#include "BubblePairs.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BUBBLE_PAIRS_X86
+#include <immintrin.h>
+#endif
+
+static unsigned int pairTestScalar(const BUBBLE* bubbles, const int* candidates, int begin, int count, float x, float y, float reach)
+{
+    unsigned int mask = 0;
+    for (int k = begin; k < count; k++) {
+        const BUBBLE* o = &bubbles[candidates[k]];
+        float dx = x - o->x;
+        float dy = y - o->y;
+        float r = reach + o->r;
+        if (dx * dx + dy * dy <= r * r * PAIR_TEST_MARGIN)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+#ifdef BUBBLE_PAIRS_X86
+// no gather before AVX2, the candidates are copied out 4 at a time
+__attribute__((target("sse2")))
+static unsigned int pairTestSSE2(const BUBBLE* bubbles, const int* candidates, int count, float x, float y, float reach)
+{
+    const __m128 px = _mm_set1_ps(x);
+    const __m128 py = _mm_set1_ps(y);
+    const __m128 pr = _mm_set1_ps(reach);
+    const __m128 margin = _mm_set1_ps(PAIR_TEST_MARGIN);
+
+    unsigned int mask = 0;
+    int n = count & ~3;
+    for (int k = 0; k < n; k += 4) {
+        const BUBBLE* a = &bubbles[candidates[k]];
+        const BUBBLE* b = &bubbles[candidates[k + 1]];
+        const BUBBLE* c = &bubbles[candidates[k + 2]];
+        const BUBBLE* d = &bubbles[candidates[k + 3]];
+        __m128 dx = _mm_sub_ps(px, _mm_setr_ps(a->x, b->x, c->x, d->x));
+        __m128 dy = _mm_sub_ps(py, _mm_setr_ps(a->y, b->y, c->y, d->y));
+        __m128 r = _mm_add_ps(pr, _mm_setr_ps(a->r, b->r, c->r, d->r));
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 near = _mm_cmple_ps(d2, _mm_mul_ps(_mm_mul_ps(r, r), margin));
+        mask |= (unsigned int) _mm_movemask_ps(near) << k;
+    }
+    return mask | pairTestScalar(bubbles, candidates, n, count, x, y, reach);
+}
+
+// x, y and r are gathered straight out of the BUBBLE array
+__attribute__((target("avx2")))
+static unsigned int pairTestAVX2(const BUBBLE* bubbles, const int* candidates, int count, float x, float y, float reach)
+{
+    const __m256 px = _mm256_set1_ps(x);
+    const __m256 py = _mm256_set1_ps(y);
+    const __m256 pr = _mm256_set1_ps(reach);
+    const __m256 margin = _mm256_set1_ps(PAIR_TEST_MARGIN);
+    const __m256i stride = _mm256_set1_epi32(sizeof(BUBBLE) / sizeof(float));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const float* base = (const float*) bubbles;
+
+    unsigned int mask = 0;
+    for (int k = 0; k < count; k += 8) {
+        // lanes past the end load index 0, a real bubble, and are masked off below
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - k), lanes);
+        __m256i index = _mm256_mullo_epi32(_mm256_maskload_epi32(candidates + k, valid), stride);
+
+        __m256 ox = _mm256_i32gather_ps(base + offsetof(BUBBLE, x) / sizeof(float), index, 4);
+        __m256 oy = _mm256_i32gather_ps(base + offsetof(BUBBLE, y) / sizeof(float), index, 4);
+        __m256 or_ = _mm256_i32gather_ps(base + offsetof(BUBBLE, r) / sizeof(float), index, 4);
+
+        __m256 dx = _mm256_sub_ps(px, ox);
+        __m256 dy = _mm256_sub_ps(py, oy);
+        __m256 r = _mm256_add_ps(pr, or_);
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 near = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(_mm256_mul_ps(r, r), margin), _CMP_LE_OQ),
+            _mm256_castsi256_ps(valid));
+        mask |= (unsigned int) _mm256_movemask_ps(near) << k;
+    }
+    return mask;
+}
+#endif
+
+enum { PAIR_KERNEL_UNKNOWN = -1 };
+static int pairKernel = PAIR_KERNEL_UNKNOWN;
+
+static bool cpuRuns(PAIR_KERNEL kernel)
+{
+#ifdef BUBBLE_PAIRS_X86
+    __builtin_cpu_init();
+    if (kernel == PAIR_KERNEL_AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (kernel == PAIR_KERNEL_SSE2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return kernel == PAIR_KERNEL_SCALAR;
+}
+
+static void pickKernel()
+{
+    pairKernel = PAIR_KERNEL_SCALAR;
+    if (cpuRuns(PAIR_KERNEL_AVX2))
+        pairKernel = PAIR_KERNEL_AVX2;
+    else if (cpuRuns(PAIR_KERNEL_SSE2))
+        pairKernel = PAIR_KERNEL_SSE2;
+}
+
+unsigned int pairTestBlock(const BUBBLE* bubbles, const int* candidates, int count, float x, float y, float reach)
+{
+    if (pairKernel == PAIR_KERNEL_UNKNOWN)
+        pickKernel();
+
+#ifdef BUBBLE_PAIRS_X86
+    if (pairKernel == PAIR_KERNEL_AVX2)
+        return pairTestAVX2(bubbles, candidates, count, x, y, reach);
+    if (pairKernel == PAIR_KERNEL_SSE2)
+        return pairTestSSE2(bubbles, candidates, count, x, y, reach);
+#endif
+    return pairTestScalar(bubbles, candidates, 0, count, x, y, reach);
+}
+
+bool usePairKernel(PAIR_KERNEL kernel)
+{
+    if (!cpuRuns(kernel))
+        return false;
+    pairKernel = kernel;
+    return true;
+}
+
+const char* pairKernelName()
+{
+    if (pairKernel == PAIR_KERNEL_UNKNOWN)
+        pickKernel();
+
+    switch (pairKernel) {
+    case PAIR_KERNEL_AVX2: return "avx2";
+    case PAIR_KERNEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef BUBBLE_PAIRS_H
+#define BUBBLE_PAIRS_H
+
+// batched narrow phase filter for collisionCheck
+// the exact contact tests take square roots (in double, to keep the original
+// response's results), but nearly every candidate the grid hands back is too
+// far away to touch. pairTestBlock rules those out a block at a time with a
+// squared distance test on 4 (SSE2) or 8 (AVX2) candidates at once, so only
+// pairs that can touch go on to the exact test. the test is widened by
+// PAIR_TEST_MARGIN, float rounding can only let a far pair through, never
+// drop a touching one, so results are bit for bit the same as without it
+
+#include "BubblePhysics.h"
+
+const int PAIR_BLOCK = 32; // most candidates per pairTestBlock call, one bit each in its result
+const int PAIR_BLOCK_MIN = 8;  // fewer candidates than this are cheaper to test one by one
+const float PAIR_TEST_MARGIN = 1.0001f; // squared reach is scaled up by this much
+
+enum PAIR_KERNEL { PAIR_KERNEL_SCALAR, PAIR_KERNEL_SSE2, PAIR_KERNEL_AVX2 };
+
+// bit k is set when bubbles[candidates[k]] may be within reach plus its own radius
+// of (x, y), count is at most PAIR_BLOCK
+unsigned int pairTestBlock(const BUBBLE* bubbles, const int* candidates, int count, float x, float y, float reach);
+
+// forces a kernel (for benchmarks), false if this cpu can't run it
+bool usePairKernel(PAIR_KERNEL kernel);
+
+// which kernel pairTestBlock picked for this cpu ("avx2", "sse2" or "scalar")
+const char* pairKernelName();
+
+#endif
@@ -0,0 +1,393 @@
+#include "BubbleParallel.h"
+#include "BubblePhysics.h"
+#include "WorkPool.h"
+#include "FrameArena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+const int TILE_CELLS = 16; // tiles are TILE_CELLS x TILE_CELLS grid cells
+const int MAX_COLORS = 64; // one bit each in colorMask, pairs that don't fit go in a last batch on one thread
+
+struct CONTACT {
+    int a; // a < b
+    int b;
+};
+
+struct CONTACT_LIST {
+    int count;
+    int capacity;
+    CONTACT* contacts;
+    long long tested;
+};
+
+int parallelContacts;
+int parallelColors;
+
+static WORK_POOL pool;
+static unsigned long long* colorMask; // per bubble, colors already used by its pairs this step
+
+// everything below lives for one step. the tile lists are filled on the
+// workers, each from its own arena, the rest comes from stepArena
+static FRAME_ARENA stepArena;
+static FRAME_ARENA* workerArenas; // one per pool worker
+static size_t gatherPeak;         // most bytes the tile lists ever took in one step, all workers together
+
+static CONTACT_LIST* tiles;
+// awake bubbles bucketed by tile (in index order within a tile),
+// tile t's are tileBubbles[tileStart[t], tileStart[t + 1])
+static int* tileStart;
+static int* tileBubbles;
+
+// every tile's pairs back to back, then the same sorted by color
+static CONTACT* contacts;
+static CONTACT* colored;
+static unsigned char* contactColor;
+static int colorStart[MAX_COLORS + 2];
+
+bool initParallelPhysics(int threads)
+{
+    freeParallelPhysics();
+
+    colorMask = (unsigned long long*) calloc(bubbleCapacity, sizeof(unsigned long long));
+    if (!colorMask || !initWorkPool(&pool, threads)) {
+        freeParallelPhysics();
+        return false;
+    }
+
+    // a guess at a busy step (every bubble awake, about as many pairs as bubbles),
+    // the resets grow them if it's wrong
+    size_t perBubble = sizeof(int) * 2 + sizeof(CONTACT) * 2 + 1;
+    workerArenas = (FRAME_ARENA*) calloc(pool.numWorkers, sizeof(FRAME_ARENA));
+    bool ok = workerArenas && initFrameArena(&stepArena, perBubble * bubbleCapacity);
+    for (int w = 0; ok && w < pool.numWorkers; w++)
+        ok = initFrameArena(&workerArenas[w], sizeof(CONTACT) * bubbleCapacity);
+    if (!ok) {
+        freeParallelPhysics();
+        return false;
+    }
+    return true;
+}
+
+void freeParallelPhysics()
+{
+    if (workerArenas) {
+        for (int w = 0; w < pool.numWorkers; w++)
+            freeFrameArena(&workerArenas[w]);
+    }
+    free(workerArenas);
+    freeFrameArena(&stepArena);
+    freeWorkPool(&pool);
+    free(colorMask);
+
+    workerArenas = NULL;
+    gatherPeak = 0;
+    colorMask = NULL;
+    tiles = NULL;
+    tileStart = tileBubbles = NULL;
+    contacts = colored = NULL;
+    contactColor = NULL;
+}
+
+size_t parallelArenaBytes()
+{
+    size_t bytes = frameArenaBytes(&stepArena);
+    for (int w = 0; workerArenas && w < pool.numWorkers; w++)
+        bytes += frameArenaBytes(&workerArenas[w]);
+    return bytes;
+}
+
+static void integrateRange(void* context, int begin, int end, int worker)
+{
+    for (int i = begin; i < end; i++) {
+        BUBBLE* b = &bubbles[i];
+        b->prevX = b->x;
+        b->prevY = b->y;
+        if (b->sleeping)
+            continue;
+
+        accelerateBubble(b);
+        b->x += b->xVel;
+        b->y += b->yVel;
+        wallCheck(b);
+    }
+}
+
+static void wallRange(void* context, int begin, int end, int worker)
+{
+    for (int i = begin; i < end; i++) {
+        if (bubbles[i].sleeping)
+            continue;
+        wallCheck(&bubbles[i]);
+        updateBubbleSleep(&bubbles[i]);
+    }
+}
+
+// a worker fills one tile at a time, so the list being filled is always the
+// newest thing in its arena and grows in place
+static void addContact(CONTACT_LIST* list, FRAME_ARENA* arena, int a, int b)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        CONTACT* grown = (CONTACT*) frameRealloc(arena, list->contacts,
+            sizeof(CONTACT) * list->capacity, sizeof(CONTACT) * capacity);
+        if (!grown)
+            return;
+        list->contacts = grown;
+        list->capacity = capacity;
+    }
+    list->contacts[list->count].a = a;
+    list->contacts[list->count].b = b;
+    list->count++;
+}
+
+// tiles are cut from the finest level's cells, a bubble in a coarser level
+// goes in the tile under its cell's top left corner
+static int tileOf(int index, int tilesAcross)
+{
+    const BUBBLE_GRID* g = &bubbleGrid;
+    int l = g->levelOf[index];
+    const GRID_LEVEL* level = &g->levels[l];
+    int cell = g->cellOf[index] - level->firstCell;
+    int r = (cell / level->cols) << l;
+    int c = (cell % level->cols) << l;
+    if (r >= g->levels[0].rows)
+        r = g->levels[0].rows - 1;
+    if (c >= g->levels[0].cols)
+        c = g->levels[0].cols - 1;
+    return r / TILE_CELLS * tilesAcross + c / TILE_CELLS;
+}
+
+// levels holding at least one sleeping bubble this step, a bit each
+static unsigned int sleepingLevels;
+
+// lists the overlapping pairs found from the awake bubbles in this tile, each pair
+// is found from one bubble only:
+//   same level: the lower index one, or the only awake one if the other sleeps
+//   different levels: the finer one, or the coarser one if the finer one sleeps
+// so a bubble looks through its own level and the coarser ones, and the finer
+// ones only for sleepers. each level is searched out to its own biggest radius
+static void gatherTile(int tile, FRAME_ARENA* arena)
+{
+    const BUBBLE_GRID* g = &bubbleGrid;
+
+    CONTACT_LIST* list = &tiles[tile];
+    list->count = 0;
+    list->capacity = 0;
+    list->contacts = NULL;
+    list->tested = 0;
+
+    // sleeping bubbles aren't in the tile lists, so sleeping pairs stay where they settled
+    for (int k = tileStart[tile]; k < tileStart[tile + 1]; k++) {
+        int i = tileBubbles[k];
+        const BUBBLE* b = &bubbles[i];
+        int own = g->levelOf[i];
+
+        for (int l = 0; l < g->numLevels; l++) {
+            const GRID_LEVEL* level = &g->levels[l];
+            bool finer = l < own;
+            if (level->count == 0 || (finer && !(sleepingLevels & (1u << l))))
+                continue;
+
+            int c0, r0, c1, r1;
+            bubbleGridCellRange(g, l, b->x, b->y, b->r, &c0, &r0, &c1, &r1);
+            for (int nr = r0; nr <= r1; nr++) {
+                const int* row = g->cellHead + level->firstCell + nr * level->cols;
+                for (int nc = c0; nc <= c1; nc++) {
+                    for (int j = row[nc]; j != -1; j = g->next[j]) {
+                        if (finer) {
+                            if (!bubbles[j].sleeping)
+                                continue;
+                        } else if (l == own) {
+                            if (j == i || (j < i && !bubbles[j].sleeping))
+                                continue;
+                        }
+
+                        list->tested++;
+                        float dx = b->x - bubbles[j].x;
+                        float dy = b->y - bubbles[j].y;
+                        float reach = b->r + bubbles[j].r;
+                        if (dx * dx + dy * dy < reach * reach)
+                            addContact(list, arena, i < j ? i : j, i < j ? j : i);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void gatherRange(void* context, int begin, int end, int worker)
+{
+    for (int t = begin; t < end; t++)
+        gatherTile(t, &workerArenas[worker]);
+}
+
+// pushes a pair apart by mass and bounces whichever of them is heading into the other
+static void resolveContact(BUBBLE* a, BUBBLE* b)
+{
+    if (impulseResponse) {
+        resolveImpulse(a, b);
+        return;
+    }
+
+    float normX = a->x - b->x;
+    float normY = a->y - b->y;
+    float dist = sqrtf(normX * normX + normY * normY);
+
+    // dead centre hits have no direction, pick one so they still separate
+    if (dist > 0) {
+        normX /= dist;
+        normY /= dist;
+    } else {
+        normX = 1;
+        normY = 0;
+    }
+
+    float depth = a->r + b->r - dist;
+    if (depth <= 0)
+        return;
+
+    wakeBubble(a);
+    wakeBubble(b);
+    float totalMass = a->mass + b->mass;
+    float aShare = totalMass > 0 ? b->mass / totalMass : 0.5f;
+    a->x += normX * depth * aShare;
+    a->y += normY * depth * aShare;
+    b->x -= normX * depth * (1 - aShare);
+    b->y -= normY * depth * (1 - aShare);
+
+    if (a->xVel * normX + a->yVel * normY < 0)
+        bounceOff(a, b, normX, normY);
+    if (b->xVel * normX + b->yVel * normY > 0)
+        bounceOff(b, a, -normX, -normY);
+}
+
+static void resolveRange(void* context, int begin, int end, int worker)
+{
+    const CONTACT* batch = (const CONTACT*) context;
+    for (int p = begin; p < end; p++)
+        resolveContact(&bubbles[batch[p].a], &bubbles[batch[p].b]);
+}
+
+// greedy coloring in list order, each pair takes the lowest color neither bubble has used
+static void colorContacts(int count)
+{
+    int colorCount[MAX_COLORS + 1] = {};
+
+    for (int p = 0; p < count; p++) {
+        unsigned long long used = colorMask[contacts[p].a] | colorMask[contacts[p].b];
+        int color = MAX_COLORS;
+        if (~used) {
+            color = __builtin_ctzll(~used);
+            colorMask[contacts[p].a] |= 1ULL << color;
+            colorMask[contacts[p].b] |= 1ULL << color;
+        }
+        contactColor[p] = (unsigned char) color;
+        colorCount[color]++;
+    }
+
+    colorStart[0] = 0;
+    for (int c = 0; c <= MAX_COLORS; c++)
+        colorStart[c + 1] = colorStart[c] + colorCount[c];
+
+    int fill[MAX_COLORS + 1];
+    memcpy(fill, colorStart, sizeof(fill));
+    for (int p = 0; p < count; p++) {
+        colored[fill[contactColor[p]]++] = contacts[p];
+        colorMask[contacts[p].a] = 0;
+        colorMask[contacts[p].b] = 0;
+    }
+}
+
+void stepBubblesParallel()
+{
+    frameArenaReset(&stepArena);
+    // which worker gets which tiles isn't fixed, so each one is kept big enough for all of them
+    for (int w = 0; w < pool.numWorkers; w++) {
+        frameArenaReset(&workerArenas[w]);
+        frameArenaReserve(&workerArenas[w], gatherPeak + gatherPeak / 4);
+    }
+
+    workPoolFor(&pool, numBubbles, 1024, integrateRange, NULL);
+    // the grid's lists aren't thread safe, relinking is cheap next to the rest
+    // (anything that moves a bubble wakes it, so sleeping ones can't have moved)
+    for (int i = 0; i < numBubbles; i++) {
+        if (!bubbles[i].sleeping)
+            bubbleGridMove(&bubbleGrid, i, bubbles[i].x, bubbles[i].y);
+    }
+
+    int tilesAcross = (bubbleGrid.levels[0].cols + TILE_CELLS - 1) / TILE_CELLS;
+    int tilesDown = (bubbleGrid.levels[0].rows + TILE_CELLS - 1) / TILE_CELLS;
+    int numTiles = tilesAcross * tilesDown;
+    tiles = (CONTACT_LIST*) frameAlloc(&stepArena, sizeof(CONTACT_LIST) * numTiles);
+    tileStart = (int*) frameAlloc(&stepArena, sizeof(int) * (numTiles + 1));
+    tileBubbles = (int*) frameAlloc(&stepArena, sizeof(int) * numBubbles);
+    if (!tiles || !tileStart || !tileBubbles)
+        return;
+
+    // counting sort of the awake bubbles by tile
+    memset(tileStart, 0, sizeof(int) * (numTiles + 1));
+    sleepingLevels = 0;
+    for (int i = 0; i < numBubbles; i++) {
+        if (!bubbles[i].sleeping)
+            tileStart[tileOf(i, tilesAcross) + 1]++;
+        else
+            sleepingLevels |= 1u << bubbleGrid.levelOf[i];
+    }
+    for (int t = 0; t < numTiles; t++)
+        tileStart[t + 1] += tileStart[t];
+    for (int i = 0; i < numBubbles; i++) {
+        if (!bubbles[i].sleeping)
+            tileBubbles[tileStart[tileOf(i, tilesAcross)]++] = i;
+    }
+    // the fill moved every start up to the next tile's, shift them back
+    for (int t = numTiles; t > 0; t--)
+        tileStart[t] = tileStart[t - 1];
+    tileStart[0] = 0;
+
+    workPoolFor(&pool, numTiles, 1, gatherRange, NULL);
+
+    int count = 0;
+    for (int t = 0; t < numTiles; t++) {
+        count += tiles[t].count;
+        collisionPairsTested += tiles[t].tested;
+    }
+    size_t gathered = 0;
+    for (int w = 0; w < pool.numWorkers; w++)
+        gathered += workerArenas[w].frameBytes;
+    if (gathered > gatherPeak)
+        gatherPeak = gathered;
+
+    contacts = (CONTACT*) frameAlloc(&stepArena, sizeof(CONTACT) * count);
+    colored = (CONTACT*) frameAlloc(&stepArena, sizeof(CONTACT) * count);
+    contactColor = (unsigned char*) frameAlloc(&stepArena, count);
+    if (!contacts || !colored || !contactColor)
+        return;
+
+    count = 0;
+    for (int t = 0; t < numTiles; t++) {
+        memcpy(contacts + count, tiles[t].contacts, sizeof(CONTACT) * tiles[t].count);
+        count += tiles[t].count;
+    }
+
+    colorContacts(count);
+    parallelContacts = count;
+    parallelColors = 0;
+
+    for (int c = 0; c < MAX_COLORS; c++) {
+        int n = colorStart[c + 1] - colorStart[c];
+        if (n > 0)
+            parallelColors = c + 1;
+        workPoolFor(&pool, n, 256, resolveRange, colored + colorStart[c]);
+    }
+    // pairs that ran out of colors, in order on this thread
+    resolveRange(colored + colorStart[MAX_COLORS], 0, colorStart[MAX_COLORS + 1] - colorStart[MAX_COLORS], 0);
+
+    // being pushed apart can shove a bubble through a wall
+    workPoolFor(&pool, numBubbles, 1024, wallRange, NULL);
+    for (int i = 0; i < numBubbles; i++) {
+        if (!bubbles[i].sleeping)
+            bubbleGridMove(&bubbleGrid, i, bubbles[i].x, bubbles[i].y);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef BUBBLE_PARALLEL_H
+#define BUBBLE_PARALLEL_H
+
+// multithreaded bubble step
+//
+// the sequential collisionCheck moves each bubble as soon as it hits something,
+// so its result depends on the order bubbles are visited in. this step splits
+// the work into phases that only ever write data owned by one task:
+//   1. every awake bubble moves and bounces off the walls (split by bubble)
+//   2. the grid's finest level is cut into tiles and each tile lists the overlapping pairs
+//      whose first bubble lives in it (split by tile)
+//   3. the pairs are greedily colored so no bubble appears twice in a color
+//   4. one color at a time, every pair in it is pushed apart and bounced (split by pair)
+// tiles are concatenated in order and the coloring runs on one thread, so the
+// result is the same bit for bit whatever the thread count
+//
+// the step's scratch (tile lists, contacts, colors) comes from frame arenas
+// (FrameArena.h) that start over every step, so once they've grown to the
+// busiest step the step doesn't allocate
+
+#include <stddef.h>
+
+// threads <= 0 means one per core, sizes everything for bubbleCapacity
+// call after allocateBubbles
+bool initParallelPhysics(int threads);
+void freeParallelPhysics();
+
+void stepBubblesParallel();
+
+// memory the step's arenas hold
+size_t parallelArenaBytes();
+
+// pairs pushed apart in the last step and the colors that took
+extern int parallelContacts;
+extern int parallelColors;
+
+#endif
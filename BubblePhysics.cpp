@@ -0,0 +1,726 @@
+#include "BubblePhysics.h"
+#include "BubbleParallel.h"
+#include "BubblePairs.h"
+#include "BackgroundField.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+int BUBBLE_RADIUS = 120;
+BUBBLE* bubbles;
+int numBubbles;
+int bubbleCapacity;
+int worldWidth, worldHeight;
+BUBBLE_GRID bubbleGrid;
+long long collisionPairsTested;
+
+static int* gridCandidates;
+
+// slot map from handles to positions in the packed bubbles array
+static int* slotIndex;  // handle -> index into bubbles, -1 if the slot is free
+static int* indexSlot;  // index into bubbles -> handle
+static int* freeSlots;  // stack of unused handles
+static int numFreeSlots;
+
+static unsigned int randomState = 1;
+
+void seedBubbleRandom(unsigned int seed)
+{
+    // xorshift gets stuck on 0
+    randomState = seed ? seed : 1;
+}
+
+// xorshift32
+unsigned int bubbleRandom()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+int scaledBubbleRadius(int width, int height, int count)
+{
+    int r = (int) ((long long) width * height / ((long long) count * 1000));
+    return r > 0 ? r : 1;
+}
+
+RADIUS_DISTRIBUTION radiusDistribution = RADIUS_FIXED;
+float minBubbleRadius = 12;
+float maxBubbleRadius = 1200;
+bool hierarchicalGrid = true;
+
+// uniform float in [0, 1)
+static float randomUnit()
+{
+    return (bubbleRandom() >> 8) / 16777216.0f;
+}
+
+float randomBubbleRadius()
+{
+    float lo = minBubbleRadius;
+    float hi = maxBubbleRadius > lo ? maxBubbleRadius : lo;
+    float u;
+
+    switch (radiusDistribution) {
+    case RADIUS_UNIFORM:
+        return lo + (hi - lo) * randomUnit();
+    case RADIUS_POWER_LAW:
+        // inverse of the cdf for a density proportional to 1 / r^2 on [lo, hi]
+        u = randomUnit();
+        return 1 / (1 / lo - u * (1 / lo - 1 / hi));
+    case RADIUS_BIMODAL:
+        u = randomUnit();
+        if (u < 0.9f)
+            return lo + lo * (u / 0.9f);
+        return hi / 2 + hi / 2 * ((u - 0.9f) / 0.1f);
+    default:
+        return BUBBLE_RADIUS;
+    }
+}
+
+float bubbleMassFor(float r)
+{
+    float scale = r / BUBBLE_RADIUS;
+    return 10 * scale * scale;
+}
+
+static const char* radiusDistributionNames[] = { "fixed", "uniform", "power-law", "bimodal" };
+
+bool parseRadiusDistribution(const char* name, RADIUS_DISTRIBUTION* out)
+{
+    for (int i = 0; i < (int) (sizeof(radiusDistributionNames) / sizeof(radiusDistributionNames[0])); i++) {
+        if (!strcmp(name, radiusDistributionNames[i])) {
+            *out = (RADIUS_DISTRIBUTION) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* radiusDistributionName(RADIUS_DISTRIBUTION d)
+{
+    return radiusDistributionNames[d];
+}
+
+bool allocateBubbles(int capacity)
+{
+    free(bubbles);
+    free(gridCandidates);
+    free(slotIndex);
+    free(indexSlot);
+    free(freeSlots);
+
+    bubbles = (BUBBLE*) calloc(capacity, sizeof(BUBBLE));
+    gridCandidates = (int*) malloc(sizeof(int) * capacity);
+    slotIndex = (int*) malloc(sizeof(int) * capacity);
+    indexSlot = (int*) malloc(sizeof(int) * capacity);
+    freeSlots = (int*) malloc(sizeof(int) * capacity);
+
+    numBubbles = 0;
+    numFreeSlots = 0;
+    bubbleCapacity = bubbles && gridCandidates && slotIndex && indexSlot && freeSlots ? capacity : 0;
+    return bubbleCapacity == capacity;
+}
+
+// empties the pool and populates it with count random bubbles
+void initializeBubbles(int count)
+{
+    numBubbles = 0;
+    numFreeSlots = 0;
+    // push in reverse so the first handles given out are 0, 1, 2...
+    for (int i = bubbleCapacity - 1; i >= 0; i--) {
+        slotIndex[i] = -1;
+        freeSlots[numFreeSlots++] = i;
+    }
+
+    float smallest = BUBBLE_RADIUS;
+    float biggest = BUBBLE_RADIUS;
+    if (radiusDistribution != RADIUS_FIXED) {
+        smallest = minBubbleRadius;
+        biggest = maxBubbleRadius > minBubbleRadius ? maxBubbleRadius : minBubbleRadius;
+    }
+    freeBubbleGrid(&bubbleGrid);
+    initBubbleGrid(&bubbleGrid, hierarchicalGrid ? smallest : biggest, biggest, worldWidth, worldHeight, bubbleCapacity);
+
+    setBubbleCount(count);
+}
+
+BUBBLE_HANDLE addBubble(const BUBBLE* b)
+{
+    if (numFreeSlots == 0)
+        return NO_BUBBLE;
+
+    int slot = freeSlots[--numFreeSlots];
+    int index = numBubbles++;
+
+    bubbles[index] = *b;
+    slotIndex[slot] = index;
+    indexSlot[index] = slot;
+    bubbleGridInsert(&bubbleGrid, index, b->x, b->y, b->r);
+    return slot;
+}
+
+BUBBLE_HANDLE addRandomBubble()
+{
+    BUBBLE b = {};
+    b.x = bubbleRandom() % worldWidth;
+    b.y = bubbleRandom() % worldHeight;
+    b.r = randomBubbleRadius();
+    b.mass = bubbleMassFor(b.r);
+    b.xVel = 0.5;
+    b.yVel = 0;
+    b.doGrav = true; // only matters once gravity is set
+    b.prevX = b.x;
+    b.prevY = b.y;
+
+        // printf("X: %f, Y: %f, R: %f", b.xVel, b.y, b.r);
+    return addBubble(&b);
+}
+
+bool removeBubble(BUBBLE_HANDLE h)
+{
+    if (h < 0 || h >= bubbleCapacity || slotIndex[h] == -1)
+        return false;
+
+    int index = slotIndex[h];
+    int last = --numBubbles;
+
+    bubbleGridRemove(&bubbleGrid, index);
+    if (index != last) {
+        // fill the hole with the last bubble so the array stays packed
+        bubbleGridRemove(&bubbleGrid, last);
+        bubbles[index] = bubbles[last];
+        bubbleGridInsert(&bubbleGrid, index, bubbles[index].x, bubbles[index].y, bubbles[index].r);
+
+        indexSlot[index] = indexSlot[last];
+        slotIndex[indexSlot[index]] = index;
+    }
+
+    slotIndex[h] = -1;
+    freeSlots[numFreeSlots++] = h;
+    return true;
+}
+
+BUBBLE* bubbleFromHandle(BUBBLE_HANDLE h)
+{
+    if (h < 0 || h >= bubbleCapacity || slotIndex[h] == -1)
+        return NULL;
+    return &bubbles[slotIndex[h]];
+}
+
+void setBubbleCount(int count)
+{
+    if (count > bubbleCapacity)
+        count = bubbleCapacity;
+    if (count < 0)
+        count = 0;
+
+    while (numBubbles < count)
+        addRandomBubble();
+    while (numBubbles > count)
+        removeBubble(indexSlot[numBubbles - 1]);
+}
+
+float friction = 1; // no energy loss if == 1
+float ballFriction = 1;
+float damping = 1;
+bool sleepEnabled = false;
+
+void wakeBubble(BUBBLE* b)
+{
+    b->sleeping = false;
+    b->stillSteps = 0;
+}
+
+void updateBubbleSleep(BUBBLE* b)
+{
+    if (!sleepEnabled || b->sleeping)
+        return;
+
+    if (b->xVel * b->xVel + b->yVel * b->yVel > SLEEP_SPEED * SLEEP_SPEED) {
+        b->stillSteps = 0;
+        return;
+    }
+
+    if (++b->stillSteps >= SLEEP_STEPS) {
+        b->sleeping = true;
+        b->xVel = 0;
+        b->yVel = 0;
+    }
+}
+
+int countSleepingBubbles()
+{
+    int count = 0;
+    for (int i = 0; i < numBubbles; i++)
+        count += bubbles[i].sleeping;
+    return count;
+}
+
+// checks if bubble hitting wall
+void wallCheck(BUBBLE* b) {
+    // bottom & top
+    if (b->y + b->r > worldHeight) {
+        b->y = worldHeight - b->r;
+        b->xVel *= friction;
+        b->yVel *= -1 * friction;        
+    } else if (b->y - b->r < 0) {
+        b->y = b->r;
+        b->xVel *= friction;
+        b->yVel *= -1 * friction;
+    }
+
+    // sides
+    if (b->x + b->r > worldWidth) {
+        b->x = worldWidth - b->r;
+        b->xVel *= -1 * friction;
+        b->yVel *= friction;
+    } else if (b->x - b->r < 0) {
+        b->x = b->r;
+        b->xVel *= -1 * friction;
+        b->yVel *= friction;
+    }
+
+    if (backgroundField)
+        fieldCheck(b);
+}
+
+const BACKGROUND_FIELD* backgroundField = NULL;
+
+void fieldCheck(BUBBLE* b)
+{
+    float normX, normY;
+    if (!backgroundFieldContact(backgroundField, b->x, b->y, b->r, &normX, &normY))
+        return;
+
+    // only when heading into it, so it can get back out
+    float dotProduct = b->xVel * normX + b->yVel * normY;
+    if (dotProduct >= 0)
+        return;
+
+    b->xVel = (b->xVel - 2 * dotProduct * normX) * friction;
+    b->yVel = (b->yVel - 2 * dotProduct * normY) * friction;
+}
+
+float ballEnergyTransfer = 0.2f;
+
+void bounceOff(BUBBLE* b, BUBBLE* other, float normX, float normY) {
+    // reflect velocity vector over normal vector to find new velcoity after bounce
+    float dotProduct = b->xVel * normX + b->yVel * normY;
+    // var ang = Math.acos(dotProduct / velLength);
+
+    // https://math.stackexchange.com/questions/13261/how-to-get-a-reflection-vector
+    // derive by setting angle of current velcoity with normal equal to
+    // angle of new velocity (reflection) with normal and
+    // solve the dot product equation
+    float newXVel = b->xVel - 2 * dotProduct * normX;
+    float newYVel = b->yVel - 2 * dotProduct * normY;
+
+    b->xVel = newXVel * ballFriction;
+    b->yVel = newYVel * ballFriction;
+
+    // transfer some energy to other ball
+    wakeBubble(other);
+    other->xVel -= newXVel * ballFriction * ballEnergyTransfer / other->mass;
+    other->yVel -= newYVel * ballFriction * ballEnergyTransfer / other->mass;
+}
+
+bool impulseResponse = false;
+float restitution = 1;
+float gravity = 0;
+
+void resolveImpulse(BUBBLE* a, BUBBLE* b)
+{
+    float normX = a->x - b->x;
+    float normY = a->y - b->y;
+    float dist = sqrtf(normX * normX + normY * normY);
+
+    // dead centre hits have no direction, pick one so they still separate
+    if (dist > 0) {
+        normX /= dist;
+        normY /= dist;
+    } else {
+        normX = 1;
+        normY = 0;
+    }
+
+    // massless bubbles get pushed around by everything
+    float invMassA = a->mass > 0 ? 1 / a->mass : 1;
+    float invMassB = b->mass > 0 ? 1 / b->mass : 1;
+    float invMassSum = invMassA + invMassB;
+
+    // only push if they're closing, a pair already moving apart is left to finish separating
+    float closing = (a->xVel - b->xVel) * normX + (a->yVel - b->yVel) * normY;
+    if (closing < 0) {
+        wakeBubble(a);
+        wakeBubble(b);
+        float impulse = -(1 + restitution) * closing / invMassSum;
+        a->xVel += impulse * invMassA * normX;
+        a->yVel += impulse * invMassA * normY;
+        b->xVel -= impulse * invMassB * normX;
+        b->yVel -= impulse * invMassB * normY;
+    }
+
+    float penetration = a->r + b->r - dist;
+    if (penetration > PENETRATION_SLOP) {
+        wakeBubble(a);
+        wakeBubble(b);
+        float correction = (penetration - PENETRATION_SLOP) * BAUMGARTE_FACTOR / invMassSum;
+        a->x += correction * invMassA * normX;
+        a->y += correction * invMassA * normY;
+        b->x -= correction * invMassB * normX;
+        b->y -= correction * invMassB * normY;
+    }
+}
+
+void accelerateBubble(BUBBLE* b)
+{
+    if (b->doGrav)
+        b->yVel += gravity;
+    b->xVel *= damping;
+    b->yVel *= damping;
+}
+
+void (*contactObserver)(int b, int other) = NULL;
+
+// bounces b off of other if they're close enough to hit, velLength is b's speed
+// returns true if they touched (and b may have moved or changed speed)
+static bool collidePair(BUBBLE* b, BUBBLE* other, float velLength) {
+    if (impulseResponse) {
+        float dx = b->x - other->x;
+        float dy = b->y - other->y;
+        float reach = b->r + other->r;
+        if (dx * dx + dy * dy < reach * reach) {
+            resolveImpulse(b, other);
+            bubbleGridMove(&bubbleGrid, b - bubbles, b->x, b->y);
+            bubbleGridMove(&bubbleGrid, other - bubbles, other->x, other->y);
+            if (contactObserver)
+                contactObserver(b - bubbles, other - bubbles);
+            return true;
+        }
+        return false;
+    }
+
+    // the test below takes a square root in double, pairs that are clearly
+    // too far apart are ruled out without one (see PAIR_TEST_MARGIN)
+    float dx = b->x - other->x;
+    float dy = b->y - other->y;
+    float reach = b->r + other->r + velLength;
+    if (dx * dx + dy * dy > reach * reach * PAIR_TEST_MARGIN)
+        return false;
+
+    // first check if close enough to hit
+    if ( sqrt(pow((b->x - other->x), 2) + pow((b->y - other->y), 2)) < (b->r + other->r + velLength) ) {
+        // find line between balls' centers 
+        // this will be the line we reflect the angle of bounce around
+        float normX = b->x - other->x;
+        float normY = b->y - other->y;
+        float normMagnitude = sqrt(pow(normX, 2) + pow(normY,2));
+        
+        // make normal vector length 1 (normalize vector)
+        normX /= normMagnitude;
+        normY /= normMagnitude;
+
+        // move balls to just touching and update velocity
+        b->x += normX * velLength; 
+        b->y += normY * velLength; 
+
+        bounceOff(b, other, normX, normY);
+
+        bubbleGridMove(&bubbleGrid, b - bubbles, b->x, b->y);
+        if (contactObserver)
+            contactObserver(b - bubbles, other - bubbles);
+        return true;
+    }
+    return false;
+}
+
+static float bubbleSpeed(const BUBBLE* b)
+{
+    return sqrt(pow(b->xVel, 2) + pow(b->yVel, 2));
+}
+
+// checks if bubble collided with other bubble
+// only bubbles in grid cells near b are tested, in the same order as the brute force loop
+void collisionCheck(BUBBLE* b) {
+    int self = b - bubbles;
+    float velLength = bubbleSpeed(b);
+
+    // each hit nudges b along the normal, so the query leaves velLength of slack
+    // and is redone from b's new position once the nudges have used it up
+    float slack = velLength + 1;
+    float queryX = b->x;
+    float queryY = b->y;
+    int count = bubbleGridQuery(&bubbleGrid, queryX, queryY, b->r + velLength + slack, gridCandidates);
+
+    // b stays put until it touches something, so the candidates ahead of it are
+    // filtered a block at a time and the block starts over after every contact
+    // (short runs are left to collidePair's own early-out)
+    unsigned int near = 0;
+    int blockStart = 0;
+    int blockEnd = 0;
+
+    for (int c = 0; c < count; c++)
+    {
+        int i = gridCandidates[c];
+
+        // skip self
+        if (i == self)
+            continue;
+
+        collisionPairsTested++;
+        if (batchedPairTests) {
+            if (c >= blockEnd && count - c >= PAIR_BLOCK_MIN) {
+                blockStart = c;
+                blockEnd = count - c < PAIR_BLOCK ? count : c + PAIR_BLOCK;
+                float reach = impulseResponse ? b->r : b->r + velLength;
+                near = pairTestBlock(bubbles, gridCandidates + c, blockEnd - c, b->x, b->y, reach);
+            }
+            if (c < blockEnd && !(near & (1u << (c - blockStart))))
+                continue;
+        }
+
+        if (!collidePair(b, &bubbles[i], velLength))
+            continue;
+        velLength = bubbleSpeed(b);
+        blockEnd = 0;
+
+        if (fabsf(b->x - queryX) > slack || fabsf(b->y - queryY) > slack) {
+            slack = velLength + 1;
+            queryX = b->x;
+            queryY = b->y;
+            count = bubbleGridQuery(&bubbleGrid, queryX, queryY, b->r + velLength + slack, gridCandidates);
+
+            // carry on with the bubbles after i like the brute force loop would
+            c = -1;
+            while (c + 1 < count && gridCandidates[c + 1] <= i)
+                c++;
+        }
+    }
+}
+
+void collisionCheckBruteForce(BUBBLE* b) {
+    for (int i = 0; i < numBubbles; i++)
+    {
+        // skip self
+        if (b == &bubbles[i])
+            continue;
+
+        collisionPairsTested++;
+        collidePair(b, &bubbles[i], bubbleSpeed(b));
+    }
+}
+
+// run in loop to update each bubble individually in bubbles array
+void bubbleUpdate(BUBBLE* b) {
+    accelerateBubble(b);
+    b->x += b->xVel;
+    b->y += b->yVel;
+
+    wallCheck(b);
+    bubbleGridMove(&bubbleGrid, b - bubbles, b->x, b->y);
+
+    collisionCheck(b);
+}
+
+bool continuousCollision = false;
+bool batchedPairTests = true;
+bool parallelCollision = false;
+
+float sweptCircleTOI(float x, float y, float r, float dx, float dy, float otherX, float otherY, float otherR)
+{
+    float px = x - otherX;
+    float py = y - otherY;
+    float reach = r + otherR;
+
+    float pd = px * dx + py * dy;
+    float c = px * px + py * py - reach * reach;
+
+    // already touching, only counts if still heading inwards
+    if (c <= 0)
+        return pd < 0 ? 0 : -1;
+
+    // moving apart or sideways
+    if (pd >= 0)
+        return -1;
+
+    float dd = dx * dx + dy * dy;
+    float disc = pd * pd - dd * c;
+    if (disc < 0)
+        return -1;
+
+    // first root of |p + d t| = reach
+    float t = (-pd - sqrtf(disc)) / dd;
+    return t <= 1 ? t : -1;
+}
+
+// time along one axis until a circle at pos moving by d reaches the wall at limit - r or r
+static float sweptWallTOI(float pos, float d, float r, float limit)
+{
+    if (d > 0) {
+        float stop = limit - r;
+        if (pos >= stop)
+            return 0;
+        float t = (stop - pos) / d;
+        return t <= 1 ? t : -1;
+    } else if (d < 0) {
+        if (pos <= r)
+            return 0;
+        float t = (r - pos) / d;
+        return t <= 1 ? t : -1;
+    }
+    return -1;
+}
+
+float sweptWallTOIX(const BUBBLE* b, float dx)
+{
+    return sweptWallTOI(b->x, dx, b->r, worldWidth);
+}
+
+float sweptWallTOIY(const BUBBLE* b, float dy)
+{
+    return sweptWallTOI(b->y, dy, b->r, worldHeight);
+}
+
+enum SWEPT_HIT { HIT_NONE, HIT_WALL_X, HIT_WALL_Y, HIT_BUBBLE };
+
+// moves b along its whole velocity, stopping at every wall or bubble it touches on the way
+// other bubbles are treated as standing still, the same as in the sequential collisionCheck
+void bubbleUpdateSwept(BUBBLE* b) {
+    int self = b - bubbles;
+    float remaining = 1; // fraction of this step's motion still to do
+
+    accelerateBubble(b);
+
+    for (int sub = 0; sub < MAX_CCD_SUBSTEPS && remaining > 0; sub++) {
+        float dx = b->xVel * remaining;
+        float dy = b->yVel * remaining;
+        float moveLength = sqrtf(dx * dx + dy * dy);
+
+        // earliest hit along the path, as a fraction of dx, dy
+        float first = 1;
+        SWEPT_HIT hit = HIT_NONE;
+        int hitIndex = -1;
+
+        float t = sweptWallTOIX(b, dx);
+        if (t >= 0 && t < first) {
+            first = t;
+            hit = HIT_WALL_X;
+        }
+        t = sweptWallTOIY(b, dy);
+        if (t >= 0 && t < first) {
+            first = t;
+            hit = HIT_WALL_Y;
+        }
+
+        // anything the swept circle can reach lives in the cells around the middle of the path
+        float midX = b->x + dx / 2;
+        float midY = b->y + dy / 2;
+        int count = bubbleGridQuery(&bubbleGrid, midX, midY, b->r + moveLength / 2, gridCandidates);
+        for (int c = 0; c < count; c++) {
+            int i = gridCandidates[c];
+            if (i == self)
+                continue;
+
+            collisionPairsTested++;
+            t = sweptCircleTOI(b->x, b->y, b->r, dx, dy, bubbles[i].x, bubbles[i].y, bubbles[i].r);
+            if (t >= 0 && t < first) {
+                first = t;
+                hit = HIT_BUBBLE;
+                hitIndex = i;
+            }
+        }
+
+        b->x += dx * first;
+        b->y += dy * first;
+        remaining *= 1 - first;
+
+        if (hit == HIT_WALL_X) {
+            b->xVel *= -1 * friction;
+            b->yVel *= friction;
+        } else if (hit == HIT_WALL_Y) {
+            b->xVel *= friction;
+            b->yVel *= -1 * friction;
+        } else if (hit == HIT_BUBBLE) {
+            BUBBLE* other = &bubbles[hitIndex];
+            if (impulseResponse) {
+                // the same test resolveImpulse makes, on the relative velocity
+                float closing = (b->xVel - other->xVel) * (b->x - other->x) + (b->yVel - other->yVel) * (b->y - other->y);
+                resolveImpulse(b, other);
+                bubbleGridMove(&bubbleGrid, hitIndex, other->x, other->y);
+                // touching one that's getting away faster than b chases it. nothing was
+                // pushed and every substep would stop here again, b waits for the next step
+                // (it can't go through where other is now, other may not have moved yet)
+                if (first == 0 && closing >= 0)
+                    break;
+                continue;
+            }
+            float normX = b->x - other->x;
+            float normY = b->y - other->y;
+            float normMagnitude = sqrtf(normX * normX + normY * normY);
+            if (normMagnitude > 0)
+                bounceOff(b, other, normX / normMagnitude, normY / normMagnitude);
+        } else {
+            break;
+        }
+    }
+
+    // out of substeps in a tight squeeze, at least keep it on screen
+    wallCheck(b);
+    bubbleGridMove(&bubbleGrid, self, b->x, b->y);
+}
+
+void stepBubbles() {
+    if (parallelCollision && !continuousCollision) {
+        stepBubblesParallel();
+        return;
+    }
+
+    for (int i = 0; i < numBubbles; i++) {
+        bubbles[i].prevX = bubbles[i].x;
+        bubbles[i].prevY = bubbles[i].y;
+    }
+
+    for (int i = 0; i < numBubbles; i++) {
+        if (bubbles[i].sleeping)
+            continue;
+
+        if (continuousCollision)
+            bubbleUpdateSwept(&bubbles[i]);
+        else
+            bubbleUpdate(&bubbles[i]);
+        updateBubbleSleep(&bubbles[i]);
+    }
+}
+
+bool initBubbleSnapshot(BUBBLE_SNAPSHOT* snap, int capacity)
+{
+    snap->time = 0;
+    snap->step = 0;
+    snap->count = 0;
+    snap->capacity = capacity;
+    snap->bubbles = (BUBBLE*) malloc(sizeof(BUBBLE) * capacity);
+    return snap->bubbles != NULL;
+}
+
+void freeBubbleSnapshot(BUBBLE_SNAPSHOT* snap)
+{
+    free(snap->bubbles);
+    snap->bubbles = NULL;
+    snap->capacity = 0;
+    snap->count = 0;
+}
+
+void takeBubbleSnapshot(BUBBLE_SNAPSHOT* snap, double time, long long step)
+{
+    int count = numBubbles;
+    if (count > snap->capacity)
+        count = snap->capacity;
+
+    memcpy(snap->bubbles, bubbles, sizeof(BUBBLE) * count);
+    snap->count = count;
+    snap->time = time;
+    snap->step = step;
+}
@@ -0,0 +1,192 @@
+#ifndef BUBBLE_PHYSICS_H
+#define BUBBLE_PHYSICS_H
+
+// portable bubble simulation (no windows.h) so it can run headless
+
+#include "BubbleGrid.h"
+
+struct BACKGROUND_FIELD; // BackgroundField.h
+
+const int NUMBER_OF_BUBBLES = 10; // default bubble count
+extern int BUBBLE_RADIUS; // default 120 but will scale based on screen size
+
+struct BUBBLE {
+    float x;
+    float y;
+    float r;
+    float xVel;
+    float yVel;
+    float mass;
+    bool doGrav;
+    float prevX; // position before the last step, for interpolated drawing
+    float prevY;
+    int stillSteps; // steps in a row spent slower than SLEEP_SPEED
+    bool sleeping;  // skipped by the step until something bumps into it
+};
+
+// live bubbles are packed into bubbles[0, numBubbles), the array itself is
+// bubbleCapacity long and never reallocated once the pool is set up
+extern BUBBLE* bubbles;
+extern int numBubbles;
+extern int bubbleCapacity;
+
+// stable id for a bubble, stays valid while other bubbles are added and removed
+typedef int BUBBLE_HANDLE;
+const BUBBLE_HANDLE NO_BUBBLE = -1;
+
+// copy of the bubbles handed from the physics thread to the drawing code
+struct BUBBLE_SNAPSHOT {
+    double time;    // when the simulation reached this state (seconds)
+    long long step; // simulation step this was taken after
+    int count;
+    int capacity;
+    BUBBLE* bubbles;
+};
+
+// size of the area bubbles bounce around in (the window's client area)
+extern int worldWidth, worldHeight;
+
+// broad phase used by collisionCheck, kept up to date by every position change
+extern BUBBLE_GRID bubbleGrid;
+
+// number of bubble pairs collisionCheck has run the contact test on
+extern long long collisionPairsTested;
+
+// random numbers for placing bubbles. not rand() so a seed gives the same
+// bubbles with every C runtime, which replays (BubbleReplay.h) depend on
+void seedBubbleRandom(unsigned int seed);
+unsigned int bubbleRandom();
+
+// radius that fills the screen about the same for any bubble count
+int scaledBubbleRadius(int width, int height, int count);
+
+// bubble sizes
+// addRandomBubble picks each new bubble's radius between minBubbleRadius and
+// maxBubbleRadius, or gives every bubble BUBBLE_RADIUS with RADIUS_FIXED (the
+// default, which draws no extra random numbers so old seeds and replays still
+// give the same bubbles). mass goes with area, a BUBBLE_RADIUS bubble weighs 10
+enum RADIUS_DISTRIBUTION {
+    RADIUS_FIXED,
+    RADIUS_UNIFORM,   // every radius in the range equally likely
+    RADIUS_POWER_LAW, // likelihood falls off with radius^2, lots of foam and a few big ones
+    RADIUS_BIMODAL,   // 90% small (min to 2 * min), 10% big (max / 2 to max)
+};
+extern RADIUS_DISTRIBUTION radiusDistribution;
+extern float minBubbleRadius;
+extern float maxBubbleRadius;
+
+float randomBubbleRadius();
+float bubbleMassFor(float r);
+// "fixed", "uniform", "power-law" or "bimodal", false for anything else
+bool parseRadiusDistribution(const char* name, RADIUS_DISTRIBUTION* out);
+const char* radiusDistributionName(RADIUS_DISTRIBUTION d);
+
+// when set the grid gets a level per size class (BubbleGrid.h), otherwise it
+// is one level sized for the biggest bubble like before variable radii
+extern bool hierarchicalGrid;
+
+bool allocateBubbles(int capacity); // sizes the bubble pool, call before initializeBubbles
+
+void initializeBubbles(int count); // empties the pool, builds the grid and adds count random bubbles
+
+// pool operations, all O(1) and allocation free
+BUBBLE_HANDLE addBubble(const BUBBLE* b); // NO_BUBBLE if the pool is full
+BUBBLE_HANDLE addRandomBubble();
+bool removeBubble(BUBBLE_HANDLE h); // the last bubble is moved into the hole
+BUBBLE* bubbleFromHandle(BUBBLE_HANDLE h); // NULL if h was removed
+void setBubbleCount(int count); // adds random bubbles or removes the newest ones, clamped to capacity
+
+// energy kept by a bounce off a wall (friction) or another bubble (ballFriction,
+// the original response only) and the fraction of its speed every bubble keeps
+// each step (damping). all 1 by default, which never slows anything down
+extern float friction;
+extern float ballFriction;
+extern float damping;
+// share of a bubble's bounce that bounceOff pushes the other bubble with (0.2)
+extern float ballEnergyTransfer;
+
+void wallCheck(BUBBLE* b);
+
+// desktop collisions
+// when set, wallCheck also bounces bubbles off the solid parts of the field
+// (window edges and the like, BackgroundField.h) as if they were walls: a
+// bubble moving towards the solid cells under it has its velocity reflected
+// away from them, with friction. nothing is moved, a bubble already inside
+// a solid area just carries on until it's out. NULL (the default) for none
+extern const BACKGROUND_FIELD* backgroundField;
+void fieldCheck(BUBBLE* b);
+void collisionCheck(BUBBLE* b);
+void collisionCheckBruteForce(BUBBLE* b); // reference O(N) loop over every bubble
+// called with the indices of every pair collisionCheck or collisionCheckBruteForce
+// bounces (b is the one being checked), for comparing the two. NULL normally
+extern void (*contactObserver)(int b, int other);
+// collisionCheck rules out far candidates a block at a time with pairTestBlock
+// (BubblePairs.h) when set, otherwise one by one. the results are the same
+extern bool batchedPairTests;
+void bubbleUpdate(BUBBLE* b);
+void stepBubbles(); // advances every bubble by one fixed timestep
+
+// reflects b's velocity over the unit normal (pointing from other to b)
+// and transfers some energy to other
+void bounceOff(BUBBLE* b, BUBBLE* other, float normX, float normY);
+
+// impulse based collision response
+// instead of bounceOff's reflect-and-nudge, a contact applies equal and opposite
+// impulses along the normal (so momentum is conserved) sized to give the pair a
+// separating speed of restitution times their closing speed (energy never goes
+// up, and stays put with restitution 1). overlap is worked off by moving the
+// pair apart in proportion to their inverse masses, a fraction at a time
+// (Baumgarte style) and without touching velocities, so it can't add energy
+extern bool impulseResponse; // every collision path uses resolveImpulse when set
+extern float restitution; // 1 = perfectly elastic, 0 = no bounce at all
+extern float gravity; // added to yVel of bubbles with doGrav every step (pixels / step^2)
+const float BAUMGARTE_FACTOR = 0.4f; // fraction of the overlap removed per contact
+const float PENETRATION_SLOP = 0.5f; // overlap in pixels that is left alone so resting contacts don't jitter
+
+// applies the impulse between a pair that is touching or overlapping
+// the normal points from b to a. moves both bubbles but doesn't relink them in the grid
+void resolveImpulse(BUBBLE* a, BUBBLE* b);
+
+// gravity and damping for one step
+void accelerateBubble(BUBBLE* b);
+
+// sleeping
+// a bubble that has been slower than SLEEP_SPEED for SLEEP_STEPS steps in a row
+// is stopped and skipped by every step path (no movement, wall or collision
+// checks) until an awake bubble hits or pushes it. a settled scene then only
+// costs a flag test per bubble. each bubble sleeps on its own, a pile wakes up
+// one bubble at a time as the woken ones move and knock into the rest
+extern bool sleepEnabled;
+const float SLEEP_SPEED = 0.05f; // pixels per step
+const int SLEEP_STEPS = 60;
+
+void updateBubbleSleep(BUBBLE* b); // call once per step after b has moved
+void wakeBubble(BUBBLE* b);
+int countSleepingBubbles();
+
+// stepBubbles hands the step to stepBubblesParallel (BubbleParallel.h) when set,
+// unless continuousCollision is on too. needs initParallelPhysics first
+extern bool parallelCollision;
+
+// continuous collision detection
+// instead of teleporting by its velocity and then testing for overlap, each bubble
+// sweeps along its path and stops at the first wall or bubble it would touch,
+// bounces, and carries on with the rest of the step (up to MAX_CCD_SUBSTEPS times)
+// so fast or small bubbles can't tunnel through each other or the walls
+extern bool continuousCollision; // stepBubbles uses bubbleUpdateSwept when set
+const int MAX_CCD_SUBSTEPS = 8;
+
+void bubbleUpdateSwept(BUBBLE* b);
+
+// fraction (0 - 1) of the motion (dx, dy) after which a circle first touches a
+// resting circle, or -1 if it doesn't. 0 if already touching and moving closer
+float sweptCircleTOI(float x, float y, float r, float dx, float dy, float otherX, float otherY, float otherR);
+// same for the left/right and top/bottom walls of the world
+float sweptWallTOIX(const BUBBLE* b, float dx);
+float sweptWallTOIY(const BUBBLE* b, float dy);
+
+bool initBubbleSnapshot(BUBBLE_SNAPSHOT* snap, int capacity);
+void freeBubbleSnapshot(BUBBLE_SNAPSHOT* snap);
+void takeBubbleSnapshot(BUBBLE_SNAPSHOT* snap, double time, long long step);
+
+#endif
@@ -0,0 +1,295 @@
+#include "BubbleRaster.h"
+#include "BubbleSprites.h"
+
+#include <math.h>
+#include <string.h>
+
+uint32_t colorrefToPixel(uint32_t colorref)
+{
+    uint32_t r = colorref & 0xff;
+    uint32_t g = (colorref >> 8) & 0xff;
+    uint32_t b = (colorref >> 16) & 0xff;
+    return (r << 16) | (g << 8) | b;
+}
+
+static DIRTY_RECT clipRect(DIRTY_RECT rect, int width, int height)
+{
+    if (rect.left < 0) rect.left = 0;
+    if (rect.top < 0) rect.top = 0;
+    if (rect.right > width) rect.right = width;
+    if (rect.bottom > height) rect.bottom = height;
+    return rect;
+}
+
+static bool rectEmpty(DIRTY_RECT rect)
+{
+    return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+static bool rectsOverlap(DIRTY_RECT a, DIRTY_RECT b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+static DIRTY_RECT rectUnion(DIRTY_RECT a, DIRTY_RECT b)
+{
+    if (rectEmpty(a))
+        return b;
+    if (rectEmpty(b))
+        return a;
+
+    DIRTY_RECT u;
+    u.left = a.left < b.left ? a.left : b.left;
+    u.top = a.top < b.top ? a.top : b.top;
+    u.right = a.right > b.right ? a.right : b.right;
+    u.bottom = a.bottom > b.bottom ? a.bottom : b.bottom;
+    return u;
+}
+
+static long long rectArea(DIRTY_RECT rect)
+{
+    return (long long) (rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+void fillRect(FRAMEBUFFER* fb, DIRTY_RECT rect, uint32_t color)
+{
+    rect = clipRect(rect, fb->width, fb->height);
+    for (int y = rect.top; y < rect.bottom; y++) {
+        uint32_t* row = fb->pixels + (size_t) y * fb->stride;
+        for (int x = rect.left; x < rect.right; x++)
+            row[x] = color;
+    }
+}
+
+void copyRect(FRAMEBUFFER* dst, const FRAMEBUFFER* src, DIRTY_RECT rect)
+{
+    rect = clipRect(rect, dst->width, dst->height);
+    rect = clipRect(rect, src->width, src->height);
+    if (rectEmpty(rect))
+        return;
+
+    for (int y = rect.top; y < rect.bottom; y++) {
+        memcpy(dst->pixels + (size_t) y * dst->stride + rect.left,
+            src->pixels + (size_t) y * src->stride + rect.left,
+            sizeof(uint32_t) * (rect.right - rect.left));
+    }
+}
+
+static uint32_t blendPixel(uint32_t dst, uint32_t color, int coverage)
+{
+    // coverage is 0 - 256
+    uint32_t rb = dst & 0xff00ff;
+    uint32_t g = dst & 0x00ff00;
+    rb += (((color & 0xff00ff) - rb) * coverage) >> 8;
+    g += (((color & 0x00ff00) - g) * coverage) >> 8;
+    return (rb & 0xff00ff) | (g & 0x00ff00);
+}
+
+DIRTY_RECT circleBounds(float cx, float cy, float r)
+{
+    // one extra pixel on each side for the anti-aliased edge
+    DIRTY_RECT rect;
+    rect.left = (int) floorf(cx - r) - 1;
+    rect.top = (int) floorf(cy - r) - 1;
+    rect.right = (int) ceilf(cx + r) + 1;
+    rect.bottom = (int) ceilf(cy + r) + 1;
+    return rect;
+}
+
+void drawCircleAA(FRAMEBUFFER* fb, float cx, float cy, float r, uint32_t color, DIRTY_RECT clip)
+{
+    DIRTY_RECT rect = circleBounds(cx, cy, r);
+    clip = clipRect(clip, fb->width, fb->height);
+    if (rect.left < clip.left) rect.left = clip.left;
+    if (rect.top < clip.top) rect.top = clip.top;
+    if (rect.right > clip.right) rect.right = clip.right;
+    if (rect.bottom > clip.bottom) rect.bottom = clip.bottom;
+
+    // pixels closer than inner are fully covered, past outer not at all
+    float inner = r - 0.5f > 0 ? r - 0.5f : 0;
+    float outer = r + 0.5f;
+    float inner2 = inner * inner;
+    float outer2 = outer * outer;
+
+    for (int y = rect.top; y < rect.bottom; y++) {
+        uint32_t* row = fb->pixels + (size_t) y * fb->stride;
+        float dy = y + 0.5f - cy;
+        float dy2 = dy * dy;
+
+        for (int x = rect.left; x < rect.right; x++) {
+            float dx = x + 0.5f - cx;
+            float d2 = dx * dx + dy2;
+
+            if (d2 >= outer2)
+                continue;
+
+            if (d2 <= inner2) {
+                row[x] = color;
+            } else {
+                // coverage falls off linearly across the one pixel wide edge
+                int coverage = (int) ((outer - sqrtf(d2)) * 256);
+                row[x] = blendPixel(row[x], color, coverage);
+            }
+        }
+    }
+}
+
+void drawCircleHard(FRAMEBUFFER* fb, float cx, float cy, float r, uint32_t color, DIRTY_RECT clip)
+{
+    DIRTY_RECT rect = circleBounds(cx, cy, r);
+    clip = clipRect(clip, fb->width, fb->height);
+    if (rect.left < clip.left) rect.left = clip.left;
+    if (rect.top < clip.top) rect.top = clip.top;
+    if (rect.right > clip.right) rect.right = clip.right;
+    if (rect.bottom > clip.bottom) rect.bottom = clip.bottom;
+
+    float r2 = r * r;
+    for (int y = rect.top; y < rect.bottom; y++) {
+        uint32_t* row = fb->pixels + (size_t) y * fb->stride;
+        float dy = y + 0.5f - cy;
+        float dy2 = dy * dy;
+
+        for (int x = rect.left; x < rect.right; x++) {
+            float dx = x + 0.5f - cx;
+            if (dx * dx + dy2 <= r2)
+                row[x] = color;
+        }
+    }
+}
+
+void clearDirtyRects(DIRTY_RECTS* dirty)
+{
+    dirty->count = 0;
+}
+
+void markAllDirty(DIRTY_RECTS* dirty, int width, int height)
+{
+    DIRTY_RECT all = { 0, 0, width, height };
+    dirty->count = 1;
+    dirty->rects[0] = all;
+}
+
+void addDirtyRect(DIRTY_RECTS* dirty, DIRTY_RECT rect, int width, int height)
+{
+    rect = clipRect(rect, width, height);
+    if (rectEmpty(rect))
+        return;
+
+    // keep swallowing overlapping rects until rect is disjoint from the rest
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < dirty->count; i++) {
+            if (rectsOverlap(rect, dirty->rects[i])) {
+                rect = rectUnion(rect, dirty->rects[i]);
+                dirty->rects[i] = dirty->rects[--dirty->count];
+                merged = true;
+                break;
+            }
+        }
+
+        // out of room, fold rect into whichever rect grows the least and start over
+        if (!merged && dirty->count == MAX_DIRTY_RECTS) {
+            int best = 0;
+            long long bestGrowth = -1;
+            for (int i = 0; i < dirty->count; i++) {
+                long long growth = rectArea(rectUnion(rect, dirty->rects[i])) - rectArea(dirty->rects[i]);
+                if (bestGrowth < 0 || growth < bestGrowth) {
+                    best = i;
+                    bestGrowth = growth;
+                }
+            }
+            rect = rectUnion(rect, dirty->rects[best]);
+            dirty->rects[best] = dirty->rects[--dirty->count];
+            merged = true;
+        }
+    }
+
+    dirty->rects[dirty->count++] = rect;
+}
+
+void bubbleDrawPosition(const BUBBLE* b, float alpha, float* x, float* y)
+{
+    *x = b->prevX + (b->x - b->prevX) * alpha;
+    *y = b->prevY + (b->y - b->prevY) * alpha;
+}
+
+void markBubbleDirtyRects(DIRTY_RECTS* dirty, BUBBLE_DRAWN* drawn, int* drawnCount, const BUBBLE_SNAPSHOT* snap, float alpha, int width, int height)
+{
+    // bubbles removed since last frame leave their old spot behind
+    for (int i = snap->count; i < *drawnCount; i++) {
+        addDirtyRect(dirty, drawn[i].bounds, width, height);
+        memset(&drawn[i], 0, sizeof(BUBBLE_DRAWN));
+    }
+    *drawnCount = snap->count;
+
+    for (int i = 0; i < snap->count; i++) {
+        float x, y;
+        float r = snap->bubbles[i].r;
+        bubbleDrawPosition(&snap->bubbles[i], alpha, &x, &y);
+
+        // nothing to repaint for a bubble that hasn't moved
+        if (x == drawn[i].x && y == drawn[i].y && r == drawn[i].r)
+            continue;
+
+        DIRTY_RECT bounds = circleBounds(x, y, r);
+        addDirtyRect(dirty, rectUnion(bounds, drawn[i].bounds), width, height);
+
+        drawn[i].x = x;
+        drawn[i].y = y;
+        drawn[i].r = r;
+        drawn[i].bounds = bounds;
+    }
+}
+
+void restoreDirtyRects(FRAMEBUFFER* fb, const FRAMEBUFFER* background, const DIRTY_RECTS* dirty)
+{
+    for (int d = 0; d < dirty->count; d++)
+        copyRect(fb, background, dirty->rects[d]);
+}
+
+void drawBubblesInDirtyRects(FRAMEBUFFER* fb, const DIRTY_RECTS* dirty, const BUBBLE_SNAPSHOT* snap, float alpha, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas)
+{
+    for (int d = 0; d < dirty->count; d++) {
+        DIRTY_RECT rect = dirty->rects[d];
+
+        for (int i = 0; i < snap->count; i++) {
+            float x, y;
+            bubbleDrawPosition(&snap->bubbles[i], alpha, &x, &y);
+            if (rectsOverlap(circleBounds(x, y, snap->bubbles[i].r), rect))
+                drawCircle(fb, atlas, x, y, snap->bubbles[i].r, color, hardEdges, rect);
+        }
+    }
+}
+
+int listBubblesInDirtyRects(BUBBLE_DRAWN* list, const DIRTY_RECTS* dirty, const BUBBLE_DRAWN* drawn, int count)
+{
+    int listed = 0;
+    for (int i = 0; i < count; i++) {
+        for (int d = 0; d < dirty->count; d++) {
+            if (rectsOverlap(drawn[i].bounds, dirty->rects[d])) {
+                list[listed++] = drawn[i];
+                break;
+            }
+        }
+    }
+    return listed;
+}
+
+void drawBubbleList(FRAMEBUFFER* fb, const DIRTY_RECTS* dirty, const BUBBLE_DRAWN* list, int count, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas)
+{
+    for (int d = 0; d < dirty->count; d++) {
+        DIRTY_RECT rect = dirty->rects[d];
+
+        for (int i = 0; i < count; i++) {
+            if (rectsOverlap(list[i].bounds, rect))
+                drawCircle(fb, atlas, list[i].x, list[i].y, list[i].r, color, hardEdges, rect);
+        }
+    }
+}
+
+void redrawDirtyRects(FRAMEBUFFER* fb, const FRAMEBUFFER* background, const DIRTY_RECTS* dirty, const BUBBLE_SNAPSHOT* snap, float alpha, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas)
+{
+    restoreDirtyRects(fb, background, dirty);
+    drawBubblesInDirtyRects(fb, dirty, snap, alpha, color, hardEdges, atlas);
+}
@@ -0,0 +1,96 @@
+#ifndef BUBBLE_RASTER_H
+#define BUBBLE_RASTER_H
+
+// portable cpu rasterizer for the bubbles
+// draws anti-aliased filled circles into a plain 32 bit framebuffer and keeps
+// track of which parts of the frame changed so only those get redrawn and presented
+
+#include <stdint.h>
+
+#include "BubblePhysics.h"
+
+struct SPRITE_ATLAS; // BubbleSprites.h
+
+// 0x00RRGGBB pixels, the same layout as a 32 bit windows DIB
+struct FRAMEBUFFER {
+    uint32_t* pixels;
+    int width;
+    int height;
+    int stride; // in pixels
+};
+
+// right and bottom are exclusive
+struct DIRTY_RECT {
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+// rects are kept non-overlapping so blending never touches a pixel twice
+const int MAX_DIRTY_RECTS = 64;
+struct DIRTY_RECTS {
+    int count;
+    DIRTY_RECT rects[MAX_DIRTY_RECTS];
+};
+
+// where a bubble was last drawn, so the area it leaves can be repaired
+struct BUBBLE_DRAWN {
+    float x;
+    float y;
+    float r;
+    DIRTY_RECT bounds;
+};
+
+// converts a windows style COLORREF (0x00BBGGRR) into a framebuffer pixel
+uint32_t colorrefToPixel(uint32_t colorref);
+
+void fillRect(FRAMEBUFFER* fb, DIRTY_RECT rect, uint32_t color);
+void copyRect(FRAMEBUFFER* dst, const FRAMEBUFFER* src, DIRTY_RECT rect);
+
+// blends color over the framebuffer by how much of each pixel the circle covers,
+// nothing outside clip is touched
+void drawCircleAA(FRAMEBUFFER* fb, float cx, float cy, float r, uint32_t color, DIRTY_RECT clip);
+
+// the same circle with no blending: pixels whose centre is inside it (the ones
+// drawCircleAA covers at least half) take color, the rest are left alone. for
+// a colour keyed window, where the bubbles are holes and a blend of the key
+// colour and the desktop would show as a dark ring round every one
+void drawCircleHard(FRAMEBUFFER* fb, float cx, float cy, float r, uint32_t color, DIRTY_RECT clip);
+
+void clearDirtyRects(DIRTY_RECTS* dirty);
+void markAllDirty(DIRTY_RECTS* dirty, int width, int height);
+// merges rect into any rects it overlaps, everything is clipped to width x height
+void addDirtyRect(DIRTY_RECTS* dirty, DIRTY_RECT rect, int width, int height);
+
+// where a bubble is drawn this frame, alpha is the interpolation between physics steps
+void bubbleDrawPosition(const BUBBLE* b, float alpha, float* x, float* y);
+
+// pixels a circle touches, including its anti-aliased edge
+DIRTY_RECT circleBounds(float cx, float cy, float r);
+
+// adds the union of each moved bubble's last drawn bounds and its new bounds to dirty
+// drawn holds one entry per bubble (zero it to start) and is updated to the new positions,
+// drawnCount is how many entries were drawn last frame so removed bubbles get erased
+void markBubbleDirtyRects(DIRTY_RECTS* dirty, BUBBLE_DRAWN* drawn, int* drawnCount, const BUBBLE_SNAPSHOT* snap, float alpha, int width, int height);
+
+// copies the background into every dirty rect
+void restoreDirtyRects(FRAMEBUFFER* fb, const FRAMEBUFFER* background, const DIRTY_RECTS* dirty);
+// draws every bubble that overlaps a dirty rect, clipped to the dirty rects
+// with the atlas's sprites, or drawCircleAA if atlas is NULL. hardEdges
+// draws them like drawCircleHard instead
+void drawBubblesInDirtyRects(FRAMEBUFFER* fb, const DIRTY_RECTS* dirty, const BUBBLE_SNAPSHOT* snap, float alpha, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas);
+
+// the entries of drawn (as markBubbleDirtyRects left them) whose bounds overlap
+// any dirty rect, copied into list in order. list needs room for count, returns
+// how many went in
+int listBubblesInDirtyRects(BUBBLE_DRAWN* list, const DIRTY_RECTS* dirty, const BUBBLE_DRAWN* drawn, int count);
+// draws a list from listBubblesInDirtyRects clipped to the dirty rects, the
+// same pixels drawBubblesInDirtyRects gives without working out every bubble's
+// position again for every rect
+void drawBubbleList(FRAMEBUFFER* fb, const DIRTY_RECTS* dirty, const BUBBLE_DRAWN* list, int count, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas);
+
+// restores the background and draws every bubble inside each dirty rect
+void redrawDirtyRects(FRAMEBUFFER* fb, const FRAMEBUFFER* background, const DIRTY_RECTS* dirty, const BUBBLE_SNAPSHOT* snap, float alpha, uint32_t color, bool hardEdges, SPRITE_ATLAS* atlas);
+
+#endif
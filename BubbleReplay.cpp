@@ -0,0 +1,379 @@
+#include "BubbleReplay.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// a varint is at most 5 bytes for 32 bits
+const int MAX_VARINT = 5;
+
+static unsigned int floatBits(float f)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(unsigned int bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static unsigned char* putVarint(unsigned char* out, unsigned int v)
+{
+    while (v >= 0x80) {
+        *out++ = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    *out++ = (unsigned char) v;
+    return out;
+}
+
+static bool getVarint(FILE* f, unsigned int* v)
+{
+    unsigned int result = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF)
+            return false;
+        result |= (unsigned int) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// small differences either way become small unsigned numbers
+static unsigned int zigzag(int v)
+{
+    return ((unsigned int) v << 1) ^ (unsigned int) (v >> 31);
+}
+
+static int unzigzag(unsigned int v)
+{
+    return (int) (v >> 1) ^ -(int) (v & 1);
+}
+
+static void bubbleValues(const BUBBLE* b, unsigned int* values)
+{
+    values[0] = floatBits(b->x);
+    values[1] = floatBits(b->y);
+    values[2] = floatBits(b->xVel);
+    values[3] = floatBits(b->yVel);
+}
+
+// the header fields after magic and version, in the order the given version
+// wrote them (all 4 bytes). returns how many there are
+static int headerFields(REPLAY_HEADER* h, int version, void** fields)
+{
+    int n = 0;
+    fields[n++] = &h->seed;
+    fields[n++] = &h->width;
+    fields[n++] = &h->height;
+    fields[n++] = &h->radius;
+    if (version >= 4) {
+        fields[n++] = &h->radiusDistribution;
+        fields[n++] = &h->minRadius;
+        fields[n++] = &h->maxRadius;
+    }
+    fields[n++] = &h->count;
+    fields[n++] = &h->capacity;
+    fields[n++] = &h->flags;
+    if (version >= 2) {
+        fields[n++] = &h->restitution;
+        fields[n++] = &h->gravity;
+    }
+    if (version >= 3) {
+        fields[n++] = &h->friction;
+        fields[n++] = &h->ballFriction;
+        fields[n++] = &h->damping;
+    }
+    if (version >= 5)
+        fields[n++] = &h->ballEnergyTransfer;
+    return n;
+}
+
+const int MAX_HEADER_FIELDS = 16;
+
+static bool writeHeader(FILE* f, REPLAY_HEADER* h)
+{
+    void* fields[MAX_HEADER_FIELDS];
+    int n = headerFields(h, h->version, fields);
+    if (fwrite(h->magic, sizeof(h->magic), 1, f) != 1 || fwrite(&h->version, sizeof(int), 1, f) != 1)
+        return false;
+    for (int i = 0; i < n; i++) {
+        if (fwrite(fields[i], 4, 1, f) != 1)
+            return false;
+    }
+    return true;
+}
+
+static bool readHeader(FILE* f, REPLAY_HEADER* h)
+{
+    // what the simulation did before each field was recorded
+    memset(h, 0, sizeof(REPLAY_HEADER));
+    h->radiusDistribution = RADIUS_FIXED;
+    h->restitution = 1;
+    h->gravity = 0;
+    h->friction = 1;
+    h->ballFriction = 1;
+    h->damping = 1;
+    h->ballEnergyTransfer = 0.2f;
+
+    if (fread(h->magic, sizeof(h->magic), 1, f) != 1 || fread(&h->version, sizeof(int), 1, f) != 1
+        || memcmp(h->magic, REPLAY_MAGIC, sizeof(h->magic)) != 0
+        || h->version < REPLAY_OLDEST_VERSION || h->version > REPLAY_VERSION)
+        return false;
+
+    void* fields[MAX_HEADER_FIELDS];
+    int n = headerFields(h, h->version, fields);
+    for (int i = 0; i < n; i++) {
+        if (fread(fields[i], 4, 1, f) != 1)
+            return false;
+    }
+
+    // every bubble was BUBBLE_RADIUS and the grid had the one level
+    if (h->version < 4) {
+        h->minRadius = (float) h->radius;
+        h->maxRadius = (float) h->radius;
+        h->flags |= REPLAY_FLAT_GRID;
+    }
+    return true;
+}
+
+bool openReplayRecorder(REPLAY_RECORDER* r, const char* path, unsigned int seed)
+{
+    return openReplayRecorderVersion(r, path, seed, REPLAY_VERSION);
+}
+
+bool openReplayRecorderVersion(REPLAY_RECORDER* r, const char* path, unsigned int seed, int version)
+{
+    memset(r, 0, sizeof(REPLAY_RECORDER));
+    r->capacity = bubbleCapacity;
+    r->previous = (unsigned int*) calloc((size_t) bubbleCapacity * REPLAY_VALUES, sizeof(unsigned int));
+    r->buffer = (unsigned char*) malloc((size_t) (bubbleCapacity * REPLAY_VALUES + 2) * MAX_VARINT);
+    r->file = fopen(path, "wb");
+    if (!r->previous || !r->buffer || !r->file) {
+        closeReplayRecorder(r);
+        return false;
+    }
+
+    REPLAY_HEADER header = {};
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = version;
+    header.seed = seed;
+    header.width = worldWidth;
+    header.height = worldHeight;
+    header.radius = BUBBLE_RADIUS;
+    header.radiusDistribution = radiusDistribution;
+    header.minRadius = minBubbleRadius;
+    header.maxRadius = maxBubbleRadius;
+    header.count = numBubbles;
+    header.capacity = bubbleCapacity;
+    header.flags = (continuousCollision ? REPLAY_CONTINUOUS_COLLISION : 0) | (parallelCollision ? REPLAY_PARALLEL_COLLISION : 0)
+        | (impulseResponse ? REPLAY_IMPULSE_RESPONSE : 0) | (sleepEnabled ? REPLAY_SLEEPING : 0)
+        | (hierarchicalGrid ? 0 : REPLAY_FLAT_GRID);
+    header.restitution = restitution;
+    header.gravity = gravity;
+    header.friction = friction;
+    header.ballFriction = ballFriction;
+    header.damping = damping;
+    header.ballEnergyTransfer = ballEnergyTransfer;
+    if (version < REPLAY_OLDEST_VERSION || version > REPLAY_VERSION || !writeHeader(r->file, &header)) {
+        closeReplayRecorder(r);
+        return false;
+    }
+
+    for (int i = 0; i < numBubbles; i++) {
+        const BUBBLE* b = &bubbles[i];
+        BUBBLE_RECORD record = { b->x, b->y, b->r, b->xVel, b->yVel, b->mass, b->doGrav };
+        fwrite(&record, sizeof(record), 1, r->file);
+        bubbleValues(b, &r->previous[i * REPLAY_VALUES]);
+    }
+    r->previousCount = numBubbles;
+
+    return fflush(r->file) == 0;
+}
+
+bool replayRecordFrame(REPLAY_RECORDER* r, long long step)
+{
+    if (!r->file)
+        return false;
+
+    int count = numBubbles < r->capacity ? numBubbles : r->capacity;
+    // bubbles added since the last frame start from zero
+    for (int i = r->previousCount * REPLAY_VALUES; i < count * REPLAY_VALUES; i++)
+        r->previous[i] = 0;
+
+    unsigned char* out = r->buffer;
+    out = putVarint(out, (unsigned int) (step - r->lastStep));
+    out = putVarint(out, (unsigned int) count);
+
+    for (int i = 0; i < count; i++) {
+        unsigned int values[REPLAY_VALUES];
+        bubbleValues(&bubbles[i], values);
+
+        unsigned int* previous = &r->previous[i * REPLAY_VALUES];
+        for (int v = 0; v < REPLAY_VALUES; v++) {
+            out = putVarint(out, zigzag((int) (values[v] - previous[v])));
+            previous[v] = values[v];
+        }
+    }
+
+    r->lastStep = step;
+    r->previousCount = count;
+    r->frames++;
+
+    // flushed every frame so a recording cut short by the process exiting is still readable
+    size_t size = out - r->buffer;
+    return fwrite(r->buffer, 1, size, r->file) == size && fflush(r->file) == 0;
+}
+
+void closeReplayRecorder(REPLAY_RECORDER* r)
+{
+    if (r->file)
+        fclose(r->file);
+    free(r->previous);
+    free(r->buffer);
+    r->file = NULL;
+    r->previous = NULL;
+    r->buffer = NULL;
+}
+
+bool openReplayPlayer(REPLAY_PLAYER* p, const char* path)
+{
+    memset(p, 0, sizeof(REPLAY_PLAYER));
+    p->file = fopen(path, "rb");
+    if (!p->file)
+        return false;
+
+    REPLAY_HEADER* h = &p->header;
+    if (!readHeader(p->file, h) || h->count < 0 || h->capacity < h->count
+        || h->radiusDistribution < RADIUS_FIXED || h->radiusDistribution > RADIUS_BIMODAL) {
+        closeReplayPlayer(p);
+        return false;
+    }
+
+    p->values = (unsigned int*) calloc((size_t) h->capacity * REPLAY_VALUES, sizeof(unsigned int));
+    if (!p->values || !allocateBubbles(h->capacity)) {
+        closeReplayPlayer(p);
+        return false;
+    }
+
+    worldWidth = h->width;
+    worldHeight = h->height;
+    BUBBLE_RADIUS = h->radius;
+    radiusDistribution = (RADIUS_DISTRIBUTION) h->radiusDistribution;
+    minBubbleRadius = h->minRadius;
+    maxBubbleRadius = h->maxRadius;
+    continuousCollision = (h->flags & REPLAY_CONTINUOUS_COLLISION) != 0;
+    impulseResponse = (h->flags & REPLAY_IMPULSE_RESPONSE) != 0;
+    sleepEnabled = (h->flags & REPLAY_SLEEPING) != 0;
+    hierarchicalGrid = (h->flags & REPLAY_FLAT_GRID) == 0;
+    restitution = h->restitution;
+    gravity = h->gravity;
+    friction = h->friction;
+    ballFriction = h->ballFriction;
+    damping = h->damping;
+    ballEnergyTransfer = h->ballEnergyTransfer;
+    seedBubbleRandom(h->seed);
+    initializeBubbles(0);
+
+    for (int i = 0; i < h->count; i++) {
+        BUBBLE_RECORD record;
+        if (fread(&record, sizeof(record), 1, p->file) != 1) {
+            closeReplayPlayer(p);
+            return false;
+        }
+
+        BUBBLE b = {};
+        b.x = b.prevX = record.x;
+        b.y = b.prevY = record.y;
+        b.r = record.r;
+        b.xVel = record.xVel;
+        b.yVel = record.yVel;
+        b.mass = record.mass;
+        b.doGrav = record.doGrav != 0;
+        addBubble(&b);
+        bubbleValues(&b, &p->values[i * REPLAY_VALUES]);
+    }
+    p->count = h->count;
+    return true;
+}
+
+bool replayReadFrame(REPLAY_PLAYER* p, int* steps)
+{
+    unsigned int stepDelta, count;
+    if (!p->file || !getVarint(p->file, &stepDelta) || !getVarint(p->file, &count))
+        return false;
+    if (count > (unsigned int) p->header.capacity)
+        return false;
+
+    for (int i = p->count * REPLAY_VALUES; i < (int) count * REPLAY_VALUES; i++)
+        p->values[i] = 0;
+
+    for (int i = 0; i < (int) count * REPLAY_VALUES; i++) {
+        unsigned int delta;
+        if (!getVarint(p->file, &delta))
+            return false;
+        p->values[i] += (unsigned int) unzigzag(delta);
+    }
+
+    p->count = count;
+    p->step += stepDelta;
+    p->frames++;
+    *steps = stepDelta;
+    return true;
+}
+
+void closeReplayPlayer(REPLAY_PLAYER* p)
+{
+    if (p->file)
+        fclose(p->file);
+    free(p->values);
+    p->file = NULL;
+    p->values = NULL;
+}
+
+float replayCompare(const REPLAY_PLAYER* p, int* worst)
+{
+    *worst = -1;
+    if (p->count != numBubbles)
+        return -1;
+
+    float maxError = 0;
+    for (int i = 0; i < numBubbles; i++) {
+        unsigned int values[REPLAY_VALUES];
+        bubbleValues(&bubbles[i], values);
+
+        for (int v = 0; v < REPLAY_VALUES; v++) {
+            unsigned int expected = p->values[i * REPLAY_VALUES + v];
+            if (values[v] == expected)
+                continue;
+
+            // NaN compares false to everything so only bits being equal counts as a match
+            float error = fabsf(bitsFloat(values[v]) - bitsFloat(expected));
+            if (!(error <= maxError)) {
+                maxError = error == error ? error : INFINITY;
+                *worst = i;
+            }
+        }
+    }
+    return maxError;
+}
+
+void replayAdopt(const REPLAY_PLAYER* p)
+{
+    for (int i = 0; i < p->count && i < numBubbles; i++) {
+        const unsigned int* values = &p->values[i * REPLAY_VALUES];
+        bubbles[i].x = bitsFloat(values[0]);
+        bubbles[i].y = bitsFloat(values[1]);
+        bubbles[i].xVel = bitsFloat(values[2]);
+        bubbles[i].yVel = bitsFloat(values[3]);
+        bubbleGridMove(&bubbleGrid, i, bubbles[i].x, bubbles[i].y);
+    }
+}
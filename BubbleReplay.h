@@ -0,0 +1,105 @@
+#ifndef BUBBLE_REPLAY_H
+#define BUBBLE_REPLAY_H
+
+// binary recordings of the bubble simulation, for reproducing a run later
+//
+// file layout (all little endian):
+//   REPLAY_HEADER
+//   every starting bubble as a raw BUBBLE_RECORD
+//   frames until end of file, each one
+//     varint steps since the previous frame
+//     varint bubble count
+//     per bubble x, y, xVel, yVel as zigzag varints of the difference between
+//     the float's bit pattern and the same value in the previous frame
+// small moves only change the low mantissa bits so most values take 1-3 bytes
+
+#include <stdio.h>
+
+#include "BubblePhysics.h"
+
+const char REPLAY_MAGIC[4] = { 'H', 'P', 'B', 'R' };
+const int REPLAY_VERSION = 5;
+// every version back to this one still plays. the fields an older header
+// doesn't have are filled in with what the simulation did before they existed
+// (no radius range and one grid level before 4, restitution 1 and no gravity
+// before 2, no friction or damping before 3, a 0.2 energy transfer before 5)
+const int REPLAY_OLDEST_VERSION = 1;
+
+// REPLAY_HEADER.flags
+const int REPLAY_CONTINUOUS_COLLISION = 1;
+const int REPLAY_PARALLEL_COLLISION = 2;
+const int REPLAY_IMPULSE_RESPONSE = 4;
+const int REPLAY_SLEEPING = 8;
+const int REPLAY_FLAT_GRID = 16; // one grid level (hierarchicalGrid off), the parallel step's pair order depends on it
+
+struct REPLAY_HEADER {
+    char magic[4];
+    int version;
+    unsigned int seed;
+    int width;
+    int height;
+    int radius;   // BUBBLE_RADIUS, sets the grid's cell size
+    int radiusDistribution; // with the two below, the size range the grid's levels are built for
+    float minRadius;
+    float maxRadius;
+    int count;    // starting bubbles
+    int capacity; // bubble pool size
+    int flags;
+    float restitution;
+    float gravity;
+    float friction;
+    float ballFriction;
+    float damping;
+    float ballEnergyTransfer;
+};
+
+struct BUBBLE_RECORD {
+    float x, y, r, xVel, yVel, mass;
+    int doGrav;
+};
+
+const int REPLAY_VALUES = 4; // values per bubble in a frame
+
+struct REPLAY_RECORDER {
+    FILE* file;
+    long long lastStep;
+    long long frames;
+    int capacity;
+    int previousCount;
+    unsigned int* previous; // bit patterns from the last frame, REPLAY_VALUES per bubble
+    unsigned char* buffer;  // one encoded frame
+};
+
+// writes the header and the current bubbles as the starting state
+bool openReplayRecorder(REPLAY_RECORDER* r, const char* path, unsigned int seed);
+// same with the header laid out the way an older version wrote it, for checking
+// old files still play. whatever that version had no field for is left out
+bool openReplayRecorderVersion(REPLAY_RECORDER* r, const char* path, unsigned int seed, int version);
+// appends the current bubbles as the state after step
+bool replayRecordFrame(REPLAY_RECORDER* r, long long step);
+void closeReplayRecorder(REPLAY_RECORDER* r);
+
+struct REPLAY_PLAYER {
+    FILE* file;
+    REPLAY_HEADER header;
+    long long step;
+    long long frames;
+    int count;            // bubbles in the last frame read
+    unsigned int* values; // REPLAY_VALUES per bubble, header.capacity long
+};
+
+// reads the header and starting state and sets up the world and bubble pool
+// to match (worldWidth, BUBBLE_RADIUS, radiusDistribution, allocateBubbles, continuousCollision, gravity...)
+bool openReplayPlayer(REPLAY_PLAYER* p, const char* path);
+// decodes the next frame into p->values, *steps is how many steps it is after
+// the previous one. false at the end of the file
+bool replayReadFrame(REPLAY_PLAYER* p, int* steps);
+void closeReplayPlayer(REPLAY_PLAYER* p);
+
+// largest difference between the live bubbles and the frame last read,
+// -1 if the bubble counts differ. *worst gets the bubble it was in
+float replayCompare(const REPLAY_PLAYER* p, int* worst);
+// overwrites the live bubbles with the frame last read
+void replayAdopt(const REPLAY_PLAYER* p);
+
+#endif
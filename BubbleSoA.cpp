@@ -0,0 +1,238 @@
+#include "BubbleSoA.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BUBBLE_SOA_X86
+#include <immintrin.h>
+#endif
+
+const int SOA_LANES = 8;
+const int SOA_ALIGN = 32;
+
+bool initBubbleSoA(BUBBLE_SOA* s, int capacity)
+{
+    capacity = (capacity + SOA_LANES - 1) / SOA_LANES * SOA_LANES;
+    size_t arrayBytes = sizeof(float) * capacity;
+
+    // 5 arrays plus room to align the first one
+    s->block = calloc(1, arrayBytes * 5 + SOA_ALIGN);
+    if (!s->block)
+        return false;
+
+    float* base = (float*) (((uintptr_t) s->block + SOA_ALIGN - 1) & ~(uintptr_t) (SOA_ALIGN - 1));
+    s->x = base;
+    s->y = base + capacity;
+    s->r = base + capacity * 2;
+    s->xVel = base + capacity * 3;
+    s->yVel = base + capacity * 4;
+
+    s->count = 0;
+    s->capacity = capacity;
+    return true;
+}
+
+void freeBubbleSoA(BUBBLE_SOA* s)
+{
+    free(s->block);
+    memset(s, 0, sizeof(BUBBLE_SOA));
+}
+
+void bubblesToSoA(const BUBBLE* src, int count, BUBBLE_SOA* dst)
+{
+    if (count > dst->capacity)
+        count = dst->capacity;
+
+    for (int i = 0; i < count; i++) {
+        dst->x[i] = src[i].x;
+        dst->y[i] = src[i].y;
+        dst->r[i] = src[i].r;
+        dst->xVel[i] = src[i].xVel;
+        dst->yVel[i] = src[i].yVel;
+    }
+    dst->count = count;
+}
+
+void bubblesFromSoA(const BUBBLE_SOA* src, BUBBLE* dst)
+{
+    for (int i = 0; i < src->count; i++) {
+        dst[i].x = src->x[i];
+        dst[i].y = src->y[i];
+        dst[i].r = src->r[i];
+        dst[i].xVel = src->xVel[i];
+        dst[i].yVel = src->yVel[i];
+    }
+}
+
+static void integrateScalar(BUBBLE_SOA* s, int begin, float width, float height, float friction)
+{
+    for (int i = begin; i < s->count; i++) {
+        float x = s->x[i] + s->xVel[i];
+        float y = s->y[i] + s->yVel[i];
+        float r = s->r[i];
+        float xVel = s->xVel[i];
+        float yVel = s->yVel[i];
+
+        // bottom & top
+        if (y + r > height) {
+            y = height - r;
+            xVel *= friction;
+            yVel *= -1 * friction;
+        } else if (y - r < 0) {
+            y = r;
+            xVel *= friction;
+            yVel *= -1 * friction;
+        }
+
+        // sides
+        if (x + r > width) {
+            x = width - r;
+            xVel *= -1 * friction;
+            yVel *= friction;
+        } else if (x - r < 0) {
+            x = r;
+            xVel *= -1 * friction;
+            yVel *= friction;
+        }
+
+        s->x[i] = x;
+        s->y[i] = y;
+        s->xVel[i] = xVel;
+        s->yVel[i] = yVel;
+    }
+}
+
+#ifdef BUBBLE_SOA_X86
+// branch free version of the walls above, one bubble per lane
+// a lane that hits a wall gets its along-wall velocity scaled by friction
+// and its into-wall velocity scaled by -friction, every other lane is scaled by 1
+__attribute__((target("sse4.1")))
+static int integrateSSE(BUBBLE_SOA* s, float width, float height, float friction)
+{
+    const __m128 w = _mm_set1_ps(width);
+    const __m128 h = _mm_set1_ps(height);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 f = _mm_set1_ps(friction);
+    const __m128 negF = _mm_set1_ps(-1 * friction);
+
+    int n = s->count & ~3;
+    for (int i = 0; i < n; i += 4) {
+        __m128 xVel = _mm_load_ps(s->xVel + i);
+        __m128 yVel = _mm_load_ps(s->yVel + i);
+        __m128 r = _mm_load_ps(s->r + i);
+        __m128 x = _mm_add_ps(_mm_load_ps(s->x + i), xVel);
+        __m128 y = _mm_add_ps(_mm_load_ps(s->y + i), yVel);
+
+        __m128 hiY = _mm_cmpgt_ps(_mm_add_ps(y, r), h);
+        __m128 loY = _mm_andnot_ps(hiY, _mm_cmplt_ps(_mm_sub_ps(y, r), zero));
+        __m128 hitY = _mm_or_ps(hiY, loY);
+        y = _mm_blendv_ps(y, _mm_sub_ps(h, r), hiY);
+        y = _mm_blendv_ps(y, r, loY);
+        xVel = _mm_mul_ps(xVel, _mm_blendv_ps(one, f, hitY));
+        yVel = _mm_mul_ps(yVel, _mm_blendv_ps(one, negF, hitY));
+
+        __m128 hiX = _mm_cmpgt_ps(_mm_add_ps(x, r), w);
+        __m128 loX = _mm_andnot_ps(hiX, _mm_cmplt_ps(_mm_sub_ps(x, r), zero));
+        __m128 hitX = _mm_or_ps(hiX, loX);
+        x = _mm_blendv_ps(x, _mm_sub_ps(w, r), hiX);
+        x = _mm_blendv_ps(x, r, loX);
+        xVel = _mm_mul_ps(xVel, _mm_blendv_ps(one, negF, hitX));
+        yVel = _mm_mul_ps(yVel, _mm_blendv_ps(one, f, hitX));
+
+        _mm_store_ps(s->x + i, x);
+        _mm_store_ps(s->y + i, y);
+        _mm_store_ps(s->xVel + i, xVel);
+        _mm_store_ps(s->yVel + i, yVel);
+    }
+    return n;
+}
+
+__attribute__((target("avx2")))
+static int integrateAVX2(BUBBLE_SOA* s, float width, float height, float friction)
+{
+    const __m256 w = _mm256_set1_ps(width);
+    const __m256 h = _mm256_set1_ps(height);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 f = _mm256_set1_ps(friction);
+    const __m256 negF = _mm256_set1_ps(-1 * friction);
+
+    int n = s->count & ~7;
+    for (int i = 0; i < n; i += 8) {
+        __m256 xVel = _mm256_load_ps(s->xVel + i);
+        __m256 yVel = _mm256_load_ps(s->yVel + i);
+        __m256 r = _mm256_load_ps(s->r + i);
+        __m256 x = _mm256_add_ps(_mm256_load_ps(s->x + i), xVel);
+        __m256 y = _mm256_add_ps(_mm256_load_ps(s->y + i), yVel);
+
+        __m256 hiY = _mm256_cmp_ps(_mm256_add_ps(y, r), h, _CMP_GT_OQ);
+        __m256 loY = _mm256_andnot_ps(hiY, _mm256_cmp_ps(_mm256_sub_ps(y, r), zero, _CMP_LT_OQ));
+        __m256 hitY = _mm256_or_ps(hiY, loY);
+        y = _mm256_blendv_ps(y, _mm256_sub_ps(h, r), hiY);
+        y = _mm256_blendv_ps(y, r, loY);
+        xVel = _mm256_mul_ps(xVel, _mm256_blendv_ps(one, f, hitY));
+        yVel = _mm256_mul_ps(yVel, _mm256_blendv_ps(one, negF, hitY));
+
+        __m256 hiX = _mm256_cmp_ps(_mm256_add_ps(x, r), w, _CMP_GT_OQ);
+        __m256 loX = _mm256_andnot_ps(hiX, _mm256_cmp_ps(_mm256_sub_ps(x, r), zero, _CMP_LT_OQ));
+        __m256 hitX = _mm256_or_ps(hiX, loX);
+        x = _mm256_blendv_ps(x, _mm256_sub_ps(w, r), hiX);
+        x = _mm256_blendv_ps(x, r, loX);
+        xVel = _mm256_mul_ps(xVel, _mm256_blendv_ps(one, negF, hitX));
+        yVel = _mm256_mul_ps(yVel, _mm256_blendv_ps(one, f, hitX));
+
+        _mm256_store_ps(s->x + i, x);
+        _mm256_store_ps(s->y + i, y);
+        _mm256_store_ps(s->xVel + i, xVel);
+        _mm256_store_ps(s->yVel + i, yVel);
+    }
+    return n;
+}
+#endif
+
+enum SOA_KERNEL { SOA_KERNEL_UNKNOWN, SOA_KERNEL_SCALAR, SOA_KERNEL_SSE, SOA_KERNEL_AVX2 };
+static SOA_KERNEL soaKernel = SOA_KERNEL_UNKNOWN;
+
+static void pickKernel()
+{
+    soaKernel = SOA_KERNEL_SCALAR;
+#ifdef BUBBLE_SOA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        soaKernel = SOA_KERNEL_AVX2;
+    else if (__builtin_cpu_supports("sse4.1"))
+        soaKernel = SOA_KERNEL_SSE;
+#endif
+}
+
+void integrateBubblesSoA(BUBBLE_SOA* s, float width, float height, float friction)
+{
+    if (soaKernel == SOA_KERNEL_UNKNOWN)
+        pickKernel();
+
+    int done = 0;
+#ifdef BUBBLE_SOA_X86
+    if (soaKernel == SOA_KERNEL_AVX2)
+        done = integrateAVX2(s, width, height, friction);
+    else if (soaKernel == SOA_KERNEL_SSE)
+        done = integrateSSE(s, width, height, friction);
+#endif
+
+    // leftover bubbles that don't fill a whole register
+    integrateScalar(s, done, width, height, friction);
+}
+
+const char* bubbleSoAKernelName()
+{
+    if (soaKernel == SOA_KERNEL_UNKNOWN)
+        pickKernel();
+
+    switch (soaKernel) {
+    case SOA_KERNEL_AVX2: return "avx2";
+    case SOA_KERNEL_SSE: return "sse";
+    default: return "scalar";
+    }
+}
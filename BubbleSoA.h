@@ -0,0 +1,43 @@
+#ifndef BUBBLE_SOA_H
+#define BUBBLE_SOA_H
+
+// structure of arrays bubble storage for large bubble counts
+// every array is 32 byte aligned and padded to a multiple of 8 so the
+// kernels can always work on whole AVX registers
+//
+// a bench only unit, BubbleBench's --mode soa is the one user and the saver
+// isn't built with it. the saver and BubbleParallel step the BUBBLE array,
+// whose integrate also does gravity, damping, sleeping and the desktop field,
+// which these kernels don't, and converting the whole pool to and from arrays
+// every step would cost more than the kernels save
+//
+// only what the integration reads and writes is kept, bubblesFromSoA leaves
+// everything else in the BUBBLE alone
+
+#include "BubblePhysics.h"
+
+struct BUBBLE_SOA {
+    int count;
+    int capacity;
+    float* x;
+    float* y;
+    float* r;
+    float* xVel;
+    float* yVel;
+    void* block; // single allocation every array above points into
+};
+
+bool initBubbleSoA(BUBBLE_SOA* s, int capacity);
+void freeBubbleSoA(BUBBLE_SOA* s);
+
+void bubblesToSoA(const BUBBLE* src, int count, BUBBLE_SOA* dst);
+void bubblesFromSoA(const BUBBLE_SOA* src, BUBBLE* dst);
+
+// moves every bubble by its velocity then bounces it off the walls,
+// same results as running the position update and wallCheck on each bubble
+void integrateBubblesSoA(BUBBLE_SOA* s, float width, float height, float friction);
+
+// which kernel integrateBubblesSoA picked for this cpu ("avx2", "sse" or "scalar")
+const char* bubbleSoAKernelName();
+
+#endif
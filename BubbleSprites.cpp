@@ -0,0 +1,310 @@
+#include "BubbleSprites.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BUBBLE_SPRITES_X86
+#include <immintrin.h>
+#endif
+
+void initSpriteAtlas(SPRITE_ATLAS* atlas)
+{
+    memset(atlas, 0, sizeof(SPRITE_ATLAS));
+}
+
+size_t spriteAtlasBytes(const SPRITE_ATLAS* atlas)
+{
+    return atlas->bytes;
+}
+
+void freeSpriteAtlas(SPRITE_ATLAS* atlas)
+{
+    for (int hard = 0; hard < 2; hard++) {
+        for (int i = 0; i < SPRITE_BUCKETS; i++)
+            free(atlas->sprites[hard][i].coverage);
+    }
+    memset(atlas, 0, sizeof(SPRITE_ATLAS));
+}
+
+// nearest bucket, a quarter pixel apart up to SPRITE_FINE_RADIUS and half a pixel after
+static int spriteBucket(float r)
+{
+    int bucket;
+    if (r < SPRITE_FINE_RADIUS)
+        bucket = (int) (r * 4 + 0.5f);
+    else
+        bucket = SPRITE_FINE_BUCKETS + (int) ((r - SPRITE_FINE_RADIUS) * 2 + 0.5f);
+    return bucket > 0 ? bucket : 1;
+}
+
+static float bucketRadius(int bucket)
+{
+    if (bucket < SPRITE_FINE_BUCKETS)
+        return bucket / 4.0f;
+    return SPRITE_FINE_RADIUS + (bucket - SPRITE_FINE_BUCKETS) / 2.0f;
+}
+
+// coverage is stored as 0 - 255 but blended as 0 - 256, c + (c >> 7) maps one to the other
+// (exactly, apart from 128 which comes back as 127)
+static uint8_t packCoverage(int coverage)
+{
+    return (uint8_t) (coverage < 128 ? coverage : coverage - 1);
+}
+
+// the same coverage drawCircleAA (or drawCircleHard) works out per pixel
+static void rasterizeMask(uint8_t* mask, int size, float cx, float cy, float r, bool hard)
+{
+    float r2 = r * r;
+    float inner = r - 0.5f > 0 ? r - 0.5f : 0;
+    float outer = r + 0.5f;
+    float inner2 = inner * inner;
+    float outer2 = outer * outer;
+
+    for (int y = 0; y < size; y++) {
+        float dy = y + 0.5f - cy;
+        float dy2 = dy * dy;
+
+        for (int x = 0; x < size; x++) {
+            float dx = x + 0.5f - cx;
+            float d2 = dx * dx + dy2;
+
+            int coverage;
+            if (hard)
+                coverage = d2 <= r2 ? 256 : 0;
+            else if (d2 >= outer2)
+                coverage = 0;
+            else if (d2 <= inner2)
+                coverage = 256;
+            else
+                coverage = (int) ((outer - sqrtf(d2)) * 256);
+            mask[y * size + x] = packCoverage(coverage);
+        }
+    }
+}
+
+const CIRCLE_SPRITE* atlasSprite(SPRITE_ATLAS* atlas, float r, bool hard)
+{
+    if (r > MAX_SPRITE_RADIUS || !(r > 0))
+        return NULL;
+    int bucket = spriteBucket(r);
+    CIRCLE_SPRITE* sprite = &atlas->sprites[hard][bucket];
+    if (sprite->coverage)
+        return sprite;
+
+    r = bucketRadius(bucket);
+    int rCeil = (int) ceilf(r);
+    int size = 2 * rCeil + 3;
+    size_t maskBytes = (size_t) size * size;
+    size_t bytes = maskBytes * SPRITE_PHASES * SPRITE_PHASES;
+    if (atlas->bytes + bytes > SPRITE_ATLAS_BUDGET)
+        return NULL;
+    uint8_t* coverage = (uint8_t*) malloc(bytes);
+    if (!coverage)
+        return NULL;
+
+    for (int py = 0; py < SPRITE_PHASES; py++) {
+        for (int px = 0; px < SPRITE_PHASES; px++) {
+            float cx = rCeil + 1 + (float) px / SPRITE_PHASES;
+            float cy = rCeil + 1 + (float) py / SPRITE_PHASES;
+            rasterizeMask(coverage + (py * SPRITE_PHASES + px) * maskBytes, size, cx, cy, r, hard);
+        }
+    }
+
+    sprite->r = r;
+    sprite->hard = hard;
+    sprite->size = size;
+    sprite->coverage = coverage;
+    atlas->count++;
+    atlas->bytes += bytes;
+    return sprite;
+}
+
+// dst * (256 - c) + color * c per channel, the same sum the SIMD kernels do in 16 bit lanes
+static void blendRowScalar(uint32_t* dst, const uint8_t* coverage, int begin, int count, uint32_t color)
+{
+    for (int i = begin; i < count; i++) {
+        int c = coverage[i];
+        if (c == 0)
+            continue;
+        c += c >> 7;
+
+        uint32_t d = dst[i];
+        uint32_t r = (((d >> 16) & 0xff) * (256 - c) + ((color >> 16) & 0xff) * c) >> 8;
+        uint32_t g = (((d >> 8) & 0xff) * (256 - c) + ((color >> 8) & 0xff) * c) >> 8;
+        uint32_t b = ((d & 0xff) * (256 - c) + (color & 0xff) * c) >> 8;
+        dst[i] = (r << 16) | (g << 8) | b;
+    }
+}
+
+#ifdef BUBBLE_SPRITES_X86
+// 4 pixels at a time, each channel widened to 16 bits
+// runs of empty coverage are skipped and full ones just stored, like a colour key
+__attribute__((target("sse2")))
+static int blendRowSSE2(uint32_t* dst, const uint8_t* coverage, int count, uint32_t color)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i colorPixels = _mm_set1_epi32((int) color);
+    const __m128i colorWide = _mm_unpacklo_epi8(colorPixels, zero);
+
+    int n = count & ~3;
+    for (int i = 0; i < n; i += 4) {
+        uint32_t c4;
+        memcpy(&c4, coverage + i, sizeof(c4));
+        if (c4 == 0)
+            continue;
+        if (c4 == 0xffffffff) {
+            _mm_storeu_si128((__m128i*) (dst + i), colorPixels);
+            continue;
+        }
+
+        // one coverage byte per channel
+        __m128i c = _mm_cvtsi32_si128((int) c4);
+        c = _mm_unpacklo_epi8(c, c);
+        c = _mm_unpacklo_epi16(c, c);
+        __m128i cLo = _mm_unpacklo_epi8(c, zero);
+        __m128i cHi = _mm_unpackhi_epi8(c, zero);
+        cLo = _mm_add_epi16(cLo, _mm_srli_epi16(cLo, 7));
+        cHi = _mm_add_epi16(cHi, _mm_srli_epi16(cHi, 7));
+
+        __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+        __m128i dLo = _mm_unpacklo_epi8(d, zero);
+        __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(full, cLo)), _mm_mullo_epi16(colorWide, cLo));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(full, cHi)), _mm_mullo_epi16(colorWide, cHi));
+        __m128i blended = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i*) (dst + i), blended);
+    }
+    return n;
+}
+
+// same as above 8 pixels at a time
+__attribute__((target("avx2")))
+static int blendRowAVX2(uint32_t* dst, const uint8_t* coverage, int count, uint32_t color)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i full = _mm256_set1_epi16(256);
+    const __m256i spread = _mm256_set1_epi32(0x01010101);
+    const __m256i colorPixels = _mm256_set1_epi32((int) color);
+    const __m256i colorWide = _mm256_unpacklo_epi8(colorPixels, zero);
+
+    int n = count & ~7;
+    for (int i = 0; i < n; i += 8) {
+        uint64_t c8;
+        memcpy(&c8, coverage + i, sizeof(c8));
+        if (c8 == 0)
+            continue;
+        if (c8 == 0xffffffffffffffffULL) {
+            _mm256_storeu_si256((__m256i*) (dst + i), colorPixels);
+            continue;
+        }
+
+        __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (coverage + i)));
+        c = _mm256_mullo_epi32(c, spread);
+        __m256i cLo = _mm256_unpacklo_epi8(c, zero);
+        __m256i cHi = _mm256_unpackhi_epi8(c, zero);
+        cLo = _mm256_add_epi16(cLo, _mm256_srli_epi16(cLo, 7));
+        cHi = _mm256_add_epi16(cHi, _mm256_srli_epi16(cHi, 7));
+
+        __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+        __m256i dLo = _mm256_unpacklo_epi8(d, zero);
+        __m256i dHi = _mm256_unpackhi_epi8(d, zero);
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(dLo, _mm256_sub_epi16(full, cLo)), _mm256_mullo_epi16(colorWide, cLo));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(dHi, _mm256_sub_epi16(full, cHi)), _mm256_mullo_epi16(colorWide, cHi));
+        __m256i blended = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+        _mm256_storeu_si256((__m256i*) (dst + i), blended);
+    }
+    return n;
+}
+#endif
+
+enum SPRITE_KERNEL { SPRITE_KERNEL_UNKNOWN, SPRITE_KERNEL_SCALAR, SPRITE_KERNEL_SSE2, SPRITE_KERNEL_AVX2 };
+static SPRITE_KERNEL spriteKernel = SPRITE_KERNEL_UNKNOWN;
+
+static void pickKernel()
+{
+    spriteKernel = SPRITE_KERNEL_SCALAR;
+#ifdef BUBBLE_SPRITES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        spriteKernel = SPRITE_KERNEL_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        spriteKernel = SPRITE_KERNEL_SSE2;
+#endif
+}
+
+static void blendRow(uint32_t* dst, const uint8_t* coverage, int count, uint32_t color)
+{
+    int done = 0;
+#ifdef BUBBLE_SPRITES_X86
+    if (spriteKernel == SPRITE_KERNEL_AVX2)
+        done = blendRowAVX2(dst, coverage, count, color);
+    else if (spriteKernel == SPRITE_KERNEL_SSE2)
+        done = blendRowSSE2(dst, coverage, count, color);
+#endif
+
+    // leftover pixels that don't fill a whole register
+    blendRowScalar(dst, coverage, done, count, color);
+}
+
+void drawCircleSprite(FRAMEBUFFER* fb, const CIRCLE_SPRITE* sprite, float cx, float cy, uint32_t color, DIRTY_RECT clip)
+{
+    if (spriteKernel == SPRITE_KERNEL_UNKNOWN)
+        pickKernel();
+
+    // snap the centre to the phase grid, the whole pixel part positions the mask
+    int qx = (int) floorf(cx * SPRITE_PHASES + 0.5f);
+    int qy = (int) floorf(cy * SPRITE_PHASES + 0.5f);
+    int px = qx & (SPRITE_PHASES - 1);
+    int py = qy & (SPRITE_PHASES - 1);
+    int rCeil = (int) ceilf(sprite->r);
+    int originX = (qx - px) / SPRITE_PHASES - rCeil - 1;
+    int originY = (qy - py) / SPRITE_PHASES - rCeil - 1;
+
+    int size = sprite->size;
+    const uint8_t* mask = sprite->coverage + (size_t) (py * SPRITE_PHASES + px) * size * size;
+
+    int left = originX > clip.left ? originX : clip.left;
+    int top = originY > clip.top ? originY : clip.top;
+    int right = originX + size < clip.right ? originX + size : clip.right;
+    int bottom = originY + size < clip.bottom ? originY + size : clip.bottom;
+    if (left < 0) left = 0;
+    if (top < 0) top = 0;
+    if (right > fb->width) right = fb->width;
+    if (bottom > fb->height) bottom = fb->height;
+    if (left >= right || top >= bottom)
+        return;
+
+    for (int y = top; y < bottom; y++) {
+        blendRow(fb->pixels + (size_t) y * fb->stride + left,
+            mask + (size_t) (y - originY) * size + (left - originX),
+            right - left, color);
+    }
+}
+
+void drawCircle(FRAMEBUFFER* fb, SPRITE_ATLAS* atlas, float cx, float cy, float r, uint32_t color, bool hard, DIRTY_RECT clip)
+{
+    const CIRCLE_SPRITE* sprite = atlas ? atlasSprite(atlas, r, hard) : NULL;
+    if (sprite)
+        drawCircleSprite(fb, sprite, cx, cy, color, clip);
+    else if (hard)
+        drawCircleHard(fb, cx, cy, r, color, clip);
+    else
+        drawCircleAA(fb, cx, cy, r, color, clip);
+}
+
+const char* spriteKernelName()
+{
+    if (spriteKernel == SPRITE_KERNEL_UNKNOWN)
+        pickKernel();
+
+    switch (spriteKernel) {
+    case SPRITE_KERNEL_AVX2: return "avx2";
+    case SPRITE_KERNEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
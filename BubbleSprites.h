@@ -0,0 +1,66 @@
+#ifndef BUBBLE_SPRITES_H
+#define BUBBLE_SPRITES_H
+
+// pre-rasterized circle coverage masks
+// instead of working out the anti-aliased edge of every circle every frame,
+// each radius is rasterized once at SPRITE_PHASES x SPRITE_PHASES sub-pixel
+// offsets and drawing a bubble is just blending the closest mask into the
+// framebuffer (SSE2/AVX2 when the cpu has them). centres snap to the nearest
+// 1/SPRITE_PHASES of a pixel and radii to the nearest bucket, a quarter pixel
+// apart up to SPRITE_FINE_RADIUS and half a pixel above, so bubbles of any
+// mix of sizes share a few hundred masks at most. a circle drawn from a
+// sprite has its radius up to 1/8 of a pixel off (1/4 above
+// SPRITE_FINE_RADIUS) and its centre up to sqrt(2) / 8, so its edge is at
+// most 0.31 of a pixel from where it should be (0.43 above), and always
+// inside circleBounds
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BubbleRaster.h"
+
+const int SPRITE_PHASES = 4;
+const int MAX_SPRITE_RADIUS = 256; // bigger circles fall back to drawCircleAA
+const int SPRITE_FINE_RADIUS = 32;
+const int SPRITE_FINE_BUCKETS = SPRITE_FINE_RADIUS * 4;
+const int SPRITE_BUCKETS = SPRITE_FINE_BUCKETS + (MAX_SPRITE_RADIUS - SPRITE_FINE_RADIUS) * 2 + 1;
+// masks a whole pixel wide or more at a time (a 256 px one is 4 MB), past this
+// many bytes new radii fall back to drawCircleAA too
+const size_t SPRITE_ATLAS_BUDGET = 32 * 1024 * 1024;
+
+struct CIRCLE_SPRITE {
+    float r;            // the bucket's radius
+    bool hard;          // all or nothing like drawCircleHard
+    int size;           // masks are size x size, the circle sits at (ceil(r) + 1 + phase / SPRITE_PHASES) in each
+    uint8_t* coverage;  // SPRITE_PHASES^2 masks, phase (px, py) starts at (py * SPRITE_PHASES + px) * size * size
+                        // 0 = outside, 255 = fully covered
+};
+
+struct SPRITE_ATLAS {
+    int count;    // sprites rasterized
+    size_t bytes; // their masks
+    CIRCLE_SPRITE sprites[2][SPRITE_BUCKETS]; // [hard][radius bucket], coverage NULL until first asked for
+};
+
+void initSpriteAtlas(SPRITE_ATLAS* atlas);
+void freeSpriteAtlas(SPRITE_ATLAS* atlas);
+
+// the sprite for r's bucket, rasterized the first time it's asked for, with
+// coverage 0 or 255 only if hard. NULL if r is too big or the atlas is over budget
+const CIRCLE_SPRITE* atlasSprite(SPRITE_ATLAS* atlas, float r, bool hard);
+
+// memory held by the masks rasterized so far
+size_t spriteAtlasBytes(const SPRITE_ATLAS* atlas);
+
+// same result as drawCircleAA (to within a level per channel), or drawCircleHard
+// for a hard sprite, of a circle with the sprite's r and the centre snapped to
+// the phase grid
+void drawCircleSprite(FRAMEBUFFER* fb, const CIRCLE_SPRITE* sprite, float cx, float cy, uint32_t color, DIRTY_RECT clip);
+
+// draws with the atlas when it has the radius and drawCircleAA (drawCircleHard if hard) otherwise
+void drawCircle(FRAMEBUFFER* fb, SPRITE_ATLAS* atlas, float cx, float cy, float r, uint32_t color, bool hard, DIRTY_RECT clip);
+
+// which blend kernel drawCircleSprite picked for this cpu ("avx2", "sse2" or "scalar")
+const char* spriteKernelName();
+
+#endif
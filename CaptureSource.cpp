@@ -0,0 +1,120 @@
+#include "CaptureSource.h"
+#include "ImageFile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void initCaptureCache(CAPTURE_CACHE* cache, CAPTURE_SOURCE source, int interval)
+{
+    memset(cache, 0, sizeof(CAPTURE_CACHE));
+    cache->source = source;
+    cache->interval = interval;
+}
+
+void freeCaptureCache(CAPTURE_CACHE* cache)
+{
+    if (cache->source.destroy)
+        cache->source.destroy(cache->source.context);
+    memset(cache, 0, sizeof(CAPTURE_CACHE));
+}
+
+void captureInvalidate(CAPTURE_CACHE* cache)
+{
+    __atomic_store_n(&cache->invalidated, 1, __ATOMIC_RELEASE);
+}
+
+bool captureFrame(CAPTURE_CACHE* cache, FRAMEBUFFER* dst)
+{
+    cache->framesSinceGrab++;
+
+    bool due = !cache->hasFrame || (cache->interval > 0 && cache->framesSinceGrab >= cache->interval);
+    // clear the flag even when grabbing on the timer, this grab covers the change too
+    bool invalidated = __atomic_exchange_n(&cache->invalidated, 0, __ATOMIC_ACQ_REL);
+
+    if (!due && !invalidated) {
+        cache->reuses++;
+        return false;
+    }
+
+    if (!cache->source.grab(cache->source.context, dst)) {
+        // try again next frame, whatever is in dst stays on screen
+        captureInvalidate(cache);
+        return false;
+    }
+
+    cache->hasFrame = true;
+    cache->framesSinceGrab = 0;
+    cache->grabs++;
+    return true;
+}
+
+//=======================Synthetic source=====================
+
+struct SYNTHETIC_CAPTURE {
+    int frame;
+};
+
+static bool grabSynthetic(void* context, FRAMEBUFFER* dst)
+{
+    SYNTHETIC_CAPTURE* s = (SYNTHETIC_CAPTURE*) context;
+    int shift = s->frame++;
+
+    for (int y = 0; y < dst->height; y++) {
+        uint32_t* row = dst->pixels + (size_t) y * dst->stride;
+        for (int x = 0; x < dst->width; x++) {
+            uint32_t r = (x + shift) & 0xff;
+            uint32_t g = (y + shift) & 0xff;
+            uint32_t b = (x ^ y) & 0xff;
+            row[x] = (r << 16) | (g << 8) | b;
+        }
+    }
+    return true;
+}
+
+CAPTURE_SOURCE createSyntheticCapture()
+{
+    CAPTURE_SOURCE source;
+    source.context = calloc(1, sizeof(SYNTHETIC_CAPTURE));
+    source.grab = grabSynthetic;
+    source.destroy = free;
+    return source;
+}
+
+//=======================File source=====================
+
+static bool grabFile(void* context, FRAMEBUFFER* dst)
+{
+    const FRAMEBUFFER* image = (const FRAMEBUFFER*) context;
+
+    // nearest neighbour stretch, like StretchBlt-ing the desktop into the window
+    for (int y = 0; y < dst->height; y++) {
+        const uint32_t* src = image->pixels + (size_t) (y * image->height / dst->height) * image->stride;
+        uint32_t* row = dst->pixels + (size_t) y * dst->stride;
+        for (int x = 0; x < dst->width; x++)
+            row[x] = src[x * image->width / dst->width];
+    }
+    return true;
+}
+
+static void destroyFile(void* context)
+{
+    FRAMEBUFFER* image = (FRAMEBUFFER*) context;
+    if (image)
+        free(image->pixels);
+    free(image);
+}
+
+CAPTURE_SOURCE createFileCapture(const char* path)
+{
+    CAPTURE_SOURCE source = {};
+    FRAMEBUFFER* image = (FRAMEBUFFER*) calloc(1, sizeof(FRAMEBUFFER));
+
+    if (image && loadPPM(path, image)) {
+        source.context = image;
+        source.grab = grabFile;
+        source.destroy = destroyFile;
+    } else {
+        free(image);
+    }
+    return source;
+}
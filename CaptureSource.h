@@ -0,0 +1,44 @@
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+// where the background picture behind the bubbles comes from
+// the screensaver grabs the desktop through GDI, the synthetic and file
+// sources stand in for it so capture caching can be run without windows
+
+#include "BubbleRaster.h"
+
+struct CAPTURE_SOURCE {
+    void* context;
+    // fills dst with a fresh frame, returns false if the grab failed
+    bool (*grab)(void* context, FRAMEBUFFER* dst);
+    void (*destroy)(void* context);
+};
+
+// decides when the source actually has to be grabbed and otherwise keeps
+// the last frame (which lives in the framebuffer passed to captureFrame)
+struct CAPTURE_CACHE {
+    CAPTURE_SOURCE source;
+    int interval;          // re-grab every interval frames, 0 to only grab on captureInvalidate
+    int framesSinceGrab;
+    bool hasFrame;
+    int invalidated;       // set from any thread by captureInvalidate
+    long long grabs;
+    long long reuses;
+};
+
+void initCaptureCache(CAPTURE_CACHE* cache, CAPTURE_SOURCE source, int interval);
+void freeCaptureCache(CAPTURE_CACHE* cache);
+
+// marks the cached frame stale (e.g. a window moved), safe to call from any thread
+void captureInvalidate(CAPTURE_CACHE* cache);
+
+// call once per frame, returns true if dst was re-grabbed and everything drawn over it is stale
+bool captureFrame(CAPTURE_CACHE* cache, FRAMEBUFFER* dst);
+
+// moving gradient that changes on every grab, for benchmarks
+CAPTURE_SOURCE createSyntheticCapture();
+// binary PPM scaled to fit the framebuffer, the same picture every grab
+// source.grab is NULL if the file couldn't be loaded
+CAPTURE_SOURCE createFileCapture(const char* path);
+
+#endif
@@ -0,0 +1,296 @@
+#include "Config.h"
+#include "BubblePhysics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+void defaultConfig(CONFIG* config)
+{
+    config->generation = 0;
+    config->bubbles = NUMBER_OF_BUBBLES;
+    config->maxBubbles = 0;
+    config->continuousCollision = false;
+    config->captureInterval = 15;
+    config->statsInterval = 10;
+    config->physicsThreads = 1;
+    config->impulseResponse = true;
+    config->restitution = 1;
+    config->gravity = 0;
+    config->friction = 1;
+    config->ballFriction = 1;
+    config->damping = 1;
+    config->sleep = true;
+    config->seed = 0;
+    config->recordPath[0] = 0;
+    config->spanMonitors = true;
+    config->frameRate = 0;
+    snprintf(config->radiusDistribution, sizeof(config->radiusDistribution), "fixed");
+    config->minRadius = 0;
+    config->maxRadius = 0;
+    config->ballEnergyTransfer = 0.2f;
+    config->idleAfter = 10000;
+    config->warmUp = 1000;
+    config->backgroundColor = 0x191919;
+    snprintf(config->desktopField, sizeof(config->desktopField), "off");
+    config->edgeThreshold = 48;
+    config->brightThreshold = 224;
+}
+
+static char* trim(char* s)
+{
+    while (isspace((unsigned char) *s))
+        s++;
+
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char) end[-1]))
+        end--;
+    *end = 0;
+    return s;
+}
+
+// "r,g,b" or one number like 0x191919 (# would start a comment)
+static unsigned int parseColor(const char* value)
+{
+    if (!strchr(value, ','))
+        return strtoul(value, NULL, 0) & 0xffffff;
+
+    int r = 0, g = 0, b = 0;
+    sscanf(value, "%d , %d , %d", &r, &g, &b);
+    r = r < 0 ? 0 : r > 255 ? 255 : r;
+    g = g < 0 ? 0 : g > 255 ? 255 : g;
+    b = b < 0 ? 0 : b > 255 ? 255 : b;
+    return (r << 16) | (g << 8) | b;
+}
+
+// applies one setting, key spellings match the command line without the dashes
+static void setConfigValue(CONFIG* config, const char* key, const char* value)
+{
+    if (!strcmp(key, "bubbles")) {
+        config->bubbles = atoi(value);
+    } else if (!strcmp(key, "max_bubbles") || !strcmp(key, "max-bubbles")) {
+        config->maxBubbles = atoi(value);
+    } else if (!strcmp(key, "continuous_collision") || !strcmp(key, "continuous-collision")) {
+        config->continuousCollision = atoi(value) != 0;
+    } else if (!strcmp(key, "capture_interval") || !strcmp(key, "capture-interval")) {
+        config->captureInterval = atoi(value);
+    } else if (!strcmp(key, "stats_interval") || !strcmp(key, "stats-interval")) {
+        config->statsInterval = atof(value);
+    } else if (!strcmp(key, "physics_threads") || !strcmp(key, "physics-threads")) {
+        config->physicsThreads = atoi(value);
+    } else if (!strcmp(key, "impulse_response") || !strcmp(key, "impulse-response")) {
+        config->impulseResponse = atoi(value) != 0;
+    } else if (!strcmp(key, "restitution")) {
+        config->restitution = (float) atof(value);
+    } else if (!strcmp(key, "gravity")) {
+        config->gravity = (float) atof(value);
+    } else if (!strcmp(key, "friction")) {
+        config->friction = (float) atof(value);
+    } else if (!strcmp(key, "ball_friction") || !strcmp(key, "ball-friction")) {
+        config->ballFriction = (float) atof(value);
+    } else if (!strcmp(key, "damping")) {
+        config->damping = (float) atof(value);
+    } else if (!strcmp(key, "sleep")) {
+        config->sleep = atoi(value) != 0;
+    } else if (!strcmp(key, "seed")) {
+        config->seed = strtoul(value, NULL, 10);
+    } else if (!strcmp(key, "record")) {
+        snprintf(config->recordPath, sizeof(config->recordPath), "%s", value);
+    } else if (!strcmp(key, "span_monitors") || !strcmp(key, "span-monitors")) {
+        config->spanMonitors = atoi(value) != 0;
+    } else if (!strcmp(key, "frame_rate") || !strcmp(key, "frame-rate")) {
+        config->frameRate = atof(value);
+    } else if (!strcmp(key, "radius_distribution") || !strcmp(key, "radius-distribution")) {
+        snprintf(config->radiusDistribution, sizeof(config->radiusDistribution), "%s", value);
+    } else if (!strcmp(key, "min_radius") || !strcmp(key, "min-radius")) {
+        config->minRadius = (float) atof(value);
+    } else if (!strcmp(key, "max_radius") || !strcmp(key, "max-radius")) {
+        config->maxRadius = (float) atof(value);
+    } else if (!strcmp(key, "ball_energy_transfer") || !strcmp(key, "ball-energy-transfer")) {
+        config->ballEnergyTransfer = (float) atof(value);
+    } else if (!strcmp(key, "idle_after") || !strcmp(key, "idle-after")) {
+        config->idleAfter = atoi(value);
+    } else if (!strcmp(key, "warm_up") || !strcmp(key, "warm-up")) {
+        config->warmUp = atoi(value);
+    } else if (!strcmp(key, "background_color") || !strcmp(key, "background-color")) {
+        config->backgroundColor = parseColor(value);
+    } else if (!strcmp(key, "desktop_field") || !strcmp(key, "desktop-field")) {
+        snprintf(config->desktopField, sizeof(config->desktopField), "%s", value);
+    } else if (!strcmp(key, "edge_threshold") || !strcmp(key, "edge-threshold")) {
+        config->edgeThreshold = atoi(value);
+    } else if (!strcmp(key, "bright_threshold") || !strcmp(key, "bright-threshold")) {
+        config->brightThreshold = atoi(value);
+    } else {
+        printf("Unknown setting %s\n", key);
+    }
+}
+
+// whole file as a string, NULL if it can't be read. free it when done
+static char* readConfigText(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = size >= 0 ? (char*) malloc(size + 1) : NULL;
+    if (text) {
+        size = (long) fread(text, 1, size, f);
+        text[size] = 0;
+    }
+
+    fclose(f);
+    return text;
+}
+
+// FNV-1a, to tell whether the file changed since the last load
+static unsigned int hashConfigText(const char* text)
+{
+    unsigned int hash = 2166136261u;
+    for (; *text; text++) {
+        hash ^= (unsigned char) *text;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// key = value lines, text is cut up in place
+static void parseConfigText(char* text, CONFIG* config)
+{
+    char* line = text;
+    while (line) {
+        char* end = strchr(line, '\n');
+        if (end)
+            *end++ = 0;
+
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char* equals = strchr(line, '=');
+        if (equals) {
+            *equals = 0;
+            setConfigValue(config, trim(line), trim(equals + 1));
+        }
+        line = end;
+    }
+}
+
+bool loadConfigFile(const char* path, CONFIG* config)
+{
+    char* text = readConfigText(path);
+    if (!text)
+        return false;
+
+    parseConfigText(text, config);
+    free(text);
+    return true;
+}
+
+static const char* configPath(int argc, char** argv)
+{
+    const char* path = DEFAULT_CONFIG_PATH;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (!strcmp(argv[i], "--config"))
+            path = argv[i + 1];
+    }
+    return path;
+}
+
+// the command line on top of whatever the file set, then everything clamped
+static void finishConfig(int argc, char** argv, CONFIG* config)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            printf("Ignoring argument %s\n", argv[i]);
+            i--;
+            continue;
+        }
+        if (strcmp(argv[i], "--config") != 0)
+            setConfigValue(config, argv[i] + 2, argv[i + 1]);
+    }
+
+    if (config->bubbles < 1)
+        config->bubbles = 1;
+    if (config->maxBubbles < config->bubbles)
+        config->maxBubbles = config->bubbles;
+    if (config->frameRate < 0)
+        config->frameRate = 0;
+    if (config->minRadius < 0)
+        config->minRadius = 0;
+    if (config->maxRadius < 0)
+        config->maxRadius = 0;
+    if (config->idleAfter < 0)
+        config->idleAfter = 0;
+    if (config->warmUp < 0)
+        config->warmUp = 0;
+}
+
+void loadConfig(int argc, char** argv, CONFIG* config)
+{
+    defaultConfig(config);
+    loadConfigFile(configPath(argc, argv), config);
+    finishConfig(argc, argv, config);
+}
+
+void initConfigStore(CONFIG_STORE* store, int argc, char** argv)
+{
+    memset(store, 0, sizeof(CONFIG_STORE));
+    snprintf(store->path, sizeof(store->path), "%s", configPath(argc, argv));
+    store->argc = argc;
+    store->argv = argv;
+
+    CONFIG* config = &store->first;
+    defaultConfig(config);
+    char* text = readConfigText(store->path);
+    if (text) {
+        store->hasFile = true;
+        store->fileHash = hashConfigText(text);
+        parseConfigText(text, config);
+        free(text);
+    }
+    finishConfig(argc, argv, config);
+
+    __atomic_store_n(&store->current, config, __ATOMIC_RELEASE);
+}
+
+const CONFIG* configSnapshot(CONFIG_STORE* store)
+{
+    return __atomic_load_n(&store->current, __ATOMIC_ACQUIRE);
+}
+
+bool configReload(CONFIG_STORE* store)
+{
+    char* text = readConfigText(store->path);
+    if (!text)
+        return false;
+
+    unsigned int hash = hashConfigText(text);
+    if (store->hasFile && hash == store->fileHash) {
+        free(text);
+        return false;
+    }
+
+    // readers may still be holding any snapshot that was ever published, so never free this
+    CONFIG* config = (CONFIG*) malloc(sizeof(CONFIG));
+    if (!config) {
+        // the hash isn't taken, the next try reloads it
+        free(text);
+        return false;
+    }
+    defaultConfig(config);
+    parseConfigText(text, config);
+    free(text);
+    finishConfig(store->argc, store->argv, config);
+
+    store->hasFile = true;
+    store->fileHash = hash;
+    store->reloads++;
+    config->generation = store->reloads;
+    // release so the whole snapshot is visible before the pointer is
+    __atomic_store_n(&store->current, config, __ATOMIC_RELEASE);
+    return true;
+}
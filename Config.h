@@ -0,0 +1,100 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// settings read from HPBubbleScreensaver.cfg and the command line
+//
+// the config file is plain "key = value" lines, # starts a comment
+//     bubbles = 40
+//     max_bubbles = 200
+//
+// command line options override the file
+//     --config path  --bubbles N  --max-bubbles N  --continuous-collision 1
+//     --capture-interval N  --stats-interval seconds  --physics-threads N
+//     --seed N  --record path  --impulse-response 1  --restitution 0.9  --gravity 0.05
+//     --friction 1  --ball-friction 1  --damping 0.999  --sleep 1  --span-monitors 1
+//     --frame-rate 60  --radius-distribution power-law  --min-radius 4  --max-radius 400
+//     --ball-energy-transfer 0.2  --idle-after 10000  --warm-up 1000  --background-color 25,25,25
+//     --desktop-field edges  --edge-threshold 48  --bright-threshold 224
+//
+// the saver watches the file and picks up edits while it runs (CONFIG_STORE
+// below). bubbles (up to max_bubbles), the physics tuning (impulse_response,
+// restitution, gravity, friction, ball_friction, ball_energy_transfer, damping,
+// sleep, continuous_collision), frame_rate, capture_interval, stats_interval,
+// idle_after, warm_up, background_color and the desktop_field settings change
+// live. the rest size buffers or pick the monitors and bubbles, so they only
+// take effect on a restart
+
+const char DEFAULT_CONFIG_PATH[] = "HPBubbleScreensaver.cfg";
+
+struct CONFIG {
+    int bubbles;    // bubbles on screen
+    int maxBubbles; // size of the bubble pool, 0 means the same as bubbles
+    bool continuousCollision; // swept collisions so fast bubbles can't tunnel
+    int captureInterval; // re-grab the desktop every N frames (and whenever it changes), 0 = only on changes
+    double statsInterval; // seconds between frame timing log lines, 0 to turn them off
+    int physicsThreads; // 1 = the original one thread step, more uses the parallel step, 0 = one per core
+    bool impulseResponse; // momentum conserving collisions instead of the original reflect and nudge
+    float restitution; // bounciness of impulse collisions, 1 keeps all the energy
+    float gravity; // pulls bubbles down by this much speed every step (pixels / step^2)
+    float friction; // speed kept bouncing off a wall
+    float ballFriction; // speed kept bouncing off a bubble (original response only)
+    float damping; // speed kept every step
+    bool sleep; // stop simulating bubbles that have come to rest
+    unsigned int seed; // starting bubble positions, 0 picks one from the clock
+    char recordPath[260]; // replay file every physics step is written to (BubbleReplay.h), empty for none
+    bool spanMonitors; // one world across every monitor instead of just the one with the foreground window
+    double frameRate; // frames per second, 0 follows the display's refresh rate
+    char radiusDistribution[16]; // "fixed" (every bubble the size that fills the screen), "uniform", "power-law" or "bimodal"
+    float minRadius; // size range for the other distributions, 0 picks a tenth of the fixed size
+    float maxRadius; // and ten times it (at most a quarter of the world's shorter side)
+    float ballEnergyTransfer; // share of a bounce passed on to the other bubble (original response only)
+    int idleAfter; // ms without input before the saver shows
+    int warmUp; // ms before that the saver starts getting its first frame ready
+    char desktopField[16]; // bubbles bounce off the desktop's "edges" or "bright" parts too, or "off" (BackgroundField.h). not while recording
+    int edgeThreshold; // luminance step (0 - 255) between neighbouring 16 pixel cells that counts as an edge
+    int brightThreshold; // luminance (0 - 255) of a bright cell
+    unsigned int backgroundColor; // 0xRRGGBB, "r,g,b" or 0xrrggbb in the file. ANDed with the desktop grab (after the desktop field has scanned it), so 255,255,255 leaves it as is
+    long long generation; // CONFIG_STORE reloads before this snapshot was published, 0 for the first
+};
+
+void defaultConfig(CONFIG* config);
+
+// returns false if the file couldn't be opened (config is left untouched)
+bool loadConfigFile(const char* path, CONFIG* config);
+
+// defaults, then the config file (--config or DEFAULT_CONFIG_PATH), then the command line
+void loadConfig(int argc, char** argv, CONFIG* config);
+
+// live settings
+// a CONFIG_STORE hands out the settings as immutable snapshots. every load
+// builds a fresh CONFIG that nothing writes to once it's published, and readers
+// pick up the newest one with configSnapshot, one atomic load and no lock, so
+// the frame loop never waits on a reload. configReload reads the file and only
+// when its contents changed builds the next snapshot (defaults, the file, then
+// the command line again so overrides stick) in memory of its own and swaps
+// the pointer. retired snapshots are never freed or reused (a few hundred bytes
+// per edit of the file), so a reader can hold on to one as long as it likes.
+// to see whether anything changed since they last looked, readers compare
+// generation
+struct CONFIG_STORE {
+    CONFIG first;           // built by initConfigStore, every reload's is allocated
+    CONFIG* current;        // published with release, read with acquire
+    char path[260];
+    int argc;               // command line, applied again over every reload
+    char** argv;
+    bool hasFile;           // the file could be read at the last load
+    unsigned int fileHash;  // of the contents the current snapshot was built from
+    long long reloads;      // snapshots published after the first
+};
+
+// builds the first snapshot, like loadConfig
+void initConfigStore(CONFIG_STORE* store, int argc, char** argv);
+
+// newest snapshot, from any thread
+const CONFIG* configSnapshot(CONFIG_STORE* store);
+
+// from one thread at a time. returns true if the file changed and a new snapshot
+// was published. a file that went missing keeps the current settings
+bool configReload(CONFIG_STORE* store);
+
+#endif
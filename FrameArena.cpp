@@ -0,0 +1,137 @@
+#include "FrameArena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+const size_t ARENA_GRANULE = 64 * 1024; // blocks are sized in these
+
+struct FRAME_SPILL {
+    FRAME_SPILL* next;
+};
+
+static size_t alignUp(size_t bytes, size_t to)
+{
+    return (bytes + to - 1) & ~(to - 1);
+}
+
+static bool allocateBlock(FRAME_ARENA* a, size_t size)
+{
+    free(a->block);
+    a->block = NULL;
+    a->base = NULL;
+    a->size = 0;
+    if (size == 0)
+        return true;
+
+    size = alignUp(size, ARENA_GRANULE);
+    a->block = malloc(size + FRAME_ALIGN);
+    if (!a->block)
+        return false;
+    a->base = (unsigned char*) alignUp((uintptr_t) a->block, FRAME_ALIGN);
+    a->size = size;
+    return true;
+}
+
+static void freeSpills(FRAME_ARENA* a)
+{
+    while (a->spills) {
+        FRAME_SPILL* next = a->spills->next;
+        free(a->spills);
+        a->spills = next;
+    }
+}
+
+bool initFrameArena(FRAME_ARENA* a, size_t size)
+{
+    memset(a, 0, sizeof(FRAME_ARENA));
+    return allocateBlock(a, size);
+}
+
+void freeFrameArena(FRAME_ARENA* a)
+{
+    freeSpills(a);
+    free(a->block);
+    memset(a, 0, sizeof(FRAME_ARENA));
+}
+
+void frameArenaReset(FRAME_ARENA* a)
+{
+    // a quarter more than the frame that didn't fit, so the next slightly bigger one does
+    if (a->spills) {
+        freeSpills(a);
+        if (allocateBlock(a, a->frameBytes + a->frameBytes / 4))
+            a->grows++;
+    }
+    a->used = 0;
+    a->last = 0;
+    a->frameBytes = 0;
+}
+
+bool frameArenaReserve(FRAME_ARENA* a, size_t bytes)
+{
+    if (bytes <= a->size)
+        return true;
+    // nothing handed out this frame may be pointing into the old block
+    if (a->used || a->spills)
+        return false;
+    if (!allocateBlock(a, bytes))
+        return false;
+    a->grows++;
+    return true;
+}
+
+static void* spill(FRAME_ARENA* a, size_t bytes)
+{
+    FRAME_SPILL* s = (FRAME_SPILL*) malloc(FRAME_ALIGN + bytes);
+    if (!s)
+        return NULL;
+    s->next = a->spills;
+    a->spills = s;
+    a->spillCount++;
+    // the header sits in the first line, the data starts on the next one
+    return (unsigned char*) alignUp((uintptr_t) s + sizeof(FRAME_SPILL), FRAME_ALIGN);
+}
+
+void* frameAlloc(FRAME_ARENA* a, size_t bytes)
+{
+    bytes = alignUp(bytes ? bytes : 1, FRAME_ALIGN);
+    a->frameBytes += bytes;
+    if (a->frameBytes > a->peakBytes)
+        a->peakBytes = a->frameBytes;
+
+    if (a->used + bytes > a->size)
+        return spill(a, bytes);
+
+    a->last = a->used;
+    a->used += bytes;
+    return a->base + a->last;
+}
+
+void* frameRealloc(FRAME_ARENA* a, void* p, size_t oldBytes, size_t bytes)
+{
+    if (!p)
+        return frameAlloc(a, bytes);
+    if (bytes <= oldBytes)
+        return p;
+
+    // the newest allocation can just take more of what's after it
+    size_t grownEnd = a->last + alignUp(bytes, FRAME_ALIGN);
+    if (p == a->base + a->last && a->used && grownEnd <= a->size) {
+        a->frameBytes += grownEnd - a->used;
+        if (a->frameBytes > a->peakBytes)
+            a->peakBytes = a->frameBytes;
+        a->used = grownEnd;
+        return p;
+    }
+
+    void* moved = frameAlloc(a, bytes);
+    if (moved)
+        memcpy(moved, p, oldBytes);
+    return moved;
+}
+
+size_t frameArenaBytes(const FRAME_ARENA* a)
+{
+    return a->block ? a->size + FRAME_ALIGN : 0;
+}
@@ -0,0 +1,58 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+// scratch memory that only lives for one frame (or one physics step)
+//
+// frameAlloc bumps an offset through one block and frameArenaReset at the top
+// of the next frame takes everything back at once, so nothing in the frame loop
+// calls malloc or free. every allocation starts on its own cache line, arrays
+// handed to different threads never share one
+//
+// a frame that asks for more than the block holds still gets its memory, from
+// malloc (a spill), and the next reset frees the spills and grows the block to
+// what that frame needed plus some room, so only the first few frames spill
+//
+// an arena belongs to one thread, give each worker its own
+
+#include <stddef.h>
+
+const size_t FRAME_ALIGN = 64; // cache line
+
+struct FRAME_SPILL; // an allocation that didn't fit, freed by the reset
+
+struct FRAME_ARENA {
+    unsigned char* base;  // FRAME_ALIGN aligned, inside block
+    void* block;
+    size_t size;          // bytes from base
+    size_t used;
+    size_t last;          // offset of the newest allocation, frameRealloc grows it in place
+    size_t frameBytes;    // what this frame would have used with a big enough block
+    size_t peakBytes;     // the most any frame would have used
+    FRAME_SPILL* spills;
+    long long spillCount; // allocations that didn't fit, ever
+    long long grows;      // times the block was reallocated to fit
+};
+
+// size is a first guess, 0 leaves the block to the first reset
+bool initFrameArena(FRAME_ARENA* a, size_t size);
+void freeFrameArena(FRAME_ARENA* a);
+
+// starts a frame, everything allocated since the last reset goes away
+// grows the block first if the last frame spilled (only ever early on)
+void frameArenaReset(FRAME_ARENA* a);
+
+// makes sure a frame can use bytes without spilling, call right after the reset
+bool frameArenaReserve(FRAME_ARENA* a, size_t bytes);
+
+// uninitialized and FRAME_ALIGN aligned, NULL only if a spill couldn't be allocated
+void* frameAlloc(FRAME_ARENA* a, size_t bytes);
+
+// p (from frameAlloc on a, oldBytes long) grown to bytes with its contents kept
+// in place if it's the newest allocation and there's room, otherwise moved to a
+// new frameAlloc (the old space stays taken until the reset). NULL p is frameAlloc
+void* frameRealloc(FRAME_ARENA* a, void* p, size_t oldBytes, size_t bytes);
+
+// memory the arena holds between frames
+size_t frameArenaBytes(const FRAME_ARENA* a);
+
+#endif
@@ -0,0 +1,66 @@
+#include "FrameScheduler.h"
+
+#include <string.h>
+
+long long framePeriodForRate(double hz)
+{
+    return hz > 0 ? (long long) (1e9 / hz + 0.5) : 0;
+}
+
+void initFrameScheduler(FRAME_SCHEDULER* s, FRAME_CLOCK clock, long long period)
+{
+    memset(s, 0, sizeof(FRAME_SCHEDULER));
+    s->clock = clock;
+    s->period = period;
+    frameSchedulerRestart(s);
+}
+
+void frameSchedulerRestart(FRAME_SCHEDULER* s)
+{
+    s->next = s->clock.now(s->clock.context) + s->period;
+}
+
+void frameSchedulerSync(FRAME_SCHEDULER* s, long long vblank, long long period)
+{
+    if (period > 0)
+        s->period = period;
+
+    long long now = s->clock.now(s->clock.context);
+    bool late = now > s->next;
+
+    long long offset = s->next - vblank;
+    long long half = s->period / 2;
+    long long k = offset >= 0 ? (offset + half) / s->period : -((-offset + half) / s->period);
+    s->next = vblank + k * s->period;
+
+    // a frame that was on time mustn't become a drop because the deadline moved
+    // back past now (one that was already late still counts)
+    if (!late && s->next < now)
+        s->next += ((now - s->next) / s->period + 1) * s->period;
+}
+
+int frameSchedulerWait(FRAME_SCHEDULER* s)
+{
+    long long now = s->clock.now(s->clock.context);
+
+    // too late for this deadline (and maybe more), show it at the next one
+    long long missed = 0;
+    if (now > s->next) {
+        missed = (now - s->next) / s->period + 1;
+        s->next += missed * s->period;
+        s->dropped += missed;
+    }
+
+    s->clock.waitUntil(s->clock.context, s->next);
+
+    long long late = s->clock.now(s->clock.context) - s->next;
+    if (late > 0) {
+        s->lateWakeSum += late;
+        if (late > s->lateWakeMax)
+            s->lateWakeMax = late;
+    }
+
+    s->next += s->period;
+    s->frames++;
+    return missed > 0x7fffffff ? 0x7fffffff : (int) missed;
+}
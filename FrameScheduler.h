@@ -0,0 +1,50 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+// paces frames to the display refresh (or a fixed rate) with deadlines
+//
+// frame n is due at a fixed phase + n * period. after presenting a frame the
+// caller waits until the next deadline rather than for a fixed time, so how
+// long the frame took to draw doesn't change the rate. a frame that runs past
+// its deadline has missed that refresh, the deadlines it ran past are counted
+// as dropped and pacing carries on from the next one instead of trying to
+// catch up. frameSchedulerSync moves the phase (and period) to a vblank the
+// display reported, so the deadlines don't slowly drift through the real
+// refresh when the nominal rate is a little off (59.94 vs 60 Hz), which
+// otherwise shows up as a skipped or doubled frame every few seconds
+//
+// the clock is passed in so the same code runs against a simulated display
+
+struct FRAME_CLOCK {
+    void* context;
+    long long (*now)(void* context);                  // nanoseconds, any fixed starting point
+    void (*waitUntil)(void* context, long long time); // returns at time or (hopefully only just) after
+};
+
+struct FRAME_SCHEDULER {
+    FRAME_CLOCK clock;
+    long long period;       // nanoseconds between frames
+    long long next;         // deadline the current frame has to be finished by
+    long long frames;       // frames paced
+    long long dropped;      // deadlines missed
+    long long lateWakeSum;  // how long after their deadline the waits returned, in total
+    long long lateWakeMax;
+};
+
+// nanoseconds between frames at hz
+long long framePeriodForRate(double hz);
+
+void initFrameScheduler(FRAME_SCHEDULER* s, FRAME_CLOCK clock, long long period);
+
+// starts the deadlines from now (e.g. the window was minimized and nothing was paced)
+void frameSchedulerRestart(FRAME_SCHEDULER* s);
+
+// lines the deadlines up with a vblank at time vblank, period 0 keeps the current one
+// the next deadline moves to the nearest vblank, so it never skips a frame
+void frameSchedulerSync(FRAME_SCHEDULER* s, long long vblank, long long period);
+
+// call when a frame has been presented, waits until the next frame is due
+// returns how many deadlines this frame missed (0 when it was on time)
+int frameSchedulerWait(FRAME_SCHEDULER* s);
+
+#endif
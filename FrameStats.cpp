@@ -0,0 +1,132 @@
+#include "FrameStats.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+long long nowNanos()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (long long) ((double) now.QuadPart * 1e9 / freq.QuadPart);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+const char* frameStageName(int stage)
+{
+    switch (stage) {
+    case STAGE_CAPTURE: return "capture";
+    case STAGE_BACKGROUND: return "background";
+    case STAGE_PHYSICS: return "physics";
+    case STAGE_RASTERIZE: return "rasterize";
+    case STAGE_PRESENT: return "present";
+    default: return "?";
+    }
+}
+
+void initFrameStats(FRAME_STATS* stats)
+{
+    memset(stats, 0, sizeof(FRAME_STATS));
+    stats->lastLogNanos = nowNanos();
+}
+
+static int histogramBucket(long long nanos)
+{
+    if (nanos < HISTOGRAM_SUB_BUCKETS)
+        return nanos > 0 ? (int) nanos : 0;
+
+    // octave is the position of the top bit, the next 3 bits pick the sub bucket
+    int octave = 63 - __builtin_clzll((unsigned long long) nanos);
+    int sub = (int) (nanos >> (octave - 3)) & (HISTOGRAM_SUB_BUCKETS - 1);
+    int bucket = (octave - 2) * HISTOGRAM_SUB_BUCKETS + sub;
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// largest value that lands in bucket
+static long long bucketUpperBound(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+
+    int octave = bucket / HISTOGRAM_SUB_BUCKETS + 2;
+    int sub = bucket % HISTOGRAM_SUB_BUCKETS;
+    return ((long long) (HISTOGRAM_SUB_BUCKETS + sub + 1) << (octave - 3)) - 1;
+}
+
+void frameStatsRecord(FRAME_STATS* stats, FRAME_STAGE stage, long long nanos)
+{
+    __atomic_fetch_add(&stats->pending[stage], nanos, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->histogram[stage][histogramBucket(nanos)], 1, __ATOMIC_RELAXED);
+}
+
+void frameStatsEndFrame(FRAME_STATS* stats)
+{
+    long long frame = stats->frames;
+    FRAME_RECORD* record = &stats->history[frame & (FRAME_HISTORY - 1)];
+
+    record->frame = frame;
+    for (int s = 0; s < STAGE_COUNT; s++)
+        record->stageNanos[s] = __atomic_exchange_n(&stats->pending[s], 0, __ATOMIC_RELAXED);
+
+    // release so a reader that sees the new count also sees the record
+    __atomic_store_n(&stats->frames, frame + 1, __ATOMIC_RELEASE);
+}
+
+long long frameStatsPercentile(const FRAME_STATS* stats, int stage, double p, bool sinceLastLog)
+{
+    long long counts[HISTOGRAM_BUCKETS];
+    long long total = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        counts[b] = __atomic_load_n(&stats->histogram[stage][b], __ATOMIC_RELAXED);
+        if (sinceLastLog)
+            counts[b] -= stats->loggedHistogram[stage][b];
+        total += counts[b];
+    }
+
+    if (total == 0)
+        return 0;
+
+    long long target = (long long) (p * total);
+    if (target >= total)
+        target = total - 1;
+
+    long long seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen > target)
+            return bucketUpperBound(b);
+    }
+    return bucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+bool frameStatsLog(FRAME_STATS* stats, FILE* out, double intervalSeconds)
+{
+    long long now = nowNanos();
+    if (now - stats->lastLogNanos < intervalSeconds * 1e9)
+        return false;
+
+    fprintf(out, "frames %lld", __atomic_load_n(&stats->frames, __ATOMIC_ACQUIRE));
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        fprintf(out, " | %s p50 %.2fms p99 %.2fms", frameStageName(s),
+            frameStatsPercentile(stats, s, 0.5, true) / 1e6,
+            frameStatsPercentile(stats, s, 0.99, true) / 1e6);
+    }
+    fprintf(out, "\n");
+    fflush(out);
+
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+            stats->loggedHistogram[s][b] = __atomic_load_n(&stats->histogram[s][b], __ATOMIC_RELAXED);
+    }
+    stats->lastLogNanos = now;
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// low overhead per stage frame timing
+// stages can be recorded from any thread (physics runs on its own), everything
+// is plain atomic adds so recording never blocks the frame loop. each finished
+// frame is written to a ring buffer of recent frames and every sample also
+// goes into a log scale histogram per stage for the periodic log line
+
+#include <stdio.h>
+
+enum FRAME_STAGE {
+    STAGE_CAPTURE,     // grabbing the desktop
+    STAGE_BACKGROUND,  // restoring the background under dirty rects
+    STAGE_PHYSICS,     // simulation steps
+    STAGE_RASTERIZE,   // drawing the bubbles
+    STAGE_PRESENT,     // BitBlt to the window
+    STAGE_COUNT
+};
+
+const int FRAME_HISTORY = 256; // frames kept in the ring buffer, power of two
+
+// 8 buckets per power of two nanoseconds, up to ~4 seconds
+const int HISTOGRAM_SUB_BUCKETS = 8;
+const int HISTOGRAM_BUCKETS = 32 * HISTOGRAM_SUB_BUCKETS;
+
+struct FRAME_RECORD {
+    long long frame;
+    long long stageNanos[STAGE_COUNT];
+};
+
+struct FRAME_STATS {
+    long long frames; // frames finished so far, history[(frames - 1) % FRAME_HISTORY] is the newest
+    FRAME_RECORD history[FRAME_HISTORY];
+    long long pending[STAGE_COUNT]; // time recorded since the last frameStatsEndFrame
+    long long histogram[STAGE_COUNT][HISTOGRAM_BUCKETS];
+    long long loggedHistogram[STAGE_COUNT][HISTOGRAM_BUCKETS]; // histogram at the last log line
+    long long lastLogNanos;
+};
+
+// monotonic clock in nanoseconds
+long long nowNanos();
+
+const char* frameStageName(int stage);
+
+void initFrameStats(FRAME_STATS* stats);
+
+// adds nanos to stage for the current frame, safe from any thread
+void frameStatsRecord(FRAME_STATS* stats, FRAME_STAGE stage, long long nanos);
+
+// closes the current frame into the ring buffer, call from one thread only (the one presenting)
+void frameStatsEndFrame(FRAME_STATS* stats);
+
+// nanos below which fraction p (0 - 1) of the samples since the last log line fall
+long long frameStatsPercentile(const FRAME_STATS* stats, int stage, double p, bool sinceLastLog);
+
+// prints one line with p50/p99 of every stage since the last call, if intervalSeconds have passed
+// returns true if it printed
+bool frameStatsLog(FRAME_STATS* stats, FILE* out, double intervalSeconds);
+
+#endif
@@ -3,50 +3,139 @@
 #endif 
 
 #include <windows.h>
+#include <dwmapi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
 
-const COLORREF TRANSPARENT_COLOR = RGB(0, 0, 0);
-const COLORREF BACKGROUND_COLOR = RGB(1, 1, 1);
-const int TIME_TILL_IDLE = 10000; // time in milliseconds
+#include "BubblePhysics.h"
+#include "BubbleParallel.h"
+#include "SimClock.h"
+#include "TripleBuffer.h"
+#include "BubbleRaster.h"
+#include "Renderer.h"
+#include "Config.h"
+#include "CaptureSource.h"
+#include "FrameStats.h"
+#include "BubbleReplay.h"
+#include "MonitorLayout.h"
+#include "WorkPool.h"
+#include "IdleDetector.h"
+#include "FrameScheduler.h"
+#include "BackgroundField.h"
+
+// not in older MinGW headers
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
-HANDLE idleCheckHandle;
+const COLORREF TRANSPARENT_COLOR = RGB(0, 0, 0);
 
-int myWidth, myHeight;
-int monitorWidth, monitorHeight;
-HDC hDesktopDC, hMyDC, hdcMemDC;
-HBITMAP hMyBmp;
+// posted to the first window by the idle thread, the pipelines are only touched on the main thread
+const UINT WM_SAVER_WARM_UP = WM_APP + 1;
+const UINT WM_SAVER_COOL_DOWN = WM_APP + 2;
+
+HANDLE idleCheckHandle, physicsHandle, configWatchHandle;
+DWORD idleCheckThreadId; // the config watcher wakes it up when the idle timeouts change
+HANDLE physicsRunning; // manual reset event, the physics thread waits on it while the saver is suspended
+
+// shows and hides the saver (IdleDetector.h), only touched on the idle thread
+IDLE_DETECTOR idleDetector;
+HHOOK keyboardHook, mouseHook; // installed only while the saver is shown
+bool inputSeen; // set by the hooks, which run on the idle thread while it pumps messages
+
+// the GDI side of the renderer
+// the frame and background are DIB sections selected into memory DCs so the
+// rasterizer can draw into their pixels, present BitBlts the dirty rects to the window
+struct GDI_RENDERER {
+    HDC windowDC;
+    HDC desktopDC;
+    HDC frameDC;
+    HDC backgroundDC;
+    HBITMAP frameBmp;
+    HBITMAP backgroundBmp;
+    RECT desktop; // the part of the desktop DC this window's background is grabbed from
+    int width;
+    int height;
+};
 
-//=======================Bubble Stuff=====================
-const int NUMBER_OF_BUBBLES = 10;
-int BUBBLE_RADIUS = 120; // default 120 but will scale based on screen size
-
-struct BUBBLE {
-    float x;
-    float y;
-    float r;
-    float xVel;
-    float yVel;
-    float mass;
-    bool doGrav;
+// one fullscreen window per monitor, each showing its viewport of the one
+// bubble world (MonitorLayout.h). the first window's WM_PAINT draws them all
+struct MONITOR_WINDOW {
+    HWND hwnd;
+    RENDERER renderer;       // handed to pipeline once the bubbles are allocated
+    // desktop grabs are cached and only redone every few frames or when a window event says it changed
+    CAPTURE_CACHE capture;
+    FRAME_PIPELINE pipeline; // capture, background, bubbles and present for every WM_PAINT
 };
+MONITOR_WINDOW monitorWindows[MAX_MONITORS];
+MONITOR_LAYOUT monitorLayout;
+
+// with more than one monitor each gets a present thread
+WORK_POOL presentPool;
 
-BUBBLE bubbles[NUMBER_OF_BUBBLES];
+// settings from HPBubbleScreensaver.cfg and the command line, reloaded by the
+// config watcher thread whenever the file changes. every thread takes the newest
+// snapshot when it's between frames or steps and applies what changed (Config.h)
+CONFIG_STORE configStore;
 
-void initializeBubbles(); // populates bubbles array
-void wallCheck(BUBBLE* b);
-void collisionCheck(BUBBLE* b);
-void bubbleUpdate(BUBBLE* b);
-void DrawBubbles();
+HWINEVENTHOOK foregroundHook, objectHook;
+
+// per stage timings, printed every statsInterval seconds
+FRAME_STATS frameStats;
+
+// WM_PAINT waits on it between frames, resynced to the compositor's vblank every FRAME_SYNC_INTERVAL frames
+FRAME_SCHEDULER frameScheduler;
+const int FRAME_SYNC_INTERVAL = 60;
+HANDLE frameTimer;          // waitable timer the scheduler sleeps on
+long long frameSpinNanos;   // how much before the deadline the timer goes off, the rest is spun
+double frameRateSetting;    // config frameRate the period came from, the period itself is resynced to the display
+bool coarseFrameTimer;      // the fallback timer, it needs the 1 ms system tick while the saver shows
+bool frameTickRaised;       // timeBeginPeriod(1) is in effect
+
+//=======================Bubble Stuff=====================
+// bubble physics lives in BubblePhysics.cpp
+SIM_CLOCK simClock;
+LARGE_INTEGER perfFrequency;
+
+// the physics thread publishes finished bubble states through a triple buffer
+// and WM_PAINT only ever reads the newest one
+BUBBLE_SNAPSHOT bubbleSnapshots[3];
+TRIPLE_BUFFER bubbleSnapshotBuffer;
+
+// every physics step goes to recordPath when it's set
+REPLAY_RECORDER replayRecorder;
+
+// the monitors' pipelines scan their desktop grabs into it on the main thread (and
+// the present threads), WM_PAINT rebuilds it and hands a copy of what changed to
+// the physics thread, which bounces bubbles off it (BackgroundField.h)
+BACKGROUND_FIELD desktopField;
+BACKGROUND_FIELD desktopFieldSlots[3];
+TRIPLE_BUFFER desktopFieldBuffer;
+
+double GetSeconds(); // high resolution time for the physics and drawing clocks
+long long QpcToNanos(LONGLONG ticks);
+DWORD WINAPI PhysicsLoop(LPVOID lpParam);
+void ApplyPhysicsConfig(const CONFIG* config);
 //======================================================
 
 // Function prototypes (forward declarations)
 void GetMonitorRealResolution(HMONITOR hmon, int* pixelsWidth, int* pixelsHeight, MONITORINFOEX *info);
 HWND CreateFullscreenWindow(HMONITOR hmon, HINSTANCE *hInstance, MONITORINFOEX *info);
+bool OpenMonitorWindow(HMONITOR hmon, HINSTANCE *hInstance); // adds a window to monitorWindows and monitorLayout
+BOOL CALLBACK OpenMonitorWindowProc(HMONITOR hmon, HDC hdc, LPRECT rect, LPARAM data);
+void RenderMonitors(const BUBBLE_SNAPSHOT* snap, float alpha);
+void SuspendMonitors();
+void ResumeMonitors();
+void InvalidateCaptures();
+void ShowMonitorWindows(int show);
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-void Wineventproc(
+void InitFrameScheduler();
+void SyncFrameScheduler();
+void SetFrameTick(bool raised);
+void CALLBACK Wineventproc(
   HWINEVENTHOOK hWinEventHook,
   DWORD event,
   HWND hwnd,
@@ -60,14 +149,24 @@ LRESULT CALLBACK KeyboardProc(
   WPARAM wParam,
   LPARAM lParam
 );
+LRESULT CALLBACK MouseProc(int code, WPARAM wParam, LPARAM lParam);
 DWORD WINAPI CheckUserInteractionLoop(LPVOID lpParam);
+DWORD WINAPI ConfigWatchLoop(LPVOID lpParam);
+void ApplyFrameConfig(const CONFIG* config);
 
 // drawing routines
-void DrawBackground();
+HBITMAP CreateFramebufferBitmap(HDC hdc, int width, int height, FRAMEBUFFER* fb);
+RENDERER CreateGdiRenderer(HWND hwnd, int width, int height, RECT desktop);
+bool GrabDesktop(void* context, FRAMEBUFFER* dst); // GDI capture source, context is the GDI_RENDERER
 
-int main()
+int main(int argc, char** argv)
 {
-    srand(time(0));
+    // bubble count etc. from HPBubbleScreensaver.cfg and the command line
+    initConfigStore(&configStore, argc, argv);
+    const CONFIG* config = configSnapshot(&configStore);
+    unsigned int seed = config->seed != 0 ? config->seed : (unsigned int) time(0);
+    seedBubbleRandom(seed);
+    initFrameStats(&frameStats);
 
     HINSTANCE hInstance;
 
@@ -82,97 +181,112 @@ int main()
 
     RegisterClass(&wc);
 
-    HMONITOR hmon = MonitorFromWindow(GetForegroundWindow(),
-                        MONITOR_DEFAULTTONEAREST);
+    // one window per monitor on the virtual desktop, or just the one with the foreground window
+    initMonitorLayout(&monitorLayout);
+    if (config->spanMonitors)
+        EnumDisplayMonitors(NULL, NULL, OpenMonitorWindowProc, (LPARAM) &hInstance);
+    if (monitorLayout.count == 0)
+        OpenMonitorWindow(MonitorFromWindow(GetForegroundWindow(), MONITOR_DEFAULTTONEAREST), &hInstance);
 
-    MONITORINFOEX info = { sizeof(MONITORINFOEX) };
+    HWND hwnd = monitorWindows[0].hwnd;
+    printf("monitors: %d world: %d x %d\n", monitorLayout.count, monitorLayout.worldWidth, monitorLayout.worldHeight);
 
-    // get this monitor's width and height for drawing
-    GetMonitorRealResolution(hmon, &monitorWidth, &monitorHeight, &info);
-    printf("%d  %d\n", monitorWidth, monitorHeight);
+    // windows opening, closing, moving etc. mean the desktop picture is out of date
+    // https://learn.microsoft.com/en-us/windows/win32/winauto/event-constants
+    foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+        NULL, Wineventproc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    objectHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_LOCATIONCHANGE,
+        NULL, Wineventproc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
 
-    HWND hwnd = CreateFullscreenWindow(hmon, &hInstance, &info);
+    // begin with the windows minimized
+    ShowMonitorWindows(SW_MINIMIZE);
 
-    // record this window's width and height
-    // in my testing the windows width was sometimes different
-    // than the monitor resolution even when window was fullscreen 
-    // (presumably due to some windows scaling)
-    RECT rect;
-    GetClientRect(hwnd, &rect);
-    myWidth = rect.right - rect.left;
-    myHeight = rect.bottom - rect.top;
-    
-    printf("myWidth: %d myHeight: %d\n", myWidth, myHeight);
-
-    // set window to be clickable through
-    // https://stackoverflow.com/questions/13069717/letting-the-mouse-pass-through-windows-c
-    // https://learn.microsoft.com/en-us/windows/win32/winmsg/extended-window-styles?redirectedfrom=MSDN
-    // WS_EX_APPWINDOW - forces taskbar icon to be shown, but also allows this window to be foreground?
-    // WS_EX_NOACTIVATE - window cannot be foreground
-    // WS_EX_TRANSPARENT | WS_EX_LAYERED
-    // LONG cur_style = GetWindowLong(hwnd, GWL_EXSTYLE);
-    SetWindowLong(hwnd, GWL_EXSTYLE, WS_EX_TRANSPARENT | WS_EX_LAYERED);
-
-    // Transparency settings for window
-    SetLayeredWindowAttributes(hwnd, 
-        TRANSPARENT_COLOR, // color that will be rendered fully transparent
-        255,    // 0 - 255 controls overall trnasparency of window (alpha value)
-        LWA_COLORKEY | LWA_ALPHA
-    );
-
-    // set window to always on top
-    SetWindowPos(hwnd, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
-
-    // set window to not be included in screen capture
-    // WDA_EXCLUDEFROMCAPTURE requires at least win 10
-    SetWindowDisplayAffinity(hwnd, WDA_EXCLUDEFROMCAPTURE); 
+    // initialize bubbles
+    // scale radius based on screen size
+    BUBBLE_RADIUS = scaledBubbleRadius(monitorLayout.worldWidth, monitorLayout.worldHeight, config->bubbles);
+    printf("R: %d\n", BUBBLE_RADIUS);
+    worldWidth = monitorLayout.worldWidth;
+    worldHeight = monitorLayout.worldHeight;
+    if (!parseRadiusDistribution(config->radiusDistribution, &radiusDistribution))
+        printf("Unknown radius distribution %s\n", config->radiusDistribution);
+    minBubbleRadius = config->minRadius > 0 ? config->minRadius : BUBBLE_RADIUS / 10.0f;
+    maxBubbleRadius = config->maxRadius > 0 ? config->maxRadius : BUBBLE_RADIUS * 10.0f;
+    float largest = (worldWidth < worldHeight ? worldWidth : worldHeight) / 4.0f;
+    if (config->maxRadius <= 0 && maxBubbleRadius > largest)
+        maxBubbleRadius = largest;
+    if (minBubbleRadius < 1)
+        minBubbleRadius = 1;
+    if (radiusDistribution != RADIUS_FIXED)
+        printf("radii: %s %g - %g\n", radiusDistributionName(radiusDistribution), minBubbleRadius, maxBubbleRadius);
+    // every per-bubble buffer is sized for maxBubbles up front so the frame loop never reallocates
+    allocateBubbles(config->maxBubbles);
+    initializeBubbles(config->bubbles);
+    ApplyPhysicsConfig(config);
+    if (config->physicsThreads != 1)
+        parallelCollision = initParallelPhysics(config->physicsThreads);
+
+    if (config->recordPath[0] && !openReplayRecorder(&replayRecorder, config->recordPath, seed))
+        printf("Can't record to %s\n", config->recordPath);
+
+    initSimClock(&simClock, SIM_DT);
+    QueryPerformanceFrequency(&perfFrequency);
+    InitFrameScheduler();
+
+    bool fieldOk = initBackgroundField(&desktopField, worldWidth, worldHeight);
+    for (int i = 0; i < 3; i++)
+        fieldOk = initBackgroundField(&desktopFieldSlots[i], worldWidth, worldHeight) && fieldOk;
+    initTripleBuffer(&desktopFieldBuffer, &desktopFieldSlots[0], &desktopFieldSlots[1], &desktopFieldSlots[2]);
+    if (!fieldOk) {
+        // desktopField.cols == 0 keeps it off for good
+        freeBackgroundField(&desktopField);
+        printf("Not enough memory for the desktop field\n");
+    }
 
-    // Setup for drawing
-    // https://learn.microsoft.com/en-us/windows/win32/gdi/capturing-an-image
-	hMyDC = GetDC(hwnd);
-    hDesktopDC = GetDC(NULL);
+    for (int i = 0; i < monitorLayout.count; i++) {
+        MONITOR_WINDOW* m = &monitorWindows[i];
+        initFramePipeline(&m->pipeline, m->renderer, &m->capture, bubbleCapacity, colorrefToPixel(TRANSPARENT_COLOR), &frameStats);
+        // the bubbles are the window's colour key, a blended edge would be a dark ring instead of a hole
+        m->pipeline.hardEdges = true;
+        framePipelineSetOrigin(&m->pipeline, monitorLayout.viewports[i].left, monitorLayout.viewports[i].top);
+    }
+    if (monitorLayout.count > 1)
+        initWorkPool(&presentPool, monitorLayout.count);
 
-    // Create a compatible DC, which is used as a drawing buffer and then BitBlt to the window DC.
-    hdcMemDC = CreateCompatibleDC(hMyDC);
+    for (int i = 0; i < 3; i++)
+        initBubbleSnapshot(&bubbleSnapshots[i], bubbleCapacity);
+    initTripleBuffer(&bubbleSnapshotBuffer, &bubbleSnapshots[0], &bubbleSnapshots[1], &bubbleSnapshots[2]);
 
-    // "Before an application can use a memory DC for drawing operations, 
-    // it must select a bitmap of the correct width and height into the DC. 
-    // To select a bitmap into a DC, use the CreateCompatibleBitmap function, 
-    // specifying the height, width, and color organization required."
-    // https://learn.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createcompatibledc
-    hMyBmp = CreateCompatibleBitmap(hMyDC, myWidth, myHeight);
-    SelectObject(hdcMemDC, hMyBmp);
+    // publish the starting positions so the first paint has something to draw
+    takeBubbleSnapshot((BUBBLE_SNAPSHOT*) tripleBufferWriteSlot(&bubbleSnapshotBuffer), GetSeconds(), 0);
+    tripleBufferPublish(&bubbleSnapshotBuffer);
 
-    // This is the best stretch mode. (need for stretching screenshot into bubble window??)
-    SetStretchBltMode(hMyDC, HALFTONE);
-    SetStretchBltMode(hdcMemDC, HALFTONE);
+    // the windows start minimized, so does everything behind them until the idle thread warms them up
+    physicsRunning = CreateEvent(NULL, TRUE, FALSE, NULL);
+    SuspendMonitors();
 
-    // Select DC_PEN so you can change the color of the pen with
-    // COLORREF SetDCPenColor(HDC hdc, COLORREF color)
-    SelectObject(hdcMemDC, GetStockObject(DC_PEN));
+    // Start physics thread, from here on only it touches the bubbles array
+    physicsHandle = CreateThread(
+        NULL,           // default security attributes
+        0,              // use default stack size  
+        PhysicsLoop,    // function to run in new thread
+        hwnd,   // thread function parameters
+        0,      // thread runs immediately after creation
+        NULL    // pointer to variable to receive thread id
+    );
 
-    // Select DC_BRUSH so you can change the brush color from the 
-    // default WHITE_BRUSH to any other color
-    SelectObject(hdcMemDC, GetStockObject(DC_BRUSH));
-    
     // Start keypress/user interaction control thread for getting out of screensaver mode
+    // (last, so the saver can't be shown before there's anything to draw)
     idleCheckHandle = CreateThread(
         NULL,           // default security attributes
         0,              // use default stack size  
         CheckUserInteractionLoop,  // function to run in new thread
         hwnd,   // thread function parameters
         0,      // thread runs immediately after creation
-        NULL    // pointer to variable to receive thread id
+        &idleCheckThreadId // pointer to variable to receive thread id
     );
-    
-    // begin with the window minimized
-    ShowWindow(hwnd, SW_MINIMIZE);
 
-    // initialize bubbles
-    // scale radius based on screen size
-    BUBBLE_RADIUS = (int) myWidth * myHeight / (NUMBER_OF_BUBBLES * 1000);
-    printf("R: %d\n", BUBBLE_RADIUS);
-    initializeBubbles();
+    // reloads the config file whenever it changes, the other threads pick the new settings up
+    configWatchHandle = CreateThread(NULL, 0, ConfigWatchLoop, NULL, 0, NULL);
 
     // Run the message and update loop.
     // https://learn.microsoft.com/en-us/windows/win32/learnwin32/window-messages
@@ -218,6 +332,81 @@ HWND CreateFullscreenWindow(HMONITOR hmon, HINSTANCE *hInstance, MONITORINFOEX *
     );
 }
 
+bool OpenMonitorWindow(HMONITOR hmon, HINSTANCE *hInstance)
+{
+    if (monitorLayout.count == MAX_MONITORS)
+        return false;
+
+    MONITORINFOEX info = { sizeof(MONITORINFOEX) };
+
+    // get this monitor's width and height for drawing
+    int monitorWidth, monitorHeight;
+    GetMonitorRealResolution(hmon, &monitorWidth, &monitorHeight, &info);
+    printf("%d  %d\n", monitorWidth, monitorHeight);
+
+    HWND hwnd = CreateFullscreenWindow(hmon, hInstance, &info);
+
+    // record this window's width and height
+    // in my testing the windows width was sometimes different
+    // than the monitor resolution even when window was fullscreen 
+    // (presumably due to some windows scaling)
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    int myWidth = rect.right - rect.left;
+    int myHeight = rect.bottom - rect.top;
+    
+    printf("myWidth: %d myHeight: %d\n", myWidth, myHeight);
+
+    // the window's place in the world, sized by what it actually got
+    int left = (int) info.rcMonitor.left;
+    int top = (int) info.rcMonitor.top;
+    DIRTY_RECT desktop = { left, top, left + myWidth, top + myHeight };
+    int index = addLayoutMonitor(&monitorLayout, desktop);
+    if (index < 0) {
+        DestroyWindow(hwnd);
+        return false;
+    }
+
+    // set window to be clickable through
+    // https://stackoverflow.com/questions/13069717/letting-the-mouse-pass-through-windows-c
+    // https://learn.microsoft.com/en-us/windows/win32/winmsg/extended-window-styles?redirectedfrom=MSDN
+    // WS_EX_APPWINDOW - forces taskbar icon to be shown, but also allows this window to be foreground?
+    // WS_EX_NOACTIVATE - window cannot be foreground
+    // WS_EX_TRANSPARENT | WS_EX_LAYERED
+    // LONG cur_style = GetWindowLong(hwnd, GWL_EXSTYLE);
+    SetWindowLong(hwnd, GWL_EXSTYLE, WS_EX_TRANSPARENT | WS_EX_LAYERED);
+
+    // Transparency settings for window
+    SetLayeredWindowAttributes(hwnd, 
+        TRANSPARENT_COLOR, // color that will be rendered fully transparent
+        255,    // 0 - 255 controls overall trnasparency of window (alpha value)
+        LWA_COLORKEY | LWA_ALPHA
+    );
+
+    // set window to always on top
+    SetWindowPos(hwnd, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
+
+    // set window to not be included in screen capture
+    // WDA_EXCLUDEFROMCAPTURE requires at least win 10
+    SetWindowDisplayAffinity(hwnd, WDA_EXCLUDEFROMCAPTURE); 
+
+    // Setup for drawing
+    // the grab reads the monitor at its real resolution, from its corner of the desktop
+    RECT source = { info.rcMonitor.left, info.rcMonitor.top, info.rcMonitor.left + monitorWidth, info.rcMonitor.top + monitorHeight };
+    MONITOR_WINDOW* m = &monitorWindows[index];
+    m->hwnd = hwnd;
+    m->renderer = CreateGdiRenderer(hwnd, myWidth, myHeight, source);
+
+    CAPTURE_SOURCE desktopSource = { m->renderer.context, GrabDesktop, NULL };
+    initCaptureCache(&m->capture, desktopSource, configSnapshot(&configStore)->captureInterval);
+    return true;
+}
+
+BOOL CALLBACK OpenMonitorWindowProc(HMONITOR hmon, HDC hdc, LPRECT rect, LPARAM data)
+{
+    return OpenMonitorWindow(hmon, (HINSTANCE*) data);
+}
+
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     switch (uMsg)
@@ -225,28 +414,87 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     case WM_DESTROY:
         {
             printf("Goodbye!");
+            UnhookWinEvent(foregroundHook);
+            UnhookWinEvent(objectHook);
             CloseHandle(idleCheckHandle);
+            CloseHandle(physicsHandle);
+            CloseHandle(configWatchHandle);
+            SetFrameTick(false);
             PostQuitMessage(0);
         }
         return 0;
 
+    case WM_SIZE:
+        {
+            // coming back from minimized the window needs a complete redraw, the desktop
+            // was grabbed when the saver warmed up and window events since then invalidate it
+            if (wParam != SIZE_MINIMIZED) {
+                for (int i = 0; i < monitorLayout.count; i++) {
+                    if (monitorWindows[i].hwnd == hwnd)
+                        framePipelineInvalidate(&monitorWindows[i].pipeline);
+                }
+            }
+        }
+        break;
+
+    case WM_SAVER_WARM_UP:
+        ResumeMonitors();
+        return 0;
+
+    case WM_SAVER_COOL_DOWN:
+        SuspendMonitors();
+        return 0;
+
     case WM_PAINT:
         {
             PAINTSTRUCT ps;
             BeginPaint(hwnd, &ps); 
 
-            // draw to hdcMemDC buffer device context
-            DrawBackground();
-            DrawBubbles();
+            // the first monitor's window draws every monitor, the others' paints are just validated
+            if (hwnd != monitorWindows[0].hwnd) {
+                EndPaint(hwnd, &ps);
+                return 0;
+            }
+
+            // picks up a reloaded config between frames, one compare when nothing changed
+            const CONFIG* config = configSnapshot(&configStore);
+            static long long appliedGeneration = -1;
+            if (config->generation != appliedGeneration) {
+                ApplyFrameConfig(config);
+                appliedGeneration = config->generation;
+            }
+
+            // newest state the physics thread has finished
+            const BUBBLE_SNAPSHOT* snap = (const BUBBLE_SNAPSHOT*) tripleBufferRead(&bubbleSnapshotBuffer, NULL);
+
+            // draw between the snapshot's previous and current step
+            float alpha = (GetSeconds() - snap->time) / SIM_DT;
+            if (alpha > 1)
+                alpha = 1;
+            if (alpha < 0)
+                alpha = 0;
+
+            // draw to the frame buffers and bit block transfer only the changed parts onto window dcs
+            RenderMonitors(snap, alpha);
 
-            // Bit block transfer onto window dc
-            if(!BitBlt(hMyDC, 0, 0, myWidth, myHeight, hdcMemDC, 0, 0, SRCCOPY)) {
-                printf("Oh no");
+            // the physics thread gets the field whenever a grab changed what's solid
+            if (desktopField.cols && backgroundFieldRebuild(&desktopField)) {
+                copyBackgroundField((BACKGROUND_FIELD*) tripleBufferWriteSlot(&desktopFieldBuffer), &desktopField);
+                tripleBufferPublish(&desktopFieldBuffer);
             }
 
+            frameStatsEndFrame(&frameStats);
+            if (config->statsInterval > 0 && frameStatsLog(&frameStats, stdout, config->statsInterval))
+                printf("pacing: %.2f Hz dropped: %lld late wake max: %.3f ms\n",
+                    1e9 / frameScheduler.period, frameScheduler.dropped, frameScheduler.lateWakeMax / 1e6);
+
             EndPaint(hwnd, &ps); 
 
-            Sleep(33); // thread sleep in milliseconds (33msec is about 30fps)
+            // wait for the next frame's deadline rather than a fixed time, so drawing
+            // time doesn't slow the frame rate down (FrameScheduler.h)
+            if (frameScheduler.frames % FRAME_SYNC_INTERVAL == 0)
+                SyncFrameScheduler();
+            frameSchedulerWait(&frameScheduler);
 
             // mark window for redrawing if not minimized
             if (!IsIconic(hwnd))
@@ -258,181 +506,585 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
-// populates bubbles array
-void initializeBubbles()
+// 32 bit top-down DIB section whose pixels fb points at
+HBITMAP CreateFramebufferBitmap(HDC hdc, int width, int height, FRAMEBUFFER* fb)
 {
-    for (int i = 0; i < NUMBER_OF_BUBBLES; i++)
-    {
-        bubbles[i].x = rand() % myWidth;
-        bubbles[i].y = rand() % myHeight;
-        bubbles[i].r = BUBBLE_RADIUS;
-        bubbles[i].mass = 10;
-        bubbles[i].xVel = 0.5;
-        bubbles[i].yVel = 0;
-
-            // printf("X: %f, Y: %f, R: %f", bubbles[i].xVel, bubbles[i].y, bubbles[i].r);
-    }
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height; // negative for top-down rows
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = NULL;
+    HBITMAP bmp = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+
+    fb->pixels = (uint32_t*) bits;
+    fb->width = width;
+    fb->height = height;
+    fb->stride = width;
+    return bmp;
+}
+
+struct PRESENT_WORK {
+    const BUBBLE_SNAPSHOT* snap;
+    float alpha;
+};
+
+// on the present threads, one monitor per task
+static void PresentMonitorRange(void* context, int begin, int end, int worker)
+{
+    PRESENT_WORK* work = (PRESENT_WORK*) context;
+    for (int i = begin; i < end; i++)
+        renderFrame(&monitorWindows[i].pipeline, work->snap, work->alpha);
 }
 
-const float friction = 1; // no energy loss if == 1
-// checks if bubble hitting wall
-void wallCheck(BUBBLE* b) {
-    // bottom & top
-    if (b->y + b->r > myHeight) {
-        b->y = myHeight - b->r;
-        b->xVel *= friction;
-        b->yVel *= -1 * friction;        
-    } else if (b->y - b->r < 0) {
-        b->y = b->r;
-        b->xVel *= friction;
-        b->yVel *= -1 * friction;
+void RenderMonitors(const BUBBLE_SNAPSHOT* snap, float alpha)
+{
+    if (monitorLayout.count == 1) {
+        renderFrame(&monitorWindows[0].pipeline, snap, alpha);
+        return;
     }
 
-    // sides
-    if (b->x + b->r > myWidth) {
-        b->x = myWidth - b->r;
-        b->xVel *= -1 * friction;
-        b->yVel *= friction;
-    } else if (b->x - b->r < 0) {
-        b->x = b->r;
-        b->xVel *= -1 * friction;
-        b->yVel *= friction;
+    PRESENT_WORK work = { snap, alpha };
+    workPoolFor(&presentPool, monitorLayout.count, 1, PresentMonitorRange, &work);
+}
+
+// the saver is hidden: frees the big buffers and stops the physics
+void SuspendMonitors()
+{
+    ResetEvent(physicsRunning);
+    for (int i = 0; i < monitorLayout.count; i++)
+        framePipelineSuspend(&monitorWindows[i].pipeline);
+    SetFrameTick(false);
+}
+
+// the saver is about to show: gets the buffers and the desktop grab ready
+// now so the first paint only has to draw
+void ResumeMonitors()
+{
+    const BUBBLE_SNAPSHOT* snap = (const BUBBLE_SNAPSHOT*) tripleBufferRead(&bubbleSnapshotBuffer, NULL);
+    for (int i = 0; i < monitorLayout.count; i++) {
+        if (!framePipelineResume(&monitorWindows[i].pipeline, snap))
+            printf("Not enough memory to draw on monitor %d\n", i);
     }
+    SetEvent(physicsRunning);
+
+    // nothing was paced while minimized
+    SetFrameTick(true);
+    frameSchedulerRestart(&frameScheduler);
 }
 
-const float ballFriction = 1;
-const float ballEnergyTransfer = 0.2;
-// checks if bubble collided with other bubble
-void collisionCheck(BUBBLE* b) {
-    for (int i = 0; i < NUMBER_OF_BUBBLES; i++)
-    {
-        // skip self
-        if (b == &bubbles[i])
-            continue;
+void InvalidateCaptures()
+{
+    for (int i = 0; i < monitorLayout.count; i++)
+        captureInvalidate(&monitorWindows[i].capture);
+}
 
-        float velLength = sqrt(pow(b->xVel, 2) + pow(b->yVel, 2));
-
-        // first check if close enough to hit
-        if ( sqrt(pow((b->x - bubbles[i].x), 2) + pow((b->y - bubbles[i].y), 2)) < (b->r + bubbles[i].r + velLength) ) {
-            // find line between balls' centers 
-            // this will be the line we reflect the angle of bounce around
-            float normX = b->x - bubbles[i].x;
-            float normY = b->y - bubbles[i].y;
-            float normMagnitude = sqrt(pow(normX, 2) + pow(normY,2));
-            
-            // make normal vector length 1 (normalize vector)
-            normX /= normMagnitude;
-            normY /= normMagnitude;
-
-            // reflect velocity vector over normal vector to find new velcoity after bounce
-            float dotProduct = b->xVel * normX + b->yVel * normY;
-            // var ang = Math.acos(dotProduct / velLength);
-
-            // https://math.stackexchange.com/questions/13261/how-to-get-a-reflection-vector
-            // derive by setting angle of current velcoity with normal equal to
-            // angle of new velocity (reflection) with normal and
-            // solve the dot product equation
-            float newXVel = b->xVel - 2 * dotProduct * normX;
-            float newYVel = b->yVel - 2 * dotProduct * normY;
-
-            // move balls to just touching and update velocity
-            b->x += normX * velLength; 
-            b->y += normY * velLength; 
-            
-            b->xVel = newXVel * ballFriction;
-            b->yVel = newYVel * ballFriction;
-
-            // transfer some energy to other ball
-            bubbles[i].xVel -= newXVel * ballFriction * ballEnergyTransfer / bubbles[i].mass;
-            bubbles[i].yVel -= newYVel * ballFriction * ballEnergyTransfer / bubbles[i].mass;
+void ShowMonitorWindows(int show)
+{
+    for (int i = 0; i < monitorLayout.count; i++)
+        ShowWindow(monitorWindows[i].hwnd, show);
+}
+
+static void GdiBeginFrame(void* context)
+{
+    // GDI has to be done with the DIB sections before touching their pixels
+    GdiFlush();
+}
+
+static void GdiPresent(void* context, const FRAMEBUFFER* frame, const DIRTY_RECTS* dirty)
+{
+    GDI_RENDERER* gdi = (GDI_RENDERER*) context;
+
+    for (int i = 0; i < dirty->count; i++) {
+        DIRTY_RECT r = dirty->rects[i];
+        if(!BitBlt(gdi->windowDC, r.left, r.top, r.right - r.left, r.bottom - r.top, gdi->frameDC, r.left, r.top, SRCCOPY)) {
+            printf("Oh no");
         }
     }
 }
 
-// run in loop to update each bubble individually in bubbles array
-void bubbleUpdate(BUBBLE* b) {
-    b->x += b->xVel;
-    b->y += b->yVel;
+// the window DC stays, everything else goes while the saver is suspended
+static void GdiRelease(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background)
+{
+    GDI_RENDERER* gdi = (GDI_RENDERER*) context;
+    if (gdi->frameDC) {
+        DeleteDC(gdi->frameDC);
+        DeleteDC(gdi->backgroundDC);
+        DeleteObject(gdi->frameBmp);
+        DeleteObject(gdi->backgroundBmp);
+        ReleaseDC(NULL, gdi->desktopDC);
+    }
+    gdi->frameDC = gdi->backgroundDC = gdi->desktopDC = NULL;
+    gdi->frameBmp = gdi->backgroundBmp = NULL;
+    frame->pixels = NULL;
+    background->pixels = NULL;
+}
 
-    wallCheck(b);
-    collisionCheck(b);
+static bool GdiAcquire(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background)
+{
+    GDI_RENDERER* gdi = (GDI_RENDERER*) context;
+
+    // https://learn.microsoft.com/en-us/windows/win32/gdi/capturing-an-image
+    gdi->desktopDC = GetDC(NULL);
+
+    // Create a compatible DC, which is used as a drawing buffer and then BitBlt to the window DC.
+    gdi->frameDC = CreateCompatibleDC(gdi->windowDC);
+
+    // "Before an application can use a memory DC for drawing operations, 
+    // it must select a bitmap of the correct width and height into the DC. 
+    // To select a bitmap into a DC, use the CreateCompatibleBitmap function, 
+    // specifying the height, width, and color organization required."
+    // https://learn.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createcompatibledc
+    // (a DIB section instead of CreateCompatibleBitmap so the bubbles can be rasterized straight into it)
+    gdi->frameBmp = CreateFramebufferBitmap(gdi->windowDC, gdi->width, gdi->height, frame);
+    SelectObject(gdi->frameDC, gdi->frameBmp);
+
+    // the captured desktop is kept separately so dirty rects can be restored from it
+    gdi->backgroundDC = CreateCompatibleDC(gdi->windowDC);
+    gdi->backgroundBmp = CreateFramebufferBitmap(gdi->windowDC, gdi->width, gdi->height, background);
+    SelectObject(gdi->backgroundDC, gdi->backgroundBmp);
+
+    if (!frame->pixels || !background->pixels) {
+        GdiRelease(gdi, frame, background);
+        return false;
+    }
+
+    // This is the best stretch mode. (need for stretching screenshot into bubble window??)
+    SetStretchBltMode(gdi->backgroundDC, HALFTONE);
+    return true;
 }
 
-// draws background (either slid color or intersting stuff into hdcMemDC)
-// call before drawing bubbles
-void DrawBackground()
+static void GdiDestroy(void* context)
 {
-    // fill background
-    // SetBkColor(hdcMemDC, BACKGROUND_COLOR);
-    SetDCPenColor(hdcMemDC, BACKGROUND_COLOR);
-    SetDCBrushColor(hdcMemDC, RGB(25, 25, 25));
-    Rectangle(hdcMemDC, 0, 0, myWidth, myHeight);
+    GDI_RENDERER* gdi = (GDI_RENDERER*) context;
+    FRAMEBUFFER frame, background;
+    GdiRelease(gdi, &frame, &background);
+    free(gdi);
+}
 
-    // The source DC is the whole screen, and the destination DC is buffer dc (hdcMemDC).
-    if (!StretchBlt(hdcMemDC,
-        0, 0,
-        myWidth, myHeight,
-        hDesktopDC,
+RENDERER CreateGdiRenderer(HWND hwnd, int width, int height, RECT desktop)
+{
+    RENDERER renderer = {};
+    GDI_RENDERER* gdi = (GDI_RENDERER*) calloc(1, sizeof(GDI_RENDERER));
+
+    gdi->windowDC = GetDC(hwnd);
+    SetStretchBltMode(gdi->windowDC, HALFTONE);
+    gdi->desktop = desktop;
+    gdi->width = width;
+    gdi->height = height;
+    GdiAcquire(gdi, &renderer.frame, &renderer.background);
+
+    renderer.context = gdi;
+    renderer.beginFrame = GdiBeginFrame;
+    renderer.present = GdiPresent;
+    renderer.release = GdiRelease;
+    renderer.acquire = GdiAcquire;
+    renderer.destroy = GdiDestroy;
+    return renderer;
+}
+
+// grabs the desktop into the renderer's background DC (which is where dst's pixels live)
+bool GrabDesktop(void* context, FRAMEBUFFER* dst)
+{
+    GDI_RENDERER* gdi = (GDI_RENDERER*) context;
+
+    // The source DC is the whole screen, and the destination DC is the background buffer dc.
+    // a straight copy, the pipeline scans it into the desktop field before it ANDs the
+    // background colour in (see FRAME_PIPELINE::backgroundMask)
+    if (!StretchBlt(gdi->backgroundDC,
         0, 0,
-        monitorWidth, monitorHeight,
-        MERGECOPY))
+        dst->width, dst->height,
+        gdi->desktopDC,
+        gdi->desktop.left, gdi->desktop.top,
+        gdi->desktop.right - gdi->desktop.left, gdi->desktop.bottom - gdi->desktop.top,
+        SRCCOPY))
     {
         printf("StretchBlt failed.\n");
+        return false;
+    }
+
+    GdiFlush();
+    return true;
+}
+
+// called on the main thread's message loop for the hooks set up in main
+void CALLBACK Wineventproc(
+  HWINEVENTHOOK hWinEventHook,
+  DWORD event,
+  HWND hwnd,
+  LONG idObject,
+  LONG idChild,
+  DWORD idEventThread,
+  DWORD dwmsEventTime
+)
+{
+    // the mouse moving doesn't change what's captured (the cursor isn't in the grab)
+    if (idObject == OBJID_CURSOR)
+        return;
+
+    InvalidateCaptures();
+}
+
+double GetSeconds()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double) now.QuadPart / perfFrequency.QuadPart;
+}
+
+long long QpcToNanos(LONGLONG ticks)
+{
+    // split so ticks * 10^9 can't overflow
+    LONGLONG f = perfFrequency.QuadPart;
+    return ticks / f * 1000000000LL + ticks % f * 1000000000LL / f;
+}
+
+static long long FrameNow(void* context)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return QpcToNanos(now.QuadPart);
+}
+
+static void FrameWaitUntil(void* context, long long time)
+{
+    // timers only go off to within a millisecond or so, so sleep until just
+    // before the deadline and spin the rest
+    long long remaining = time - FrameNow(NULL);
+    if (remaining > frameSpinNanos) {
+        LARGE_INTEGER due;
+        due.QuadPart = -(remaining - frameSpinNanos) / 100; // negative is relative, in 100 ns units
+        SetWaitableTimer(frameTimer, &due, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(frameTimer, INFINITE);
+    }
+    while (FrameNow(NULL) < time)
+        Sleep(0);
+}
+
+// frameRate, or the primary display's refresh rate until the first sync finds the real one
+static long long FramePeriod(double rate)
+{
+    if (rate <= 0) {
+        DEVMODE devmode = {};
+        devmode.dmSize = sizeof(DEVMODE);
+        // 0 and 1 mean the hardware default
+        if (EnumDisplaySettings(NULL, ENUM_CURRENT_SETTINGS, &devmode) && devmode.dmDisplayFrequency > 1)
+            rate = devmode.dmDisplayFrequency;
+        else
+            rate = 60;
+    }
+    return framePeriodForRate(rate);
+}
+
+void InitFrameScheduler()
+{
+    frameTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    frameSpinNanos = 500000;
+    if (!frameTimer) {
+        // before windows 10 1803, the ordinary timer needs the 1 ms system tick (SetFrameTick)
+        frameTimer = CreateWaitableTimer(NULL, TRUE, NULL);
+        coarseFrameTimer = true;
+        frameSpinNanos = 2000000;
+    }
+
+    FRAME_CLOCK clock = { NULL, FrameNow, FrameWaitUntil };
+    frameRateSetting = configSnapshot(&configStore)->frameRate;
+    initFrameScheduler(&frameScheduler, clock, FramePeriod(frameRateSetting));
+    SyncFrameScheduler();
+    printf("frame rate: %.2f Hz\n", 1e9 / frameScheduler.period);
+}
+
+// the 1 ms tick costs power system wide, so the fallback timer only holds it while
+// the saver is showing. every timeBeginPeriod gets its timeEndPeriod
+void SetFrameTick(bool raised)
+{
+    if (!coarseFrameTimer || raised == frameTickRaised)
+        return;
+    if (raised)
+        timeBeginPeriod(1);
+    else
+        timeEndPeriod(1);
+    frameTickRaised = raised;
+}
+
+// lines the deadlines up with the compositor's last vblank and real refresh period
+// a fixed frameRate is rounded to a whole number of refreshes
+void SyncFrameScheduler()
+{
+    DWM_TIMING_INFO info = {};
+    info.cbSize = sizeof(DWM_TIMING_INFO);
+    if (FAILED(DwmGetCompositionTimingInfo(NULL, &info)) || info.qpcRefreshPeriod == 0)
         return;
+
+    long long refresh = QpcToNanos((LONGLONG) info.qpcRefreshPeriod);
+    long long vblanks = 1;
+    double rate = configSnapshot(&configStore)->frameRate;
+    if (rate > 0) {
+        vblanks = (framePeriodForRate(rate) + refresh / 2) / refresh;
+        if (vblanks < 1)
+            vblanks = 1;
     }
+    frameSchedulerSync(&frameScheduler, QpcToNanos((LONGLONG) info.qpcVBlank), vblanks * refresh);
 }
 
-void DrawBubbles()
+// frame rate, capture and stats intervals and the desktop field of a reloaded config,
+// on the main thread between frames
+void ApplyFrameConfig(const CONFIG* config)
 {
-    // draw to buffer DC and when done bit blt to window
+    // the period has been synced to the display since, only a new setting restarts the pacing
+    if (config->frameRate != frameRateSetting) {
+        frameRateSetting = config->frameRate;
+        frameScheduler.period = FramePeriod(frameRateSetting);
+        frameSchedulerRestart(&frameScheduler);
+        SyncFrameScheduler();
+        printf("frame rate: %.2f Hz\n", 1e9 / frameScheduler.period);
+    }
 
-    // SetTextColor(hdcMemDC, TRANSPARENT_COLOR);
-    // SetDCPenColor(hdcMemDC, RGB(255, 0, 0));
-    SetDCPenColor(hdcMemDC, TRANSPARENT_COLOR);
-    SetDCBrushColor(hdcMemDC, TRANSPARENT_COLOR);
+    FIELD_MODE mode = FIELD_OFF;
+    if (!parseFieldMode(config->desktopField, &mode))
+        printf("Unknown desktop field %s\n", config->desktopField);
+    if (desktopField.cols)
+        setBackgroundFieldMode(&desktopField, mode, config->edgeThreshold, config->brightThreshold);
+    // grabs are only scanned while the field is on
+    BACKGROUND_FIELD* field = desktopField.cols && mode != FIELD_OFF ? &desktopField : NULL;
+
+    for (int i = 0; i < monitorLayout.count; i++) {
+        MONITOR_WINDOW* m = &monitorWindows[i];
+        m->capture.interval = config->captureInterval;
+        // the grab already has the old colour ANDed in, it has to be grabbed again
+        if (m->pipeline.backgroundMask != config->backgroundColor) {
+            m->pipeline.backgroundMask = config->backgroundColor;
+            captureInvalidate(&m->capture);
+        }
+        // a field that was just switched on has seen no grab yet (or only old ones)
+        if (m->pipeline.field != field) {
+            m->pipeline.field = field;
+            if (field)
+                captureInvalidate(&m->capture);
+        }
+    }
+}
 
-    for (int i = 0; i < NUMBER_OF_BUBBLES; i++) {
-        bubbleUpdate(&bubbles[i]);
-        Ellipse(
-            hdcMemDC,
-            bubbles[i].x - bubbles[i].r, // top left bounding corner x
-            bubbles[i].y - bubbles[i].r, // top left bounding corner y
-            bubbles[i].x + bubbles[i].r, // bottom right bounding corner x
-            bubbles[i].y + bubbles[i].r // bottom right bounding corner y
-        );
+// sets the simulation's tuning from config, on the physics thread between steps (or before it starts)
+// the bubble count can only change within the pool that was allocated for maxBubbles at startup
+void ApplyPhysicsConfig(const CONFIG* config)
+{
+    // a recording stores the settings once in its header, so they can't change under it
+    if (replayRecorder.file) {
+        printf("Recording, physics settings stay as they were\n");
+        return;
+    }
 
-        // if (i == 0)
-        //     printf("X: %f, Y: %f, R: %f \n", bubbles[i].x, bubbles[i].y, bubbles[i].r);
+    continuousCollision = config->continuousCollision;
+    impulseResponse = config->impulseResponse;
+    restitution = config->restitution;
+    gravity = config->gravity;
+    friction = config->friction;
+    ballFriction = config->ballFriction;
+    ballEnergyTransfer = config->ballEnergyTransfer;
+    damping = config->damping;
+    // nothing would ever wake the bubbles that are asleep
+    if (sleepEnabled && !config->sleep) {
+        for (int i = 0; i < numBubbles; i++)
+            wakeBubble(&bubbles[i]);
     }
+    sleepEnabled = config->sleep;
+    setBubbleCount(config->bubbles);
 }
 
-// used for checking if user presses bound key to exit program
-// or other specified function
+// runs the bubble simulation on its own thread at a fixed timestep
+// and publishes a snapshot after every batch of steps
+DWORD WINAPI PhysicsLoop(LPVOID lpParam)
+{
+    double lastTime = GetSeconds();
+    long long appliedGeneration = configSnapshot(&configStore)->generation;
+
+    while (true)
+    {
+        // the simulation pauses while the saver is suspended, without waking up until it resumes
+        if (WaitForSingleObject(physicsRunning, 0) == WAIT_TIMEOUT) {
+            WaitForSingleObject(physicsRunning, INFINITE);
+            lastTime = GetSeconds();
+            continue;
+        }
+
+        const CONFIG* config = configSnapshot(&configStore);
+        if (config->generation != appliedGeneration) {
+            ApplyPhysicsConfig(config);
+            appliedGeneration = config->generation;
+        }
+
+        // newest desktop field, bubbles only bounce off it when it's on (and not recording, a replay
+        // couldn't reproduce it)
+        const BACKGROUND_FIELD* field = (const BACKGROUND_FIELD*) tripleBufferRead(&desktopFieldBuffer, NULL);
+        backgroundField = field->cols && field->mode != FIELD_OFF && !replayRecorder.file ? field : NULL;
+
+        double now = GetSeconds();
+        int steps = simClockAdvance(&simClock, now - lastTime);
+        lastTime = now;
+
+        long long start = nowNanos();
+        for (int i = 0; i < steps; i++) {
+            stepBubbles();
+            if (replayRecorder.file)
+                replayRecordFrame(&replayRecorder, simClock.steps - steps + i + 1);
+        }
+        if (steps > 0)
+            frameStatsRecord(&frameStats, STAGE_PHYSICS, nowNanos() - start);
+
+        if (steps > 0) {
+            BUBBLE_SNAPSHOT* snap = (BUBBLE_SNAPSHOT*) tripleBufferWriteSlot(&bubbleSnapshotBuffer);
+            takeBubbleSnapshot(snap, now - simClock.accumulator, simClock.steps);
+            tripleBufferPublish(&bubbleSnapshotBuffer);
+        }
+
+        // sleep until the next step is due
+        Sleep((DWORD) ((simClock.dt - simClock.accumulator) * 1000));
+    }
+}
+
+static long long IdleNow(void* context)
+{
+    return (long long) GetTickCount64();
+}
+
+static long long IdleLastInput(void* context)
+{
+    // check last input time
+    // https://learn.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getlastinputinfo
+    LASTINPUTINFO plii;
+    plii.cbSize = sizeof(LASTINPUTINFO);
+    GetLastInputInfo(&plii);
+
+    // dwTime is a 32 bit tick count, the difference is still right after it wraps
+    return (long long) GetTickCount64() - (DWORD) (GetTickCount() - plii.dwTime);
+}
+
+// low level hooks, called on the idle thread while it pumps messages
+LRESULT CALLBACK KeyboardProc(
+  int    code,
+  WPARAM wParam,
+  LPARAM lParam
+)
+{
+    inputSeen = true;
+    return CallNextHookEx(keyboardHook, code, wParam, lParam);
+}
+
+LRESULT CALLBACK MouseProc(int code, WPARAM wParam, LPARAM lParam)
+{
+    inputSeen = true;
+    return CallNextHookEx(mouseHook, code, wParam, lParam);
+}
+
+static void ApplyIdleAction(IDLE_ACTION action)
+{
+    HWND hwnd = monitorWindows[0].hwnd;
+    if (action == IDLE_WARM_UP_SAVER) {
+        PostMessage(hwnd, WM_SAVER_WARM_UP, 0, 0);
+    } else if (action == IDLE_COOL_DOWN_SAVER) {
+        PostMessage(hwnd, WM_SAVER_COOL_DOWN, 0, 0);
+    } else if (action == IDLE_SHOW_SAVER) {
+        // already warm unless the timer was late, resuming twice does nothing
+        PostMessage(hwnd, WM_SAVER_WARM_UP, 0, 0);
+        ShowMonitorWindows(SW_MAXIMIZE);
+        keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(NULL), 0);
+        mouseHook = SetWindowsHookEx(WH_MOUSE_LL, MouseProc, GetModuleHandle(NULL), 0);
+    } else if (action == IDLE_HIDE_SAVER) {
+        UnhookWindowsHookEx(keyboardHook);
+        UnhookWindowsHookEx(mouseHook);
+        keyboardHook = mouseHook = NULL;
+        ShowMonitorWindows(SW_MINIMIZE);
+        PostMessage(hwnd, WM_SAVER_COOL_DOWN, 0, 0);
+    }
+}
+
+// shows the saver once the user has been idle for idleAfter and hides it on input
+// sleeps until the next time the user could possibly be idle while they're active
+// and until the input hooks fire while the saver is shown, no polling
 // only call this function once
 DWORD WINAPI CheckUserInteractionLoop(LPVOID lpParam)
 {
-    HWND hwnd = (HWND) lpParam;
+    IDLE_SOURCE source = { NULL, IdleNow, IdleLastInput };
+    const CONFIG* startConfig = configSnapshot(&configStore);
+    long long appliedGeneration = startConfig->generation;
+    initIdleDetector(&idleDetector, source, startConfig->idleAfter, startConfig->warmUp);
+
+    long long wait;
+    IDLE_ACTION action = idleTimer(&idleDetector, &wait);
 
     while(true)
     {
-        Sleep(100); // thread sleep in milliseconds
+        ApplyIdleAction(action);
 
-        // check last input time
-        // https://learn.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getlastinputinfo
-        LASTINPUTINFO plii;
-        plii.cbSize = sizeof(LASTINPUTINFO);
+        DWORD timeout = wait == IDLE_WAIT_FOR_INPUT ? INFINITE : (DWORD) wait;
+        if (MsgWaitForMultipleObjects(0, NULL, FALSE, timeout, QS_ALLINPUT) == WAIT_TIMEOUT) {
+            action = idleTimer(&idleDetector, &wait);
+            continue;
+        }
 
-        GetLastInputInfo(&plii);
+        // the hooks get called from in here
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
 
-        // printf("%d\n", GetTickCount() - plii.dwTime);
+        // the config watcher posts a message when the file changed, the timer below uses the new timeouts
+        const CONFIG* config = configSnapshot(&configStore);
+        if (config->generation != appliedGeneration) {
+            setIdleTimes(&idleDetector, config->idleAfter, config->warmUp);
+            appliedGeneration = config->generation;
+        }
 
-        // tick count in milliseconds
-        // disable bubbles if window is not minimized and user action recently
-        if (!IsIconic(hwnd) && GetTickCount() - plii.dwTime < 250)
-        {
-            ShowWindow(hwnd, SW_MINIMIZE);
-        } else if (IsIconic(hwnd) && GetTickCount() - plii.dwTime > TIME_TILL_IDLE) {
-            ShowWindow(hwnd, SW_MAXIMIZE);
+        // woken by something else, the deadline is recomputed from the last input time
+        if (inputSeen) {
+            inputSeen = false;
+            action = idleInput(&idleDetector, &wait);
+        } else {
+            action = idleTimer(&idleDetector, &wait);
+        }
+    }
+}
+
+// waits for anything in the config file's directory to change and reloads it
+// (configReload ignores it when the file itself is the same). the frame loop
+// and physics thread notice the new snapshot on their own, the idle thread
+// sleeps for seconds at a time so it gets a message
+DWORD WINAPI ConfigWatchLoop(LPVOID lpParam)
+{
+    char dir[260];
+    snprintf(dir, sizeof(dir), "%s", configStore.path);
+    char* slash = strrchr(dir, '\\');
+    if (!slash)
+        slash = strrchr(dir, '/');
+    if (slash)
+        *slash = 0;
+    else
+        snprintf(dir, sizeof(dir), ".");
+
+    // editors often save by writing a new file and renaming it over the old one
+    HANDLE change = FindFirstChangeNotificationA(dir,
+        FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+    if (change == INVALID_HANDLE_VALUE) {
+        printf("Can't watch %s for changes, the config is only read at startup\n", dir);
+        return 0;
+    }
+
+    while (WaitForSingleObject(change, INFINITE) == WAIT_OBJECT_0) {
+        // let the editor finish writing
+        Sleep(50);
+        if (configReload(&configStore)) {
+            printf("Reloaded %s\n", configStore.path);
+            PostThreadMessage(idleCheckThreadId, WM_NULL, 0, 0);
         }
+        if (!FindNextChangeNotification(change))
+            break;
     }
-}
\ No newline at end of file
+
+    FindCloseChangeNotification(change);
+    return 0;
+}
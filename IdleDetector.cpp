@@ -0,0 +1,73 @@
+#include "IdleDetector.h"
+
+#include <string.h>
+
+void initIdleDetector(IDLE_DETECTOR* d, IDLE_SOURCE source, long long idleAfter, long long warmUp)
+{
+    memset(d, 0, sizeof(IDLE_DETECTOR));
+    d->source = source;
+    setIdleTimes(d, idleAfter, warmUp);
+    d->state = IDLE_USER_ACTIVE;
+}
+
+void setIdleTimes(IDLE_DETECTOR* d, long long idleAfter, long long warmUp)
+{
+    d->idleAfter = idleAfter;
+    d->warmUp = warmUp < 0 ? 0 : warmUp > idleAfter ? idleAfter : warmUp;
+}
+
+IDLE_ACTION idleTimer(IDLE_DETECTOR* d, long long* wait)
+{
+    d->wakeups++;
+
+    if (d->state == IDLE_SAVER_SHOWN) {
+        // spurious, only input ends this state
+        *wait = IDLE_WAIT_FOR_INPUT;
+        return IDLE_NONE;
+    }
+
+    long long idle = d->source.now(d->source.context) - d->source.lastInput(d->source.context);
+    long long warmAfter = d->idleAfter - d->warmUp;
+    if (idle >= d->idleAfter) {
+        // straight from user active too when there's no warm up (or the timer was very late)
+        d->state = IDLE_SAVER_SHOWN;
+        d->shows++;
+        *wait = IDLE_WAIT_FOR_INPUT;
+        return IDLE_SHOW_SAVER;
+    }
+
+    if (idle >= warmAfter) {
+        *wait = d->idleAfter - idle;
+        if (d->state == IDLE_WARMING_UP)
+            return IDLE_NONE;
+        d->state = IDLE_WARMING_UP;
+        d->warmUps++;
+        return IDLE_WARM_UP_SAVER;
+    }
+
+    // the user did something since the deadline was set, so it moves
+    *wait = warmAfter - idle;
+    if (d->state == IDLE_WARMING_UP) {
+        d->state = IDLE_USER_ACTIVE;
+        d->coolDowns++;
+        return IDLE_COOL_DOWN_SAVER;
+    }
+    return IDLE_NONE;
+}
+
+IDLE_ACTION idleInput(IDLE_DETECTOR* d, long long* wait)
+{
+    d->wakeups++;
+    *wait = d->idleAfter - d->warmUp;
+
+    IDLE_STATE state = d->state;
+    d->state = IDLE_USER_ACTIVE;
+    if (state == IDLE_USER_ACTIVE)
+        return IDLE_NONE;
+    if (state == IDLE_WARMING_UP) {
+        d->coolDowns++;
+        return IDLE_COOL_DOWN_SAVER;
+    }
+    d->hides++;
+    return IDLE_HIDE_SAVER;
+}
@@ -0,0 +1,62 @@
+#ifndef IDLE_DETECTOR_H
+#define IDLE_DETECTOR_H
+
+// decides when the screensaver shows and hides, without polling
+//
+// three states:
+//   user active  - the saver is hidden (and suspended). nothing can make the
+//                  user idle before idleAfter - warmUp has passed since their
+//                  last input, so the detector asks to be woken exactly then,
+//                  checks the last input time and either starts warming up or
+//                  sleeps until the new deadline
+//   warming up   - the saver is still hidden but gets warmUp ms to get its
+//                  buffers and first background ready, so it can appear
+//                  straight away when idleAfter is reached. input in the
+//                  meantime cancels it (found on the next timer, like above)
+//   saver shown  - the detector only waits for an input event (the caller
+//                  delivers those, e.g. from input hooks installed only while
+//                  the saver is up) and hides the saver on the first one
+// so a user at the keyboard costs one wakeup per idleAfter - warmUp and a shown
+// saver costs none. the clock and last input time come from an IDLE_SOURCE so
+// the whole thing runs against a simulated timeline too
+
+enum IDLE_STATE { IDLE_USER_ACTIVE, IDLE_WARMING_UP, IDLE_SAVER_SHOWN };
+// warm up resumes the hidden saver, cool down suspends it again (input came
+// while it was warming up, or it was hidden)
+enum IDLE_ACTION { IDLE_NONE, IDLE_WARM_UP_SAVER, IDLE_COOL_DOWN_SAVER, IDLE_SHOW_SAVER, IDLE_HIDE_SAVER };
+
+const long long IDLE_WAIT_FOR_INPUT = -1; // no timer needed, only an input event
+
+struct IDLE_SOURCE {
+    void* context;
+    long long (*now)(void* context);       // milliseconds, any fixed starting point
+    long long (*lastInput)(void* context); // when the user last did anything, same clock
+};
+
+struct IDLE_DETECTOR {
+    IDLE_SOURCE source;
+    long long idleAfter; // ms without input before the saver shows
+    long long warmUp;    // ms before that to start getting it ready, 0 to not
+    IDLE_STATE state;
+    long long wakeups;   // idleTimer and idleInput calls so far
+    long long warmUps;
+    long long coolDowns; // warm ups that input cancelled
+    long long shows;
+    long long hides;
+};
+
+void initIdleDetector(IDLE_DETECTOR* d, IDLE_SOURCE source, long long idleAfter, long long warmUp);
+
+// changes the timeouts in any state, they count from the last input like before
+// call idleTimer afterwards, the wait it last asked for may be wrong now
+void setIdleTimes(IDLE_DETECTOR* d, long long idleAfter, long long warmUp);
+
+// call when the wait the detector last asked for runs out (and once to start)
+// *wait is how long to sleep before calling it again, or IDLE_WAIT_FOR_INPUT
+IDLE_ACTION idleTimer(IDLE_DETECTOR* d, long long* wait);
+
+// call on an input event, only needed while the saver is shown
+// hiding the saver also means cooling it down
+IDLE_ACTION idleInput(IDLE_DETECTOR* d, long long* wait);
+
+#endif
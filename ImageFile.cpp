@@ -0,0 +1,208 @@
+#include "ImageFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// next number in a PPM header, skipping whitespace and # comments
+static int readHeaderInt(FILE* f)
+{
+    int c = fgetc(f);
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n')
+                c = fgetc(f);
+        }
+        c = fgetc(f);
+    }
+
+    int value = -1;
+    while (c != EOF && isdigit(c)) {
+        value = (value < 0 ? 0 : value * 10) + (c - '0');
+        c = fgetc(f);
+    }
+    // c is the single whitespace byte that ends the field
+    return value;
+}
+
+bool loadPPM(const char* path, FRAMEBUFFER* fb)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    bool ok = false;
+    if (fgetc(f) == 'P' && fgetc(f) == '6') {
+        int width = readHeaderInt(f);
+        int height = readHeaderInt(f);
+        int maxValue = readHeaderInt(f);
+
+        if (width > 0 && height > 0 && maxValue == 255) {
+            fb->pixels = (uint32_t*) malloc(sizeof(uint32_t) * width * height);
+            unsigned char* row = (unsigned char*) malloc(width * 3);
+
+            ok = fb->pixels && row;
+            for (int y = 0; ok && y < height; y++) {
+                if (fread(row, 3, width, f) != (size_t) width) {
+                    ok = false;
+                    break;
+                }
+                for (int x = 0; x < width; x++)
+                    fb->pixels[y * width + x] = (row[x * 3] << 16) | (row[x * 3 + 1] << 8) | row[x * 3 + 2];
+            }
+
+            free(row);
+            if (ok) {
+                fb->width = width;
+                fb->height = height;
+                fb->stride = width;
+            } else {
+                free(fb->pixels);
+                fb->pixels = NULL;
+            }
+        }
+    }
+
+    fclose(f);
+    return ok;
+}
+
+bool savePPM(const char* path, const FRAMEBUFFER* fb)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", fb->width, fb->height);
+    unsigned char* row = (unsigned char*) malloc(fb->width * 3);
+    bool ok = row != NULL;
+    for (int y = 0; ok && y < fb->height; y++) {
+        const uint32_t* src = fb->pixels + (size_t) y * fb->stride;
+        for (int x = 0; x < fb->width; x++) {
+            row[x * 3] = (unsigned char) (src[x] >> 16);
+            row[x * 3 + 1] = (unsigned char) (src[x] >> 8);
+            row[x * 3 + 2] = (unsigned char) src[x];
+        }
+        ok = fwrite(row, 3, fb->width, f) == (size_t) fb->width;
+    }
+
+    free(row);
+    return fclose(f) == 0 && ok;
+}
+
+//=======================PNG=====================
+
+static uint32_t crcTable[256];
+
+static uint32_t updateCrc(uint32_t crc, const unsigned char* data, size_t length)
+{
+    if (!crcTable[1]) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            crcTable[n] = c;
+        }
+    }
+
+    for (size_t i = 0; i < length; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void putBigEndian(unsigned char* p, uint32_t value)
+{
+    p[0] = (unsigned char) (value >> 24);
+    p[1] = (unsigned char) (value >> 16);
+    p[2] = (unsigned char) (value >> 8);
+    p[3] = (unsigned char) value;
+}
+
+// length, type, data, crc of type and data
+static bool writeChunk(FILE* f, const char* type, const unsigned char* data, uint32_t length)
+{
+    unsigned char header[8];
+    putBigEndian(header, length);
+    memcpy(header + 4, type, 4);
+
+    unsigned char crc[4];
+    putBigEndian(crc, updateCrc(updateCrc(0xffffffffu, header + 4, 4), data, length) ^ 0xffffffffu);
+
+    return fwrite(header, 1, 8, f) == 8
+        && (length == 0 || fwrite(data, 1, length, f) == length)
+        && fwrite(crc, 1, 4, f) == 4;
+}
+
+bool savePNG(const char* path, const FRAMEBUFFER* fb)
+{
+    // every row is a filter byte (0, none) and the RGB bytes, the whole lot
+    // goes into zlib stored blocks of at most 65535 bytes
+    size_t rowBytes = (size_t) fb->width * 3 + 1;
+    size_t raw = rowBytes * fb->height;
+    size_t blocks = (raw + 65534) / 65535;
+    size_t length = 2 + blocks * 5 + raw + 4;
+    if (length > 0x7fffffff)
+        return false;
+
+    unsigned char* data = (unsigned char*) malloc(length);
+    if (!data)
+        return false;
+
+    unsigned char* out = data;
+    *out++ = 0x78; // deflate, 32k window
+    *out++ = 0x01; // no preset dictionary, check bits
+
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t left = raw;
+    size_t inBlock = 0;
+    for (int y = 0; y < fb->height; y++) {
+        const uint32_t* src = fb->pixels + (size_t) y * fb->stride;
+        for (size_t i = 0; i < rowBytes; i++) {
+            if (inBlock == 0) {
+                size_t size = left < 65535 ? left : 65535;
+                *out++ = size == left; // final block flag
+                *out++ = (unsigned char) size;
+                *out++ = (unsigned char) (size >> 8);
+                *out++ = (unsigned char) ~size;
+                *out++ = (unsigned char) (~size >> 8);
+                inBlock = size;
+            }
+
+            unsigned char byte;
+            if (i == 0)
+                byte = 0;
+            else
+                byte = (unsigned char) (src[(i - 1) / 3] >> (16 - 8 * ((i - 1) % 3)));
+            *out++ = byte;
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+            inBlock--;
+            left--;
+        }
+    }
+    putBigEndian(out, (adlerB << 16) | adlerA);
+
+    unsigned char header[13];
+    putBigEndian(header, fb->width);
+    putBigEndian(header + 4, fb->height);
+    header[8] = 8;  // bits per channel
+    header[9] = 2;  // RGB
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // not interlaced
+
+    bool ok = false;
+    FILE* f = fopen(path, "wb");
+    if (f) {
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        ok = fwrite(signature, 1, 8, f) == 8
+            && writeChunk(f, "IHDR", header, 13)
+            && writeChunk(f, "IDAT", data, (uint32_t) length)
+            && writeChunk(f, "IEND", NULL, 0);
+        ok = fclose(f) == 0 && ok;
+    }
+
+    free(data);
+    return ok;
+}
@@ -0,0 +1,16 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+
+// binary PPM (P6) reading so captured/test frames can come from plain image files,
+// and PPM/PNG writing so rendered frames can be dumped and compared
+
+#include "BubbleRaster.h"
+
+// allocates fb->pixels with malloc, returns false if the file isn't a readable 8 bit P6
+bool loadPPM(const char* path, FRAMEBUFFER* fb);
+
+bool savePPM(const char* path, const FRAMEBUFFER* fb);
+// 8 bit RGB, stored (uncompressed) deflate blocks so it needs no zlib
+bool savePNG(const char* path, const FRAMEBUFFER* fb);
+
+#endif
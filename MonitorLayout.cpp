@@ -0,0 +1,113 @@
+#include "MonitorLayout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void initMonitorLayout(MONITOR_LAYOUT* layout)
+{
+    memset(layout, 0, sizeof(MONITOR_LAYOUT));
+}
+
+int addLayoutMonitor(MONITOR_LAYOUT* layout, DIRTY_RECT desktop)
+{
+    if (layout->count == MAX_MONITORS || desktop.right <= desktop.left || desktop.bottom <= desktop.top)
+        return -1;
+
+    int index = layout->count++;
+    layout->desktop[index] = desktop;
+
+    // the bounding box might have grown up or left, so every viewport moves
+    DIRTY_RECT bounds = layout->desktop[0];
+    for (int i = 1; i < layout->count; i++) {
+        DIRTY_RECT r = layout->desktop[i];
+        if (r.left < bounds.left) bounds.left = r.left;
+        if (r.top < bounds.top) bounds.top = r.top;
+        if (r.right > bounds.right) bounds.right = r.right;
+        if (r.bottom > bounds.bottom) bounds.bottom = r.bottom;
+    }
+
+    layout->originX = bounds.left;
+    layout->originY = bounds.top;
+    layout->worldWidth = bounds.right - bounds.left;
+    layout->worldHeight = bounds.bottom - bounds.top;
+    for (int i = 0; i < layout->count; i++) {
+        DIRTY_RECT r = layout->desktop[i];
+        DIRTY_RECT v = { r.left - bounds.left, r.top - bounds.top, r.right - bounds.left, r.bottom - bounds.top };
+        layout->viewports[i] = v;
+    }
+    return index;
+}
+
+bool parseMonitorLayout(MONITOR_LAYOUT* layout, const char* text)
+{
+    initMonitorLayout(layout);
+
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long width = strtol(p, &end, 10);
+        if (*end != 'x')
+            return false;
+        long height = strtol(end + 1, &end, 10);
+        if (*end != '+' && *end != '-')
+            return false;
+        long x = strtol(end, &end, 10);
+        if (*end != '+' && *end != '-')
+            return false;
+        long y = strtol(end, &end, 10);
+
+        DIRTY_RECT desktop = { (int) x, (int) y, (int) (x + width), (int) (y + height) };
+        if (addLayoutMonitor(layout, desktop) < 0)
+            return false;
+
+        if (*end == ',')
+            end++;
+        else if (*end)
+            return false;
+        p = end;
+    }
+    return layout->count > 0;
+}
+
+int monitorAt(const MONITOR_LAYOUT* layout, float x, float y)
+{
+    for (int i = 0; i < layout->count; i++) {
+        DIRTY_RECT v = layout->viewports[i];
+        if (x >= v.left && x < v.right && y >= v.top && y < v.bottom)
+            return i;
+    }
+    return -1;
+}
+
+long long layoutGapPixels(const MONITOR_LAYOUT* layout)
+{
+    // monitors on a desktop don't overlap, but mirrored ones can, so count
+    // each row's covered spans rather than adding up areas
+    long long gaps = 0;
+    for (int y = 0; y < layout->worldHeight; y++) {
+        int covered = 0;
+        int x = 0;
+        while (x < layout->worldWidth) {
+            // furthest right any viewport on this row that starts at or before x reaches
+            int reach = x;
+            int next = layout->worldWidth;
+            for (int i = 0; i < layout->count; i++) {
+                DIRTY_RECT v = layout->viewports[i];
+                if (y < v.top || y >= v.bottom)
+                    continue;
+                if (v.left <= x && v.right > reach)
+                    reach = v.right;
+                if (v.left > x && v.left < next)
+                    next = v.left;
+            }
+            if (reach > x) {
+                covered += reach - x;
+                x = reach;
+            } else {
+                x = next;
+            }
+        }
+        gaps += layout->worldWidth - covered;
+    }
+    return gaps;
+}
@@ -0,0 +1,38 @@
+#ifndef MONITOR_LAYOUT_H
+#define MONITOR_LAYOUT_H
+
+// how the monitors' windows map onto the one simulation world
+// the world is the bounding box of every monitor on the virtual desktop, moved
+// so its top left is (0, 0), and each monitor draws the part of it its
+// viewport covers. bubbles keep going across panel edges since there's only
+// one world. layouts that aren't a full rectangle (L shapes, panels of
+// different sizes) leave parts of the world no monitor shows
+
+#include "BubbleRaster.h"
+
+const int MAX_MONITORS = 16;
+
+struct MONITOR_LAYOUT {
+    int count;
+    DIRTY_RECT desktop[MAX_MONITORS];   // each monitor in virtual desktop coordinates
+    DIRTY_RECT viewports[MAX_MONITORS]; // the same rects in world coordinates
+    int originX;                        // virtual desktop position of the world's top left
+    int originY;
+    int worldWidth;
+    int worldHeight;
+};
+
+void initMonitorLayout(MONITOR_LAYOUT* layout);
+// adds a monitor and updates the world to cover it, -1 if it's empty or the layout is full
+int addLayoutMonitor(MONITOR_LAYOUT* layout, DIRTY_RECT desktop);
+
+// "WxH+X+Y,WxH+X+Y,..." (X and Y may be negative), false if it doesn't parse
+bool parseMonitorLayout(MONITOR_LAYOUT* layout, const char* text);
+
+// monitor whose viewport contains the world point, -1 if it's in a gap
+int monitorAt(const MONITOR_LAYOUT* layout, float x, float y);
+
+// how many pixels of the world no viewport covers
+long long layoutGapPixels(const MONITOR_LAYOUT* layout);
+
+#endif
@@ -0,0 +1,381 @@
+#include "Renderer.h"
+#include "ImageFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// room for the draw list when every bubble needs drawing
+static size_t drawListBytes(int capacity)
+{
+    return sizeof(BUBBLE_DRAWN) * capacity;
+}
+
+bool initFramePipeline(FRAME_PIPELINE* p, RENDERER renderer, CAPTURE_CACHE* capture, int capacity, uint32_t bubbleColor, FRAME_STATS* stats)
+{
+    memset(p, 0, sizeof(FRAME_PIPELINE));
+    p->renderer = renderer;
+    p->capture = capture;
+    p->stats = stats;
+    p->bubbleColor = bubbleColor;
+    p->drawn = (BUBBLE_DRAWN*) calloc(capacity, sizeof(BUBBLE_DRAWN));
+    p->fullRedraw = true;
+    p->sprites = true;
+    p->capacity = capacity;
+    p->backgroundMask = 0xffffff;
+    initSpriteAtlas(&p->atlas);
+    return p->drawn != NULL && initFrameArena(&p->arena, drawListBytes(capacity));
+}
+
+void freeFramePipeline(FRAME_PIPELINE* p)
+{
+    if (p->renderer.destroy)
+        p->renderer.destroy(p->renderer.context);
+    free(p->drawn);
+    freeSpriteAtlas(&p->atlas);
+    freeBubbleSnapshot(&p->view);
+    freeFrameArena(&p->arena);
+    memset(p, 0, sizeof(FRAME_PIPELINE));
+}
+
+void framePipelineInvalidate(FRAME_PIPELINE* p)
+{
+    p->fullRedraw = true;
+}
+
+bool framePipelineSetOrigin(FRAME_PIPELINE* p, int x, int y)
+{
+    p->originX = x;
+    p->originY = y;
+    p->fullRedraw = true;
+    // resuming allocates it
+    if ((x || y) && !p->view.bubbles && !p->suspended)
+        return initBubbleSnapshot(&p->view, p->capacity);
+    return true;
+}
+
+void framePipelineSuspend(FRAME_PIPELINE* p)
+{
+    if (p->suspended)
+        return;
+
+    RENDERER* r = &p->renderer;
+    if (r->release)
+        r->release(r->context, &r->frame, &r->background);
+    free(p->drawn);
+    p->drawn = NULL;
+    p->drawnCount = 0;
+    freeBubbleSnapshot(&p->view);
+    freeFrameArena(&p->arena);
+    freeSpriteAtlas(&p->atlas);
+    p->suspended = true;
+}
+
+// a grab doesn't say what changed, so every cell is looked at
+static void scanBackground(FRAME_PIPELINE* p)
+{
+    if (!p->field || p->field->mode == FIELD_OFF)
+        return;
+    const FRAMEBUFFER* bg = &p->renderer.background;
+    DIRTY_RECT all = { 0, 0, bg->width, bg->height };
+    backgroundFieldScan(p->field, bg, p->originX, p->originY, all);
+}
+
+// the field has to see the desktop before the mask darkens it, a dark enough
+// mask leaves no edge or bright spot to find
+static bool grabBackground(FRAME_PIPELINE* p)
+{
+    FRAMEBUFFER* bg = &p->renderer.background;
+    if (!captureFrame(p->capture, bg))
+        return false;
+    scanBackground(p);
+    if (p->backgroundMask != 0xffffff) {
+        for (int y = 0; y < bg->height; y++) {
+            uint32_t* row = bg->pixels + (size_t) y * bg->stride;
+            for (int x = 0; x < bg->width; x++)
+                row[x] &= p->backgroundMask;
+        }
+    }
+    return true;
+}
+
+bool framePipelineResume(FRAME_PIPELINE* p, const BUBBLE_SNAPSHOT* snap)
+{
+    if (!p->suspended)
+        return true;
+
+    RENDERER* r = &p->renderer;
+    if (r->acquire && !r->acquire(r->context, &r->frame, &r->background))
+        return false;
+    p->drawn = (BUBBLE_DRAWN*) calloc(p->capacity, sizeof(BUBBLE_DRAWN));
+    bool viewOk = (!p->originX && !p->originY) || initBubbleSnapshot(&p->view, p->capacity);
+    bool arenaOk = initFrameArena(&p->arena, drawListBytes(p->capacity));
+    if (!p->drawn || !viewOk || !arenaOk) {
+        p->suspended = false;
+        framePipelineSuspend(p);
+        return false;
+    }
+    p->suspended = false;
+    p->fullRedraw = true;
+
+    if (r->beginFrame)
+        r->beginFrame(r->context);
+
+    // the background went with the buffers, grab it now rather than in the first frame
+    if (p->capture) {
+        captureInvalidate(p->capture);
+        grabBackground(p);
+    }
+
+    // writing every page of the frame now means the first frame doesn't fault them in
+    DIRTY_RECT all = { 0, 0, r->frame.width, r->frame.height };
+    copyRect(&r->frame, &r->background, all);
+
+    if (p->sprites && snap) {
+        for (int i = 0; i < snap->count; i++)
+            atlasSprite(&p->atlas, snap->bubbles[i].r, p->hardEdges);
+    }
+    return true;
+}
+
+size_t framePipelineBytes(const FRAME_PIPELINE* p)
+{
+    const RENDERER* r = &p->renderer;
+    size_t bytes = spriteAtlasBytes(&p->atlas);
+    if (r->frame.pixels)
+        bytes += sizeof(uint32_t) * r->frame.stride * r->frame.height;
+    if (r->background.pixels)
+        bytes += sizeof(uint32_t) * r->background.stride * r->background.height;
+    if (p->drawn)
+        bytes += sizeof(BUBBLE_DRAWN) * p->capacity;
+    if (p->view.bubbles)
+        bytes += sizeof(BUBBLE) * p->view.capacity;
+    return bytes + frameArenaBytes(&p->arena);
+}
+
+// the snapshot in frame coordinates
+static const BUBBLE_SNAPSHOT* viewSnapshot(FRAME_PIPELINE* p, const BUBBLE_SNAPSHOT* snap)
+{
+    if (!p->originX && !p->originY)
+        return snap;
+
+    BUBBLE_SNAPSHOT* view = &p->view;
+    view->time = snap->time;
+    view->step = snap->step;
+    view->count = snap->count < view->capacity ? snap->count : view->capacity;
+
+    float dx = (float) p->originX;
+    float dy = (float) p->originY;
+    for (int i = 0; i < view->count; i++) {
+        BUBBLE* b = &view->bubbles[i];
+        *b = snap->bubbles[i];
+        b->x -= dx;
+        b->y -= dy;
+        b->prevX -= dx;
+        b->prevY -= dy;
+    }
+    return view;
+}
+
+static void recordStage(FRAME_PIPELINE* p, FRAME_STAGE stage, long long nanos)
+{
+    if (p->stats)
+        frameStatsRecord(p->stats, stage, nanos);
+}
+
+void renderFrame(FRAME_PIPELINE* p, const BUBBLE_SNAPSHOT* snap, float alpha)
+{
+    if (p->suspended)
+        return;
+
+    RENDERER* r = &p->renderer;
+    snap = viewSnapshot(p, snap);
+    if (r->beginFrame)
+        r->beginFrame(r->context);
+
+    frameArenaReset(&p->arena);
+    clearDirtyRects(&p->dirty);
+
+    long long start = nowNanos();
+    if (p->capture && grabBackground(p))
+        p->fullRedraw = true;
+    if (p->fullRedraw) {
+        markAllDirty(&p->dirty, r->frame.width, r->frame.height);
+        p->fullRedraw = false;
+    }
+
+    long long captured = nowNanos();
+    markBubbleDirtyRects(&p->dirty, p->drawn, &p->drawnCount, snap, alpha, r->frame.width, r->frame.height);
+    restoreDirtyRects(&r->frame, &r->background, &p->dirty);
+
+    long long restored = nowNanos();
+    SPRITE_ATLAS* atlas = p->sprites ? &p->atlas : NULL;
+    BUBBLE_DRAWN* list = (BUBBLE_DRAWN*) frameAlloc(&p->arena, sizeof(BUBBLE_DRAWN) * p->drawnCount);
+    if (list) {
+        int listed = listBubblesInDirtyRects(list, &p->dirty, p->drawn, p->drawnCount);
+        drawBubbleList(&r->frame, &p->dirty, list, listed, p->bubbleColor, p->hardEdges, atlas);
+    } else {
+        drawBubblesInDirtyRects(&r->frame, &p->dirty, snap, alpha, p->bubbleColor, p->hardEdges, atlas);
+    }
+
+    long long drawn = nowNanos();
+    r->present(r->context, &r->frame, &p->dirty);
+
+    recordStage(p, STAGE_CAPTURE, captured - start);
+    recordStage(p, STAGE_BACKGROUND, restored - captured);
+    recordStage(p, STAGE_RASTERIZE, drawn - restored);
+    recordStage(p, STAGE_PRESENT, nowNanos() - drawn);
+}
+
+//=======================Headless renderer=====================
+
+struct HEADLESS_RENDERER {
+    FRAMEBUFFER frame;
+    FRAMEBUFFER background;
+    FRAMEBUFFER screen; // stands in for the window, present copies the dirty rects here
+    uint32_t backgroundColor;
+    char dumpPattern[260];
+    int dumpEvery;
+    long long frames;
+    bool png;
+};
+
+bool formatDumpPath(char* out, size_t size, const char* pattern, long long frame)
+{
+    size_t length = 0;
+    int conversions = 0;
+    for (const char* p = pattern; *p; p++) {
+        char piece[32] = { *p, 0 };
+        if (*p == '%' && p[1] == '%') {
+            p++;
+        } else if (*p == '%') {
+            bool zeroPad = *++p == '0';
+            if (zeroPad)
+                p++;
+            int width = 0;
+            while (*p >= '0' && *p <= '9' && width < 100)
+                width = width * 10 + *p++ - '0';
+            if (*p != 'd' || conversions++)
+                return false;
+            snprintf(piece, sizeof(piece), zeroPad ? "%0*lld" : "%*lld", width, frame);
+        }
+
+        size_t pieceLength = strlen(piece);
+        if (length + pieceLength >= size)
+            return false;
+        memcpy(out + length, piece, pieceLength);
+        length += pieceLength;
+    }
+    out[length] = 0;
+    return conversions == 1;
+}
+
+static void presentHeadless(void* context, const FRAMEBUFFER* frame, const DIRTY_RECTS* dirty)
+{
+    HEADLESS_RENDERER* h = (HEADLESS_RENDERER*) context;
+    for (int i = 0; i < dirty->count; i++)
+        copyRect(&h->screen, frame, dirty->rects[i]);
+
+    if (h->dumpPattern[0] && h->frames % h->dumpEvery == 0) {
+        char path[300];
+        bool saved = formatDumpPath(path, sizeof(path), h->dumpPattern, h->frames)
+            && (h->png ? savePNG(path, &h->screen) : savePPM(path, &h->screen));
+        if (!saved)
+            fprintf(stderr, "couldn't write %s\n", path);
+    }
+    h->frames++;
+}
+
+static void allocateFramebuffer(FRAMEBUFFER* fb, int width, int height)
+{
+    fb->width = width;
+    fb->height = height;
+    fb->stride = width;
+    fb->pixels = (uint32_t*) malloc(sizeof(uint32_t) * width * height);
+}
+
+// the screen is the window, which stays around while minimized
+static void releaseHeadless(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background)
+{
+    HEADLESS_RENDERER* h = (HEADLESS_RENDERER*) context;
+    free(h->frame.pixels);
+    free(h->background.pixels);
+    h->frame.pixels = NULL;
+    h->background.pixels = NULL;
+    *frame = h->frame;
+    *background = h->background;
+}
+
+static bool acquireHeadless(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background)
+{
+    HEADLESS_RENDERER* h = (HEADLESS_RENDERER*) context;
+    allocateFramebuffer(&h->frame, h->screen.width, h->screen.height);
+    allocateFramebuffer(&h->background, h->screen.width, h->screen.height);
+    if (!h->frame.pixels || !h->background.pixels) {
+        releaseHeadless(h, frame, background);
+        return false;
+    }
+
+    DIRTY_RECT all = { 0, 0, h->screen.width, h->screen.height };
+    fillRect(&h->background, all, h->backgroundColor);
+    *frame = h->frame;
+    *background = h->background;
+    return true;
+}
+
+static void destroyHeadless(void* context)
+{
+    HEADLESS_RENDERER* h = (HEADLESS_RENDERER*) context;
+    free(h->frame.pixels);
+    free(h->background.pixels);
+    free(h->screen.pixels);
+    free(h);
+}
+
+RENDERER createHeadlessRenderer(int width, int height, uint32_t backgroundColor, const char* dumpPattern, int dumpEvery)
+{
+    RENDERER r = {};
+    HEADLESS_RENDERER* h = (HEADLESS_RENDERER*) calloc(1, sizeof(HEADLESS_RENDERER));
+    if (!h)
+        return r;
+
+    allocateFramebuffer(&h->frame, width, height);
+    allocateFramebuffer(&h->background, width, height);
+    allocateFramebuffer(&h->screen, width, height);
+    if (!h->frame.pixels || !h->background.pixels || !h->screen.pixels) {
+        destroyHeadless(h);
+        return r;
+    }
+
+    DIRTY_RECT all = { 0, 0, width, height };
+    h->backgroundColor = backgroundColor;
+    fillRect(&h->background, all, backgroundColor);
+    fillRect(&h->screen, all, 0);
+
+    char path[300];
+    if (dumpPattern && !formatDumpPath(path, sizeof(path), dumpPattern, 0)) {
+        fprintf(stderr, "dump pattern %s needs exactly one %%d, not dumping\n", dumpPattern);
+        dumpPattern = NULL;
+    }
+    if (dumpPattern) {
+        snprintf(h->dumpPattern, sizeof(h->dumpPattern), "%s", dumpPattern);
+        size_t length = strlen(h->dumpPattern);
+        h->png = length >= 4 && !strcmp(h->dumpPattern + length - 4, ".png");
+    }
+    h->dumpEvery = dumpEvery > 0 ? dumpEvery : 1;
+
+    r.context = h;
+    r.frame = h->frame;
+    r.background = h->background;
+    r.beginFrame = NULL;
+    r.present = presentHeadless;
+    r.release = releaseHeadless;
+    r.acquire = acquireHeadless;
+    r.destroy = destroyHeadless;
+    return r;
+}
+
+const FRAMEBUFFER* headlessScreen(const RENDERER* renderer)
+{
+    return &((const HEADLESS_RENDERER*) renderer->context)->screen;
+}
@@ -0,0 +1,105 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+// where frames get drawn and shown
+// the background restore and the bubbles are drawn on the cpu into the
+// renderer's two framebuffers, so a backend only has to provide those and a
+// way to present the changed parts. the screensaver uses GDI (DIB sections
+// and BitBlt, in HPBubbleScreensaver.cpp), the headless one keeps everything
+// in memory and can dump presented frames to image files so the whole frame
+// pipeline runs and can be profiled without windows
+
+#include "BubbleRaster.h"
+#include "BubbleSprites.h"
+#include "CaptureSource.h"
+#include "FrameStats.h"
+#include "BackgroundField.h"
+#include "FrameArena.h"
+
+struct RENDERER {
+    void* context;
+    FRAMEBUFFER frame;      // the bubbles are drawn here and the dirty rects presented from it
+    FRAMEBUFFER background; // what's behind the bubbles, dirty rects are restored from it
+    // called before the cpu touches frame or background each frame (GDI has to flush first)
+    void (*beginFrame)(void* context);
+    // shows the dirty parts of frame
+    void (*present)(void* context, const FRAMEBUFFER* frame, const DIRTY_RECTS* dirty);
+    // free the memory behind frame and background while suspended (pixels become NULL)
+    // and get it back, acquire returns false if it couldn't. NULL keeps them for good
+    void (*release)(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background);
+    bool (*acquire)(void* context, FRAMEBUFFER* frame, FRAMEBUFFER* background);
+    void (*destroy)(void* context);
+};
+
+// one frame from capture to present, shared by every backend
+struct FRAME_PIPELINE {
+    RENDERER renderer;
+    CAPTURE_CACHE* capture;     // NULL keeps whatever the renderer's background starts with
+    FRAME_STATS* stats;         // NULL to not time the stages
+    uint32_t bubbleColor;
+    DIRTY_RECTS dirty;          // parts of frame that need redrawing and presenting this frame
+    BUBBLE_DRAWN* drawn;        // where each bubble was drawn last frame
+    int drawnCount;
+    bool fullRedraw;            // redraw and present everything next frame
+    SPRITE_ATLAS atlas;
+    bool sprites;               // draw from the atlas instead of drawCircleAA
+    bool hardEdges;             // no blended edges (drawCircleHard), for when bubbleColor is a colour key
+    int capacity;
+    int originX;                // world position of the frame's top left, for one monitor of several
+    int originY;
+    BUBBLE_SNAPSHOT view;       // the snapshot moved by the origin, unused at (0, 0)
+    bool suspended;             // see framePipelineSuspend
+    // every grab is scanned into it at the origin (rebuilding it is up to the caller), NULL
+    // or a field that's FIELD_OFF for none
+    BACKGROUND_FIELD* field;
+    // ANDed into every grab after the field has scanned it (the saver's background
+    // colour), 0xffffff leaves it as grabbed
+    uint32_t backgroundMask;
+    FRAME_ARENA arena;          // scratch for one frame (the draw list), reset by renderFrame
+};
+
+// capacity is the most bubbles a snapshot can hold
+bool initFramePipeline(FRAME_PIPELINE* p, RENDERER renderer, CAPTURE_CACHE* capture, int capacity, uint32_t bubbleColor, FRAME_STATS* stats);
+// also destroys the renderer
+void freeFramePipeline(FRAME_PIPELINE* p);
+
+// makes the next frame redraw and present everything (e.g. the window was restored)
+void framePipelineInvalidate(FRAME_PIPELINE* p);
+
+// draws the part of the world whose top left is (x, y) (see MonitorLayout.h)
+bool framePipelineSetOrigin(FRAME_PIPELINE* p, int x, int y);
+
+// while the window is minimized: gives back the framebuffers, the drawn
+// bubbles, the view snapshot, the frame arena and the sprite masks, and
+// renderFrame does nothing
+void framePipelineSuspend(FRAME_PIPELINE* p);
+// gets them back and does the slow parts of the first frame up front (grabbing
+// the background, faulting in the frame, rasterizing the sprites snap needs) so
+// the next renderFrame costs no more than any full redraw. snap can be NULL
+// returns false and stays suspended if the memory isn't there
+bool framePipelineResume(FRAME_PIPELINE* p, const BUBBLE_SNAPSHOT* snap);
+
+// memory held by the buffers framePipelineSuspend gives back
+size_t framePipelineBytes(const FRAME_PIPELINE* p);
+
+// captures the background if it's due, draws the bubbles alpha of the way between
+// the snapshot's last two steps and presents what changed
+void renderFrame(FRAME_PIPELINE* p, const BUBBLE_SNAPSHOT* snap, float alpha);
+
+// renders into memory, background starts out filled with backgroundColor
+// with dumpPattern set every dumpEvery-th presented frame is written to
+// the file it names, formatted with the frame number (e.g. "frame%05d.png"),
+// as PNG if it ends in .png and PPM otherwise
+// frame.pixels is NULL if the buffers couldn't be allocated. a pattern
+// formatDumpPath won't take is left out with a warning
+RENDERER createHeadlessRenderer(int width, int height, uint32_t backgroundColor, const char* dumpPattern, int dumpEvery);
+
+// pattern with frame in place of its one %d (%5d, %05d..., %% for a literal %)
+// the pattern comes from the command line so it's never handed to printf
+// false if it has any other conversion, none or more than one, or out is too small
+bool formatDumpPath(char* out, size_t size, const char* pattern, long long frame);
+
+// what the headless renderer last presented, for comparing against golden images
+const FRAMEBUFFER* headlessScreen(const RENDERER* renderer);
+
+#endif
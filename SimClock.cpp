@@ -0,0 +1,32 @@
+#include "SimClock.h"
+
+void initSimClock(SIM_CLOCK* clock, double dt)
+{
+    clock->dt = dt;
+    clock->accumulator = 0;
+    clock->steps = 0;
+}
+
+int simClockAdvance(SIM_CLOCK* clock, double elapsedSeconds)
+{
+    if (elapsedSeconds < 0)
+        elapsedSeconds = 0;
+    if (elapsedSeconds > SIM_MAX_FRAME_TIME)
+        elapsedSeconds = SIM_MAX_FRAME_TIME;
+
+    clock->accumulator += elapsedSeconds;
+
+    int steps = 0;
+    while (clock->accumulator >= clock->dt) {
+        clock->accumulator -= clock->dt;
+        steps++;
+    }
+
+    clock->steps += steps;
+    return steps;
+}
+
+float simClockAlpha(const SIM_CLOCK* clock)
+{
+    return (float) (clock->accumulator / clock->dt);
+}
@@ -0,0 +1,27 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+// fixed timestep clock for the bubble physics
+// real time is fed in with simClockAdvance and converted into a whole number
+// of physics steps, the leftover fraction is used to interpolate drawing
+
+// bubble velocities are in pixels per step and were tuned at ~30fps
+const double SIM_DT = 1.0 / 30;
+// never try to catch up on more than this much real time at once (e.g. after being minimized)
+const double SIM_MAX_FRAME_TIME = 0.25;
+
+struct SIM_CLOCK {
+    double dt;
+    double accumulator; // real time not yet simulated, always < dt after advancing
+    long long steps;    // total steps taken
+};
+
+void initSimClock(SIM_CLOCK* clock, double dt);
+
+// adds elapsed real time and returns how many physics steps to run now
+int simClockAdvance(SIM_CLOCK* clock, double elapsedSeconds);
+
+// how far between the previous and current physics state to draw (0 - 1)
+float simClockAlpha(const SIM_CLOCK* clock);
+
+#endif
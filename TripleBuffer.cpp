@@ -0,0 +1,38 @@
+#include "TripleBuffer.h"
+
+#include <stddef.h>
+
+void initTripleBuffer(TRIPLE_BUFFER* tb, void* slot0, void* slot1, void* slot2)
+{
+    tb->slots[0] = slot0;
+    tb->slots[1] = slot1;
+    tb->slots[2] = slot2;
+    tb->writeIndex = 0;
+    tb->middle = 1;
+    tb->readIndex = 2;
+}
+
+void* tripleBufferWriteSlot(TRIPLE_BUFFER* tb)
+{
+    return tb->slots[tb->writeIndex];
+}
+
+void tripleBufferPublish(TRIPLE_BUFFER* tb)
+{
+    // release so the snapshot contents are visible before the consumer can grab the slot
+    int old = __atomic_exchange_n(&tb->middle, tb->writeIndex | TRIPLE_BUFFER_FRESH, __ATOMIC_ACQ_REL);
+    tb->writeIndex = old & ~TRIPLE_BUFFER_FRESH;
+}
+
+void* tripleBufferRead(TRIPLE_BUFFER* tb, bool* isNew)
+{
+    bool fresh = __atomic_load_n(&tb->middle, __ATOMIC_ACQUIRE) & TRIPLE_BUFFER_FRESH;
+    if (fresh) {
+        int old = __atomic_exchange_n(&tb->middle, tb->readIndex, __ATOMIC_ACQ_REL);
+        tb->readIndex = old & ~TRIPLE_BUFFER_FRESH;
+    }
+
+    if (isNew)
+        *isNew = fresh;
+    return tb->slots[tb->readIndex];
+}
@@ -0,0 +1,27 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// lock free triple buffer for handing snapshots from one producer thread
+// to one consumer thread. the producer always has a slot to write into and
+// the consumer always gets the newest finished slot, neither ever waits
+
+struct TRIPLE_BUFFER {
+    void* slots[3];
+    int writeIndex; // only touched by the producer
+    int readIndex;  // only touched by the consumer
+    int middle;     // slot index waiting to be picked up, plus TRIPLE_BUFFER_FRESH if unread
+};
+
+const int TRIPLE_BUFFER_FRESH = 4;
+
+void initTripleBuffer(TRIPLE_BUFFER* tb, void* slot0, void* slot1, void* slot2);
+
+// producer side
+void* tripleBufferWriteSlot(TRIPLE_BUFFER* tb);
+void tripleBufferPublish(TRIPLE_BUFFER* tb);
+
+// consumer side, returns the newest published slot (or the one read last time
+// if nothing new was published). sets *isNew if it changed, isNew may be NULL
+void* tripleBufferRead(TRIPLE_BUFFER* tb, bool* isNew);
+
+#endif
@@ -0,0 +1,297 @@
+#include "WorkPool.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// the workers sleep on this between jobs so an idle pool costs nothing
+struct WORK_WAKE {
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE changed;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+};
+
+static void lockWake(WORK_WAKE* w)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&w->lock);
+#else
+    pthread_mutex_lock(&w->lock);
+#endif
+}
+
+static void unlockWake(WORK_WAKE* w)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&w->lock);
+#else
+    pthread_mutex_unlock(&w->lock);
+#endif
+}
+
+// call with the lock held
+static void waitWake(WORK_WAKE* w)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(&w->changed, &w->lock, INFINITE);
+#else
+    pthread_cond_wait(&w->changed, &w->lock);
+#endif
+}
+
+static void wakeAll(WORK_WAKE* w)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&w->changed);
+#else
+    pthread_cond_broadcast(&w->changed);
+#endif
+}
+
+static void yieldThread()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+int cpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#endif
+}
+
+// pops a chunk off the front (owner) or back (thief) of a queue
+static bool takeChunk(WORK_QUEUE* q, bool fromBack, int* chunk)
+{
+    unsigned long long old = __atomic_load_n(&q->bounds, __ATOMIC_ACQUIRE);
+    while (true) {
+        unsigned int first = (unsigned int) old;
+        unsigned int last = (unsigned int) (old >> 32);
+        if (first >= last)
+            return false;
+
+        unsigned long long next;
+        if (fromBack)
+            next = first | (unsigned long long) (last - 1) << 32;
+        else
+            next = (first + 1) | (unsigned long long) last << 32;
+
+        if (__atomic_compare_exchange_n(&q->bounds, &old, next, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *chunk = fromBack ? last - 1 : first;
+            return true;
+        }
+    }
+}
+
+static void runChunk(WORK_POOL* pool, int chunk, int worker)
+{
+    int begin = chunk * pool->grain;
+    int end = begin + pool->grain;
+    if (end > pool->count)
+        end = pool->count;
+    pool->function(pool->context, begin, end, worker);
+}
+
+// works through this worker's queue, then steals until every queue is empty
+static void runChunks(WORK_POOL* pool, int worker)
+{
+    int chunk;
+    while (true) {
+        if (takeChunk(&pool->queues[worker], false, &chunk)) {
+            runChunk(pool, chunk, worker);
+            continue;
+        }
+
+        bool stole = false;
+        for (int v = 1; v < pool->numWorkers && !stole; v++) {
+            int victim = (worker + v) % pool->numWorkers;
+            if (takeChunk(&pool->queues[victim], true, &chunk)) {
+                runChunk(pool, chunk, worker);
+                stole = true;
+            }
+        }
+        if (!stole)
+            return;
+    }
+}
+
+struct WORKER_START {
+    WORK_POOL* pool;
+    int worker;
+};
+
+static void workerLoop(WORK_POOL* pool, int worker)
+{
+    WORK_WAKE* wake = (WORK_WAKE*) pool->wake;
+    int seen = 0;
+
+    while (true) {
+        lockWake(wake);
+        while (pool->generation == seen && !pool->quit)
+            waitWake(wake);
+        seen = pool->generation;
+        bool quit = pool->quit;
+        unlockWake(wake);
+
+        if (quit)
+            return;
+
+        runChunks(pool, worker);
+        // release so the caller sees everything this job wrote
+        __atomic_sub_fetch(&pool->busy, 1, __ATOMIC_RELEASE);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerThread(LPVOID param)
+#else
+static void* workerThread(void* param)
+#endif
+{
+    WORKER_START* start = (WORKER_START*) param;
+    WORK_POOL* pool = start->pool;
+    int worker = start->worker;
+    free(start);
+
+    workerLoop(pool, worker);
+    return 0;
+}
+
+bool initWorkPool(WORK_POOL* pool, int threads)
+{
+    if (threads <= 0)
+        threads = cpuCount();
+
+    pool->numWorkers = threads;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = false;
+    pool->threads = (void**) calloc(threads, sizeof(void*));
+    pool->queues = (WORK_QUEUE*) calloc(threads, sizeof(WORK_QUEUE));
+
+    WORK_WAKE* wake = (WORK_WAKE*) malloc(sizeof(WORK_WAKE));
+    pool->wake = wake;
+    if (!pool->threads || !pool->queues || !wake) {
+        free(pool->threads);
+        free(pool->queues);
+        free(wake);
+        pool->numWorkers = 0;
+        return false;
+    }
+
+#ifdef _WIN32
+    InitializeCriticalSection(&wake->lock);
+    InitializeConditionVariable(&wake->changed);
+#else
+    pthread_mutex_init(&wake->lock, NULL);
+    pthread_cond_init(&wake->changed, NULL);
+#endif
+
+    // worker 0 is whoever calls workPoolFor
+    for (int w = 1; w < threads; w++) {
+        WORKER_START* start = (WORKER_START*) malloc(sizeof(WORKER_START));
+        start->pool = pool;
+        start->worker = w;
+#ifdef _WIN32
+        pool->threads[w] = CreateThread(NULL, 0, workerThread, start, 0, NULL);
+#else
+        pthread_t* thread = (pthread_t*) malloc(sizeof(pthread_t));
+        pthread_create(thread, NULL, workerThread, start);
+        pool->threads[w] = thread;
+#endif
+    }
+    return true;
+}
+
+void freeWorkPool(WORK_POOL* pool)
+{
+    if (pool->numWorkers == 0)
+        return;
+
+    WORK_WAKE* wake = (WORK_WAKE*) pool->wake;
+    lockWake(wake);
+    pool->quit = true;
+    wakeAll(wake);
+    unlockWake(wake);
+
+    for (int w = 1; w < pool->numWorkers; w++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[w], INFINITE);
+        CloseHandle(pool->threads[w]);
+#else
+        pthread_join(*(pthread_t*) pool->threads[w], NULL);
+        free(pool->threads[w]);
+#endif
+    }
+
+#ifdef _WIN32
+    DeleteCriticalSection(&wake->lock);
+#else
+    pthread_mutex_destroy(&wake->lock);
+    pthread_cond_destroy(&wake->changed);
+#endif
+
+    free(wake);
+    free(pool->threads);
+    free(pool->queues);
+    pool->numWorkers = 0;
+}
+
+void workPoolFor(WORK_POOL* pool, int count, int grain, WORK_FUNCTION function, void* context)
+{
+    if (count <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+
+    int chunks = (count + grain - 1) / grain;
+    if (pool->numWorkers <= 1 || chunks == 1) {
+        function(context, 0, count, 0);
+        return;
+    }
+
+    pool->function = function;
+    pool->context = context;
+    pool->count = count;
+    pool->grain = grain;
+
+    // deal the chunks out as one contiguous run per worker
+    int n = pool->numWorkers;
+    for (int w = 0; w < n; w++) {
+        unsigned long long first = (long long) chunks * w / n;
+        unsigned long long last = (long long) chunks * (w + 1) / n;
+        __atomic_store_n(&pool->queues[w].bounds, first | last << 32, __ATOMIC_RELAXED);
+    }
+    pool->busy = n - 1;
+
+    WORK_WAKE* wake = (WORK_WAKE*) pool->wake;
+    lockWake(wake);
+    pool->generation++;
+    wakeAll(wake);
+    unlockWake(wake);
+
+    runChunks(pool, 0);
+
+    // workers may still be finishing chunks they took (or stole) before the queues ran dry
+    while (__atomic_load_n(&pool->busy, __ATOMIC_ACQUIRE) > 0)
+        yieldThread();
+}
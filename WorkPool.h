@@ -0,0 +1,46 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+// small fixed size thread pool for splitting loops across cores
+//
+// workPoolFor cuts [0, count) into chunks of grain items and deals them out
+// to the workers as contiguous runs. a worker eats its own run from the front
+// and once it's empty steals single chunks off the back of the others' runs,
+// so uneven chunks still keep every core busy. the calling thread works too
+// and the call returns once every chunk is done
+//
+// which worker runs a chunk is not deterministic, so work functions must only
+// write data owned by their range (worker is there to index per thread scratch)
+
+typedef void (*WORK_FUNCTION)(void* context, int begin, int end, int worker);
+
+struct WORK_QUEUE {
+    unsigned long long bounds; // next chunk in the low 32 bits, end in the high 32 bits
+    char pad[56];              // keep each queue on its own cache line
+};
+
+struct WORK_POOL {
+    int numWorkers; // including the calling thread
+    void** threads;
+    WORK_QUEUE* queues;
+    void* wake;     // platform mutex + condition variable
+
+    // current job, written by the caller before waking the workers
+    WORK_FUNCTION function;
+    void* context;
+    int count;
+    int grain;
+    int generation; // bumped for every job, workers wait for it to change
+    int busy;       // workers that haven't finished the current job yet
+    bool quit;
+};
+
+// threads <= 0 means one per core. a pool of 1 runs everything on the caller
+bool initWorkPool(WORK_POOL* pool, int threads);
+void freeWorkPool(WORK_POOL* pool);
+
+void workPoolFor(WORK_POOL* pool, int count, int grain, WORK_FUNCTION function, void* context);
+
+int cpuCount();
+
+#endif
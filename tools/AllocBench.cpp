@@ -0,0 +1,245 @@
+// headless check that the frame loop leaves the heap alone once it's warmed up
+// runs frames the way the saver does (a physics step, a snapshot, then the
+// frame pipeline on the headless renderer grabbing a synthetic desktop every
+// --capture-every frames, scanned into a desktop field the bubbles bounce off)
+// with malloc, calloc, realloc and free swapped for ones that count calls
+// (glibc only, they hand everything on to glibc's own), and prints as JSON how
+// many allocations the frames made before and after --warmup
+//
+// usage: AllocBench [--bubbles 2000] [--width 1920] [--height 1080] [--frames 600]
+//                   [--warmup 60] [--mode parallel|grid] [--threads 0] [--seed 1]
+//                   [--radius-dist fixed|uniform|power-law|bimodal]
+//                   [--field off|edges|bright] [--capture-every 30]
+//
+// it exits with 1 if any frame after the warm up allocated or freed anything
+// (which includes a frame arena spilling, see FrameArena.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../BubblePhysics.h"
+#include "../BubbleParallel.h"
+#include "../BackgroundField.h"
+#include "../Renderer.h"
+#include "../FrameStats.h"
+
+//=======================Counting allocator=====================
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+// every thread's calls count, the physics workers' included
+static long long allocations;
+static long long frees;
+
+static void countAllocation()
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+extern "C" void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(p, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** out, size_t alignment, size_t size)
+{
+    countAllocation();
+    *out = __libc_memalign(alignment, size);
+    return *out ? 0 : 12; // ENOMEM
+}
+
+extern "C" void free(void* p)
+{
+    if (p)
+        __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+    __libc_free(p);
+}
+
+static long long heapCalls()
+{
+    return __atomic_load_n(&allocations, __ATOMIC_RELAXED) + __atomic_load_n(&frees, __ATOMIC_RELAXED);
+}
+
+//=======================Frame loop=====================
+
+struct OPTIONS {
+    int bubbles;
+    int width;
+    int height;
+    int frames;
+    int warmup;
+    const char* mode;
+    int threads;
+    unsigned int seed;
+    RADIUS_DISTRIBUTION radiusDistribution;
+    FIELD_MODE field;
+    int captureEvery;
+};
+
+int main(int argc, char** argv)
+{
+    OPTIONS opt = { 2000, 1920, 1080, 600, 60, "parallel", 0, 1, RADIUS_FIXED, FIELD_EDGES, 30 };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--bubbles")) opt.bubbles = atoi(value);
+        else if (!strcmp(argv[i], "--width")) opt.width = atoi(value);
+        else if (!strcmp(argv[i], "--height")) opt.height = atoi(value);
+        else if (!strcmp(argv[i], "--frames")) opt.frames = atoi(value);
+        else if (!strcmp(argv[i], "--warmup")) opt.warmup = atoi(value);
+        else if (!strcmp(argv[i], "--mode")) opt.mode = value;
+        else if (!strcmp(argv[i], "--threads")) opt.threads = atoi(value);
+        else if (!strcmp(argv[i], "--seed")) opt.seed = (unsigned int) strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i], "--capture-every")) opt.captureEvery = atoi(value);
+        else if (!strcmp(argv[i], "--radius-dist")) {
+            if (!parseRadiusDistribution(value, &opt.radiusDistribution)) {
+                fprintf(stderr, "unknown radius distribution %s\n", value);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--field")) {
+            if (!parseFieldMode(value, &opt.field)) {
+                fprintf(stderr, "unknown field mode %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    bool parallel = !strcmp(opt.mode, "parallel");
+    if (opt.bubbles < 1 || opt.width < 1 || opt.height < 1 || opt.frames < 1 || opt.warmup < 0
+        || opt.captureEvery < 0 || (!parallel && strcmp(opt.mode, "grid"))) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    worldWidth = opt.width;
+    worldHeight = opt.height;
+    BUBBLE_RADIUS = scaledBubbleRadius(opt.width, opt.height, opt.bubbles);
+    radiusDistribution = opt.radiusDistribution;
+    minBubbleRadius = BUBBLE_RADIUS / 10.0f > 1 ? BUBBLE_RADIUS / 10.0f : 1;
+    maxBubbleRadius = BUBBLE_RADIUS * 10.0f;
+    float largest = (opt.width < opt.height ? opt.width : opt.height) / 4.0f;
+    if (maxBubbleRadius > largest)
+        maxBubbleRadius = largest;
+
+    seedBubbleRandom(opt.seed);
+    if (!allocateBubbles(opt.bubbles)) {
+        fprintf(stderr, "out of memory for %d bubbles\n", opt.bubbles);
+        return 1;
+    }
+    initializeBubbles(opt.bubbles);
+    parallelCollision = parallel && initParallelPhysics(opt.threads);
+
+    // the saver's physics thread reads a copy of the field the main thread built
+    static BACKGROUND_FIELD field, physicsField;
+    initBackgroundField(&field, opt.width, opt.height);
+    initBackgroundField(&physicsField, opt.width, opt.height);
+    setBackgroundFieldMode(&field, opt.field, 48, 224);
+    backgroundField = opt.field != FIELD_OFF ? &physicsField : NULL;
+
+    static CAPTURE_CACHE capture;
+    initCaptureCache(&capture, createSyntheticCapture(), opt.captureEvery);
+    static FRAME_PIPELINE pipeline;
+    RENDERER renderer = createHeadlessRenderer(opt.width, opt.height, colorrefToPixel(0x191919), NULL, 1);
+    if (!renderer.frame.pixels || !initFramePipeline(&pipeline, renderer, &capture, opt.bubbles, colorrefToPixel(0xffffff), NULL)) {
+        fprintf(stderr, "out of memory for the frame pipeline\n");
+        return 1;
+    }
+    pipeline.field = &field;
+
+    static BUBBLE_SNAPSHOT snap;
+    initBubbleSnapshot(&snap, opt.bubbles);
+
+    long long warmupCalls = 0;
+    long long steadyAllocations = 0;
+    long long steadyFrees = 0;
+    long long framesAllocating = 0;
+    long long worstFrame = 0;
+    int firstAllocatingFrame = -1;
+    long long start = 0;
+
+    for (int frame = 0; frame < opt.warmup + opt.frames; frame++) {
+        if (frame == opt.warmup)
+            start = nowNanos();
+        long long allocationsBefore = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+        long long freesBefore = __atomic_load_n(&frees, __ATOMIC_RELAXED);
+
+        stepBubbles();
+        takeBubbleSnapshot(&snap, frame, frame);
+        renderFrame(&pipeline, &snap, 0.5f);
+        if (backgroundFieldRebuild(&field))
+            copyBackgroundField(&physicsField, &field);
+
+        long long frameAllocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocationsBefore;
+        long long frameFrees = __atomic_load_n(&frees, __ATOMIC_RELAXED) - freesBefore;
+        if (frame < opt.warmup) {
+            warmupCalls += frameAllocations + frameFrees;
+            continue;
+        }
+
+        steadyAllocations += frameAllocations;
+        steadyFrees += frameFrees;
+        if (frameAllocations + frameFrees > 0) {
+            framesAllocating++;
+            if (firstAllocatingFrame < 0)
+                firstAllocatingFrame = frame;
+        }
+        if (frameAllocations + frameFrees > worstFrame)
+            worstFrame = frameAllocations + frameFrees;
+    }
+    double nsPerFrame = (double) (nowNanos() - start) / opt.frames;
+    long long callsBeforeExit = heapCalls();
+
+    printf("{\n  \"mode\": \"%s\", \"bubbles\": %d, \"width\": %d, \"height\": %d, \"radius_dist\": \"%s\", \"field\": \"%s\",\n",
+        opt.mode, opt.bubbles, opt.width, opt.height, radiusDistributionName(opt.radiusDistribution), fieldModeName(opt.field));
+    printf("  \"frames\": %d, \"warmup\": %d, \"us_per_frame\": %.1f, \"contacts\": %d,\n",
+        opt.frames, opt.warmup, nsPerFrame / 1e3, parallelCollision ? parallelContacts : 0);
+    printf("  \"physics_arena_bytes\": %zu, \"render_arena_bytes\": %zu, \"render_arena_grows\": %lld, \"render_arena_spills\": %lld,\n",
+        parallelCollision ? parallelArenaBytes() : 0, frameArenaBytes(&pipeline.arena), pipeline.arena.grows, pipeline.arena.spillCount);
+    printf("  \"warmup_heap_calls\": %lld, \"heap_calls_total\": %lld,\n", warmupCalls, callsBeforeExit);
+    printf("  \"steady_allocations\": %lld, \"steady_frees\": %lld, \"frames_allocating\": %lld, \"worst_frame\": %lld, \"first_allocating_frame\": %d\n}\n",
+        steadyAllocations, steadyFrees, framesAllocating, worstFrame, firstAllocatingFrame);
+
+    freeFramePipeline(&pipeline);
+    freeCaptureCache(&capture);
+    freeBubbleSnapshot(&snap);
+    freeBackgroundField(&field);
+    freeBackgroundField(&physicsField);
+    if (parallelCollision)
+        freeParallelPhysics();
+
+    return steadyAllocations + steadyFrees == 0 ? 0 : 1;
+}
@@ -0,0 +1,708 @@
+// headless benchmark for the bubble physics
+// runs the simulation without a window and prints the results as JSON
+//
+// usage: BubbleBench [--bubbles 10,1000,100000] [--width 1920] [--height 1080]
+//                    [--frames 600] [--warmup 30] [--seed 1]
+//                    [--mode grid|brute|soa|ccd|parallel] [--threads N] [--render 1]
+//                    [--impulse 1] [--restitution 1] [--gravity 0]
+//                    [--friction 1] [--damping 1] [--sleep 1] [--invariants 1]
+//                    [--sprites 1] [--dump frame%05d.png] [--dump-every 60]
+//                    [--monitors 1920x1080+0+0,1920x1080+1920+0] [--suspend 100]
+//                    [--radius-dist fixed|uniform|power-law|bimodal] [--min-radius 0]
+//                    [--max-radius 0] [--flat-grid 0] [--check-grid 0] [--pair-blocks 1]
+//
+// parallel mode runs BubbleParallel's step on --threads threads (0 = one per core).
+// the checksum covers every bubble's final state, so runs with different
+// thread counts can be compared
+//
+// energy_ratio is the total energy (kinetic plus gravitational) at the end over
+// the start. the walls are elastic, so with --impulse 1 and --restitution 1
+// it should stay close to 1 (gravity adds a little, the floor snaps bubbles back
+// up without taking any speed off) and with restitution < 1 it can only fall.
+// --invariants 1 first throws random pairs at resolveImpulse and checks every
+// one conserves momentum and doesn't gain energy, exiting with 1 if not
+//
+// with --render every step also goes through the frame pipeline on the headless
+// renderer and the physics/background/rasterize/present stage timings are reported,
+// --sprites 1 draws the circles from a BubbleSprites atlas instead of drawCircleAA.
+// --dump writes every --dump-every-th presented frame (warmup included) of the
+// last run to the file named by the pattern (one %d for the frame number), PNG
+// or PPM by its extension, and --seed keeps them the same from one run to the
+// next for golden image checks
+//
+// --monitors replaces --width/--height with a virtual desktop layout (see
+// MonitorLayout.h). every monitor gets its own headless renderer showing its
+// viewport of the one world, rendered in parallel like the screensaver's
+// present threads, with -m<index> added to its dump file names. at the end
+// the monitors' screens are compared with a single render of the whole world,
+// viewport_max_diff is the largest channel difference (0 if the partitioning
+// is right) and it exits with 1 if it isn't 0
+//
+// --suspend N minimizes and restores the saver every N rendered frames: the
+// pipelines are suspended, the physics skips that frame, and they're resumed
+// (warmed up) before the next render. it reports the bytes the pipelines hold
+// in each state, how long resuming took and the first frame after it next to
+// the very first frame of the run (which starts cold), compares the screens
+// with a fresh render at the end like --monitors does, and exits with 1 if a
+// suspended pipeline still held anything or the screens differ
+//
+// --radius-dist picks bubble sizes between --min-radius and --max-radius
+// (0 for a tenth and ten times the fixed radius, at most a quarter of the
+// shorter side), --flat-grid 1 puts them all in one grid level sized for the
+// biggest instead of a level per size class, to compare the two. --check-grid 1
+// finds every overlapping pair at the end by brute force and checks the grid
+// query from either bubble returns the other, missed_pairs is how many it
+// didn't and it exits with 1 if any
+//
+// --pair-blocks 0 turns off collisionCheck's batched pair tests (BubblePairs.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../BubblePhysics.h"
+#include "../BubbleSoA.h"
+#include "../BubbleParallel.h"
+#include "../BubbleRaster.h"
+#include "../Renderer.h"
+#include "../MonitorLayout.h"
+#include "../WorkPool.h"
+#include "../FrameStats.h"
+
+const int MAX_RUNS = 32;
+
+struct BENCH_OPTIONS {
+    int bubbleCounts[MAX_RUNS];
+    int runs;
+    int width;
+    int height;
+    int frames;
+    int warmup;
+    unsigned int seed;
+    const char* mode;
+    int threads;
+    bool render;
+    bool impulse;
+    float restitution;
+    float gravity;
+    float friction;
+    float damping;
+    bool sleep;
+    bool invariants;
+    bool sprites;
+    const char* dumpPattern;
+    int dumpEvery;
+    MONITOR_LAYOUT layout;
+    int suspendEvery;
+    RADIUS_DISTRIBUTION radiusDistribution;
+    float minRadius;
+    float maxRadius;
+    bool flatGrid;
+    bool checkGrid;
+    bool pairBlocks;
+};
+
+static int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double p)
+{
+    int i = (int) (p * (count - 1) + 0.5);
+    return sorted[i];
+}
+
+static bool parseOptions(int argc, char** argv, BENCH_OPTIONS* opt)
+{
+    opt->bubbleCounts[0] = NUMBER_OF_BUBBLES;
+    opt->runs = 1;
+    opt->width = 1920;
+    opt->height = 1080;
+    opt->frames = 600;
+    opt->warmup = 30;
+    opt->seed = 1;
+    opt->mode = "grid";
+    opt->threads = 0;
+    opt->render = false;
+    opt->impulse = false;
+    opt->restitution = 1;
+    opt->gravity = 0;
+    opt->friction = 1;
+    opt->damping = 1;
+    opt->sleep = false;
+    opt->invariants = false;
+    opt->sprites = false;
+    opt->dumpPattern = NULL;
+    opt->dumpEvery = 60;
+    opt->suspendEvery = 0;
+    opt->radiusDistribution = RADIUS_FIXED;
+    opt->minRadius = 0;
+    opt->maxRadius = 0;
+    opt->flatGrid = false;
+    opt->checkGrid = false;
+    opt->pairBlocks = true;
+    initMonitorLayout(&opt->layout);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return false;
+        }
+        i++;
+
+        if (!strcmp(arg, "--bubbles")) {
+            // comma separated list, one run per count
+            opt->runs = 0;
+            char* end = (char*) value;
+            while (*end && opt->runs < MAX_RUNS) {
+                opt->bubbleCounts[opt->runs++] = strtol(end, &end, 10);
+                if (*end == ',')
+                    end++;
+            }
+        } else if (!strcmp(arg, "--width")) {
+            opt->width = atoi(value);
+        } else if (!strcmp(arg, "--height")) {
+            opt->height = atoi(value);
+        } else if (!strcmp(arg, "--frames")) {
+            opt->frames = atoi(value);
+        } else if (!strcmp(arg, "--warmup")) {
+            opt->warmup = atoi(value);
+        } else if (!strcmp(arg, "--seed")) {
+            opt->seed = strtoul(value, NULL, 10);
+        } else if (!strcmp(arg, "--mode")) {
+            opt->mode = value;
+        } else if (!strcmp(arg, "--threads")) {
+            opt->threads = atoi(value);
+        } else if (!strcmp(arg, "--render")) {
+            opt->render = atoi(value) != 0;
+        } else if (!strcmp(arg, "--impulse")) {
+            opt->impulse = atoi(value) != 0;
+        } else if (!strcmp(arg, "--restitution")) {
+            opt->restitution = (float) atof(value);
+        } else if (!strcmp(arg, "--gravity")) {
+            opt->gravity = (float) atof(value);
+        } else if (!strcmp(arg, "--friction")) {
+            opt->friction = (float) atof(value);
+        } else if (!strcmp(arg, "--damping")) {
+            opt->damping = (float) atof(value);
+        } else if (!strcmp(arg, "--sleep")) {
+            opt->sleep = atoi(value) != 0;
+        } else if (!strcmp(arg, "--invariants")) {
+            opt->invariants = atoi(value) != 0;
+        } else if (!strcmp(arg, "--sprites")) {
+            opt->sprites = atoi(value) != 0;
+        } else if (!strcmp(arg, "--dump")) {
+            opt->dumpPattern = value;
+        } else if (!strcmp(arg, "--dump-every")) {
+            opt->dumpEvery = atoi(value);
+        } else if (!strcmp(arg, "--monitors")) {
+            if (!parseMonitorLayout(&opt->layout, value)) {
+                fprintf(stderr, "bad monitor layout %s\n", value);
+                return false;
+            }
+        } else if (!strcmp(arg, "--suspend")) {
+            opt->suspendEvery = atoi(value);
+        } else if (!strcmp(arg, "--radius-dist")) {
+            if (!parseRadiusDistribution(value, &opt->radiusDistribution)) {
+                fprintf(stderr, "unknown radius distribution %s\n", value);
+                return false;
+            }
+        } else if (!strcmp(arg, "--min-radius")) {
+            opt->minRadius = (float) atof(value);
+        } else if (!strcmp(arg, "--max-radius")) {
+            opt->maxRadius = (float) atof(value);
+        } else if (!strcmp(arg, "--flat-grid")) {
+            opt->flatGrid = atoi(value) != 0;
+        } else if (!strcmp(arg, "--check-grid")) {
+            opt->checkGrid = atoi(value) != 0;
+        } else if (!strcmp(arg, "--pair-blocks")) {
+            opt->pairBlocks = atoi(value) != 0;
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    char path[300];
+    if (opt->dumpPattern && !formatDumpPath(path, sizeof(path), opt->dumpPattern, 0)) {
+        fprintf(stderr, "--dump %s needs exactly one %%d for the frame number and no other conversions\n", opt->dumpPattern);
+        return false;
+    }
+    if (strcmp(opt->mode, "grid") && strcmp(opt->mode, "brute") && strcmp(opt->mode, "soa") && strcmp(opt->mode, "ccd") && strcmp(opt->mode, "parallel")) {
+        fprintf(stderr, "unknown mode %s\n", opt->mode);
+        return false;
+    }
+    if (opt->layout.count > 0) {
+        opt->width = opt->layout.worldWidth;
+        opt->height = opt->layout.worldHeight;
+    } else {
+        DIRTY_RECT whole = { 0, 0, opt->width, opt->height };
+        addLayoutMonitor(&opt->layout, whole);
+    }
+    return opt->frames > 0 && opt->width > 0 && opt->height > 0;
+}
+
+// one physics step in the selected mode
+static void benchStep(const BENCH_OPTIONS* opt, BUBBLE_SOA* soa)
+{
+    if (!strcmp(opt->mode, "soa")) {
+        // integration and walls only, collisions still need the AoS path
+        integrateBubblesSoA(soa, worldWidth, worldHeight, 1);
+    } else if (!strcmp(opt->mode, "brute")) {
+        for (int i = 0; i < numBubbles; i++) {
+            BUBBLE* b = &bubbles[i];
+            b->x += b->xVel;
+            b->y += b->yVel;
+            wallCheck(b);
+            bubbleGridMove(&bubbleGrid, i, b->x, b->y);
+            collisionCheckBruteForce(b);
+        }
+    } else {
+        stepBubbles();
+    }
+}
+
+static FRAME_STATS benchStats;
+
+// one headless renderer per monitor
+struct BENCH_RENDER {
+    int count;
+    FRAME_PIPELINE pipelines[MAX_MONITORS];
+    BUBBLE_SNAPSHOT snap;
+    WORK_POOL pool;
+};
+
+static void initBenchRender(BENCH_RENDER* r, const BENCH_OPTIONS* opt, int capacity, bool dump)
+{
+    const MONITOR_LAYOUT* layout = &opt->layout;
+    r->count = layout->count;
+
+    for (int i = 0; i < layout->count; i++) {
+        DIRTY_RECT v = layout->viewports[i];
+
+        // frame%05d.png -> frame%05d-m1.png
+        char pattern[260] = "";
+        if (dump && opt->dumpPattern) {
+            const char* dot = strrchr(opt->dumpPattern, '.');
+            int stem = dot ? (int) (dot - opt->dumpPattern) : (int) strlen(opt->dumpPattern);
+            if (layout->count > 1)
+                snprintf(pattern, sizeof(pattern), "%.*s-m%d%s", stem, opt->dumpPattern, i, dot ? dot : "");
+            else
+                snprintf(pattern, sizeof(pattern), "%s", opt->dumpPattern);
+        }
+
+        RENDERER renderer = createHeadlessRenderer(v.right - v.left, v.bottom - v.top, colorrefToPixel(0x191919),
+            pattern[0] ? pattern : NULL, opt->dumpEvery);
+        if (!renderer.present) {
+            fprintf(stderr, "couldn't allocate %dx%d framebuffers\n", v.right - v.left, v.bottom - v.top);
+            exit(1);
+        }
+        initFramePipeline(&r->pipelines[i], renderer, NULL, capacity, 0, &benchStats);
+        framePipelineSetOrigin(&r->pipelines[i], v.left, v.top);
+        r->pipelines[i].sprites = opt->sprites;
+    }
+
+    initBubbleSnapshot(&r->snap, capacity);
+    if (r->count > 1)
+        initWorkPool(&r->pool, r->count);
+}
+
+static void freeBenchRender(BENCH_RENDER* r)
+{
+    for (int i = 0; i < r->count; i++)
+        freeFramePipeline(&r->pipelines[i]);
+    freeBubbleSnapshot(&r->snap);
+    if (r->count > 1)
+        freeWorkPool(&r->pool);
+}
+
+static void renderMonitors(void* context, int begin, int end, int worker)
+{
+    BENCH_RENDER* r = (BENCH_RENDER*) context;
+    for (int i = begin; i < end; i++)
+        renderFrame(&r->pipelines[i], &r->snap, 1);
+}
+
+// the same work WM_PAINT does after the physics, on the headless renderers
+static void benchRender(BENCH_RENDER* r)
+{
+    takeBubbleSnapshot(&r->snap, 0, 0);
+    if (r->count > 1)
+        workPoolFor(&r->pool, r->count, 1, renderMonitors, r);
+    else
+        renderFrame(&r->pipelines[0], &r->snap, 1);
+}
+
+// bytes the pipelines hold in the buffers suspending gives back
+static size_t benchRenderBytes(const BENCH_RENDER* r)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < r->count; i++)
+        bytes += framePipelineBytes(&r->pipelines[i]);
+    return bytes;
+}
+
+struct SUSPEND_RESULT {
+    int cycles;
+    size_t activeBytes;
+    size_t suspendedBytes;    // the most any suspension left behind
+    long long maxResumeNanos;
+    long long maxFirstFrameNanos;
+    long long coldFirstFrameNanos; // the run's first frame, on fresh buffers
+};
+
+// the window being minimized and restored, the physics doesn't run in between
+static void benchSuspendCycle(BENCH_RENDER* r, SUSPEND_RESULT* result)
+{
+    size_t active = benchRenderBytes(r);
+    if (active > result->activeBytes)
+        result->activeBytes = active;
+    for (int i = 0; i < r->count; i++)
+        framePipelineSuspend(&r->pipelines[i]);
+    size_t suspended = benchRenderBytes(r);
+    if (suspended > result->suspendedBytes)
+        result->suspendedBytes = suspended;
+
+    // WM_PAINT can still come while minimized, it mustn't touch anything
+    benchRender(r);
+
+    long long start = nowNanos();
+    takeBubbleSnapshot(&r->snap, 0, 0);
+    for (int i = 0; i < r->count; i++) {
+        if (!framePipelineResume(&r->pipelines[i], &r->snap)) {
+            fprintf(stderr, "couldn't resume monitor %d\n", i);
+            exit(1);
+        }
+    }
+    long long resume = nowNanos() - start;
+    if (resume > result->maxResumeNanos)
+        result->maxResumeNanos = resume;
+    result->cycles++;
+}
+
+// largest channel difference between what the monitors show and a fresh
+// render of the whole world, only over the parts some monitor covers
+static int compareViewports(BENCH_RENDER* r, const BENCH_OPTIONS* opt)
+{
+    const MONITOR_LAYOUT* layout = &opt->layout;
+    FRAME_PIPELINE whole;
+    RENDERER renderer = createHeadlessRenderer(layout->worldWidth, layout->worldHeight, colorrefToPixel(0x191919), NULL, 1);
+    if (!renderer.present)
+        return -1;
+    initFramePipeline(&whole, renderer, NULL, r->snap.capacity, 0, NULL);
+    whole.sprites = opt->sprites;
+    renderFrame(&whole, &r->snap, 1);
+
+    const FRAMEBUFFER* reference = headlessScreen(&whole.renderer);
+    int worst = 0;
+    for (int m = 0; m < r->count; m++) {
+        const FRAMEBUFFER* screen = headlessScreen(&r->pipelines[m].renderer);
+        DIRTY_RECT v = layout->viewports[m];
+        for (int y = 0; y < screen->height; y++) {
+            const uint32_t* a = screen->pixels + (size_t) y * screen->stride;
+            const uint32_t* b = reference->pixels + (size_t) (y + v.top) * reference->stride + v.left;
+            for (int x = 0; x < screen->width; x++) {
+                for (int shift = 0; shift < 24; shift += 8) {
+                    int d = abs((int) ((a[x] >> shift) & 0xff) - (int) ((b[x] >> shift) & 0xff));
+                    if (d > worst)
+                        worst = d;
+                }
+            }
+        }
+    }
+
+    freeFramePipeline(&whole);
+    return worst;
+}
+
+static void printStage(const FRAME_STATS* stats, int stage, bool last)
+{
+    printf("\"%s\": {\"p50_us\": %.3f, \"p99_us\": %.3f}%s", frameStageName(stage),
+        frameStatsPercentile(stats, stage, 0.5, false) / 1000.0,
+        frameStatsPercentile(stats, stage, 0.99, false) / 1000.0,
+        last ? "" : ", ");
+}
+
+// FNV-1a over the bubbles' positions and velocities
+static unsigned int bubbleChecksum()
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < numBubbles; i++) {
+        float values[4] = { bubbles[i].x, bubbles[i].y, bubbles[i].xVel, bubbles[i].yVel };
+        const unsigned char* bytes = (const unsigned char*) values;
+        for (int k = 0; k < (int) sizeof(values); k++)
+            hash = (hash ^ bytes[k]) * 16777619u;
+    }
+    return hash;
+}
+
+// kinetic plus gravitational energy, y grows downwards so falling lowers it
+static double totalEnergy()
+{
+    double energy = 0;
+    for (int i = 0; i < numBubbles; i++) {
+        const BUBBLE* b = &bubbles[i];
+        energy += 0.5 * b->mass * ((double) b->xVel * b->xVel + (double) b->yVel * b->yVel);
+        if (b->doGrav)
+            energy -= (double) b->mass * gravity * b->y;
+    }
+    return energy;
+}
+
+static float randomRange(float lo, float hi)
+{
+    return lo + (hi - lo) * (bubbleRandom() % 10000) / 10000.0f;
+}
+
+// random overlapping pairs through resolveImpulse, prints the worst errors
+// and returns false if momentum changed or energy went up beyond float noise
+static bool checkImpulseInvariants(int pairs)
+{
+    double worstMomentum = 0;
+    double worstEnergyGain = 0;
+
+    for (int p = 0; p < pairs; p++) {
+        BUBBLE a = {}, b = {};
+        a.x = randomRange(0, 100);
+        a.y = randomRange(0, 100);
+        a.r = randomRange(1, 50);
+        b.x = a.x + randomRange(-60, 60);
+        b.y = a.y + randomRange(-60, 60);
+        b.r = randomRange(1, 50);
+        a.mass = randomRange(0.1f, 100);
+        b.mass = randomRange(0.1f, 100);
+        a.xVel = randomRange(-20, 20);
+        a.yVel = randomRange(-20, 20);
+        b.xVel = randomRange(-20, 20);
+        b.yVel = randomRange(-20, 20);
+
+        double px = (double) a.mass * a.xVel + (double) b.mass * b.xVel;
+        double py = (double) a.mass * a.yVel + (double) b.mass * b.yVel;
+        double e = 0.5 * a.mass * ((double) a.xVel * a.xVel + (double) a.yVel * a.yVel)
+            + 0.5 * b.mass * ((double) b.xVel * b.xVel + (double) b.yVel * b.yVel);
+
+        resolveImpulse(&a, &b);
+
+        double px2 = (double) a.mass * a.xVel + (double) b.mass * b.xVel;
+        double py2 = (double) a.mass * a.yVel + (double) b.mass * b.yVel;
+        double e2 = 0.5 * a.mass * ((double) a.xVel * a.xVel + (double) a.yVel * a.yVel)
+            + 0.5 * b.mass * ((double) b.xVel * b.xVel + (double) b.yVel * b.yVel);
+
+        // relative to the pair's momentum/energy scale since floats only keep ~7 digits
+        double scale = fabs((double) a.mass * 20) + fabs((double) b.mass * 20);
+        double momentum = (fabs(px2 - px) + fabs(py2 - py)) / scale;
+        double gain = e > 0 ? (e2 - e) / e : 0;
+        if (momentum > worstMomentum)
+            worstMomentum = momentum;
+        if (gain > worstEnergyGain)
+            worstEnergyGain = gain;
+    }
+
+    bool ok = worstMomentum < 1e-5 && worstEnergyGain < 1e-5;
+    printf("  \"invariants\": {\"pairs\": %d, \"restitution\": %g, \"max_momentum_error\": %g, \"max_energy_gain\": %g, \"ok\": %s},\n",
+        pairs, restitution, worstMomentum, worstEnergyGain, ok ? "true" : "false");
+    return ok;
+}
+
+// overlapping pairs the grid query from either bubble doesn't return
+static long long gridMissedPairs()
+{
+    int* candidates = (int*) malloc(sizeof(int) * numBubbles);
+    long long missed = 0;
+
+    for (int i = 0; i < numBubbles; i++) {
+        const BUBBLE* a = &bubbles[i];
+        int found = bubbleGridQuery(&bubbleGrid, a->x, a->y, a->r, candidates);
+        int c = 0;
+        for (int j = i + 1; j < numBubbles; j++) {
+            const BUBBLE* b = &bubbles[j];
+            float dx = a->x - b->x;
+            float dy = a->y - b->y;
+            float reach = a->r + b->r;
+            if (dx * dx + dy * dy >= reach * reach)
+                continue;
+
+            // candidates come back sorted
+            while (c < found && candidates[c] < j)
+                c++;
+            if (c == found || candidates[c] != j)
+                missed++;
+        }
+    }
+
+    free(candidates);
+    return missed;
+}
+
+static bool runBench(const BENCH_OPTIONS* opt, int count, bool last)
+{
+    bool ok = true;
+    worldWidth = opt->width;
+    worldHeight = opt->height;
+    BUBBLE_RADIUS = scaledBubbleRadius(opt->width, opt->height, count);
+    radiusDistribution = opt->radiusDistribution;
+    minBubbleRadius = opt->minRadius > 0 ? opt->minRadius : BUBBLE_RADIUS / 10.0f;
+    maxBubbleRadius = opt->maxRadius > 0 ? opt->maxRadius : BUBBLE_RADIUS * 10.0f;
+    float largest = (opt->width < opt->height ? opt->width : opt->height) / 4.0f;
+    if (opt->maxRadius <= 0 && maxBubbleRadius > largest)
+        maxBubbleRadius = largest;
+    if (minBubbleRadius < 1)
+        minBubbleRadius = 1;
+    hierarchicalGrid = !opt->flatGrid;
+
+    seedBubbleRandom(opt->seed);
+    if (!allocateBubbles(count)) {
+        fprintf(stderr, "out of memory for %d bubbles\n", count);
+        exit(1);
+    }
+    initializeBubbles(count);
+    continuousCollision = !strcmp(opt->mode, "ccd");
+    parallelCollision = !strcmp(opt->mode, "parallel") && initParallelPhysics(opt->threads);
+    double startEnergy = totalEnergy();
+
+    BUBBLE_SOA soa = {};
+    if (!strcmp(opt->mode, "soa")) {
+        initBubbleSoA(&soa, count);
+        bubblesToSoA(bubbles, count, &soa);
+    }
+
+    static BENCH_RENDER render;
+    if (opt->render)
+        initBenchRender(&render, opt, count, last);
+
+    SUSPEND_RESULT suspend = {};
+    for (int i = 0; i < opt->warmup; i++) {
+        benchStep(opt, &soa);
+        if (opt->render) {
+            long long start = nowNanos();
+            benchRender(&render);
+            if (i == 0)
+                suspend.coldFirstFrameNanos = nowNanos() - start;
+        }
+    }
+
+    double* stepNanos = (double*) malloc(sizeof(double) * opt->frames);
+    collisionPairsTested = 0;
+    initFrameStats(&benchStats);
+
+    double total = 0;
+    bool suspending = opt->render && opt->suspendEvery > 0;
+    for (int i = 0; i < opt->frames; i++) {
+        bool resumed = suspending && i > 0 && i % opt->suspendEvery == 0;
+        if (resumed)
+            benchSuspendCycle(&render, &suspend);
+
+        long long t0 = nowNanos();
+        benchStep(opt, &soa);
+        stepNanos[i] = nowNanos() - t0;
+        total += stepNanos[i];
+        frameStatsRecord(&benchStats, STAGE_PHYSICS, (long long) stepNanos[i]);
+
+        if (opt->render) {
+            long long start = nowNanos();
+            benchRender(&render);
+            long long frame = nowNanos() - start;
+            if (resumed && frame > suspend.maxFirstFrameNanos)
+                suspend.maxFirstFrameNanos = frame;
+        }
+        frameStatsEndFrame(&benchStats);
+    }
+
+    qsort(stepNanos, opt->frames, sizeof(double), compareDoubles);
+
+    printf("    {\"mode\": \"%s\", \"bubbles\": %d, \"width\": %d, \"height\": %d, \"radius\": %d, \"frames\": %d, ",
+        opt->mode, count, opt->width, opt->height, BUBBLE_RADIUS, opt->frames);
+    if (radiusDistribution != RADIUS_FIXED)
+        printf("\"radius_dist\": \"%s\", \"min_radius\": %g, \"max_radius\": %g, ",
+            radiusDistributionName(radiusDistribution), minBubbleRadius, maxBubbleRadius);
+    printf("\"grid_levels\": %d, ", bubbleGrid.numLevels);
+    if (!strcmp(opt->mode, "soa"))
+        printf("\"kernel\": \"%s\", ", bubbleSoAKernelName());
+    if (parallelCollision)
+        printf("\"threads\": %d, \"contacts\": %d, \"colors\": %d, ", opt->threads, parallelContacts, parallelColors);
+    printf("\"ns_per_bubble_step\": %.3f, \"pairs_tested\": %lld, \"pairs_tested_per_step\": %.1f, ",
+        total / opt->frames / count, collisionPairsTested, (double) collisionPairsTested / opt->frames);
+    printf("\"p50_step_us\": %.3f, \"p99_step_us\": %.3f, \"max_step_us\": %.3f",
+        percentile(stepNanos, opt->frames, 0.5) / 1000,
+        percentile(stepNanos, opt->frames, 0.99) / 1000,
+        stepNanos[opt->frames - 1] / 1000);
+    double endEnergy = totalEnergy();
+    printf(", \"energy_ratio\": %.6f", startEnergy != 0 ? endEnergy / startEnergy : 1.0);
+    if (sleepEnabled)
+        printf(", \"sleeping\": %d", countSleepingBubbles());
+    printf(", \"checksum\": \"%08x\"", bubbleChecksum());
+    if (opt->checkGrid) {
+        long long missed = gridMissedPairs();
+        printf(", \"missed_pairs\": %lld", missed);
+        ok = ok && missed == 0;
+    }
+
+    if (opt->render) {
+        if (opt->sprites)
+            printf(", \"sprite_kernel\": \"%s\"", spriteKernelName());
+        printf(", \"stages\": {");
+        printStage(&benchStats, STAGE_PHYSICS, false);
+        printStage(&benchStats, STAGE_BACKGROUND, false);
+        printStage(&benchStats, STAGE_RASTERIZE, false);
+        printStage(&benchStats, STAGE_PRESENT, true);
+        printf("}");
+        if (render.count > 1 || suspending) {
+            int diff = compareViewports(&render, opt);
+            printf(", \"monitors\": %d, \"gap_pixels\": %lld, \"viewport_max_diff\": %d",
+                render.count, layoutGapPixels(&opt->layout), diff);
+            ok = ok && diff == 0;
+        }
+        if (suspending) {
+            printf(", \"suspend\": {\"cycles\": %d, \"active_bytes\": %zu, \"suspended_bytes\": %zu, "
+                "\"max_resume_us\": %.3f, \"max_first_frame_us\": %.3f, \"cold_first_frame_us\": %.3f}",
+                suspend.cycles, suspend.activeBytes, suspend.suspendedBytes, suspend.maxResumeNanos / 1000.0,
+                suspend.maxFirstFrameNanos / 1000.0, suspend.coldFirstFrameNanos / 1000.0);
+            ok = ok && suspend.suspendedBytes == 0;
+        }
+        freeBenchRender(&render);
+    }
+    printf("}%s\n", last ? "" : ",");
+
+    free(stepNanos);
+    freeBubbleSoA(&soa);
+    if (parallelCollision)
+        freeParallelPhysics();
+    parallelCollision = false;
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    BENCH_OPTIONS opt;
+    if (!parseOptions(argc, argv, &opt))
+        return 1;
+
+    impulseResponse = opt.impulse;
+    restitution = opt.restitution;
+    gravity = opt.gravity;
+    friction = opt.friction;
+    damping = opt.damping;
+    sleepEnabled = opt.sleep;
+    batchedPairTests = opt.pairBlocks;
+
+    printf("{\n");
+    bool ok = true;
+    if (opt.invariants) {
+        seedBubbleRandom(opt.seed);
+        ok = checkImpulseInvariants(100000);
+    }
+
+    printf("  \"results\": [\n");
+    for (int i = 0; i < opt.runs; i++) {
+        ok = runBench(&opt, opt.bubbleCounts[i], i == opt.runs - 1) && ok;
+        fflush(stdout);
+    }
+    printf("  ]\n}\n");
+    return ok ? 0 : 1;
+}
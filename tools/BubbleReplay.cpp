@@ -0,0 +1,277 @@
+// records and replays bubble simulations headlessly
+//
+// usage: BubbleReplay record out.hpbr [--bubbles 1000] [--width 1920] [--height 1080]
+//                    [--steps 600] [--seed 1] [--mode grid|ccd|parallel] [--threads N]
+//                    [--impulse 1] [--restitution 1] [--gravity 0]
+//                    [--friction 1] [--damping 1] [--sleep 1]
+//                    [--radius-dist fixed|uniform|power-law|bimodal] [--min-radius 0] [--max-radius 0]
+//        BubbleReplay play in.hpbr [--threads N] [--tolerance 0] [--resync 1]
+//        BubbleReplay compat scratch.hpbr [--bubbles 1000] [--steps 600] [--mode grid|ccd|parallel] ...
+//
+// play runs the recording's starting state through stepBubbles and compares
+// every frame against the file. it stops at the first frame that is off by
+// more than --tolerance, or with --resync 1 reports it, carries on from the
+// recorded state and counts how many frames diverged. the results (including
+// the time spent stepping) are printed as JSON, so a recording doubles as a
+// fixed benchmark workload. exits with 1 if anything diverged
+//
+// compat records a run with the header of every version from
+// REPLAY_OLDEST_VERSION up (overwriting scratch.hpbr each time) and plays each
+// one back, to check old recordings still play. the physics options are left
+// at their defaults, which is all the oldest header can describe. exits with 1
+// if any version didn't play or diverged
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../BubblePhysics.h"
+#include "../BubbleParallel.h"
+#include "../BubbleReplay.h"
+#include "../FrameStats.h"
+
+struct REPLAY_OPTIONS {
+    const char* command;
+    const char* path;
+    int bubbles;
+    int width;
+    int height;
+    int steps;
+    unsigned int seed;
+    const char* mode;
+    int threads;
+    float tolerance;
+    bool resync;
+    bool impulse;
+    float restitution;
+    float gravity;
+    float friction;
+    float damping;
+    bool sleep;
+    RADIUS_DISTRIBUTION radiusDistribution;
+    float minRadius;
+    float maxRadius;
+};
+
+static bool parseOptions(int argc, char** argv, REPLAY_OPTIONS* opt)
+{
+    if (argc < 3)
+        return false;
+
+    opt->command = argv[1];
+    opt->path = argv[2];
+    opt->bubbles = 1000;
+    opt->width = 1920;
+    opt->height = 1080;
+    opt->steps = 600;
+    opt->seed = 1;
+    opt->mode = "grid";
+    opt->threads = 0;
+    opt->tolerance = 0;
+    opt->resync = false;
+    opt->impulse = false;
+    opt->restitution = 1;
+    opt->gravity = 0;
+    opt->friction = 1;
+    opt->damping = 1;
+    opt->sleep = false;
+    opt->radiusDistribution = RADIUS_FIXED;
+    opt->minRadius = 0;
+    opt->maxRadius = 0;
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+
+        if (!strcmp(arg, "--bubbles")) {
+            opt->bubbles = atoi(value);
+        } else if (!strcmp(arg, "--width")) {
+            opt->width = atoi(value);
+        } else if (!strcmp(arg, "--height")) {
+            opt->height = atoi(value);
+        } else if (!strcmp(arg, "--steps")) {
+            opt->steps = atoi(value);
+        } else if (!strcmp(arg, "--seed")) {
+            opt->seed = strtoul(value, NULL, 10);
+        } else if (!strcmp(arg, "--mode")) {
+            opt->mode = value;
+        } else if (!strcmp(arg, "--threads")) {
+            opt->threads = atoi(value);
+        } else if (!strcmp(arg, "--tolerance")) {
+            opt->tolerance = (float) atof(value);
+        } else if (!strcmp(arg, "--resync")) {
+            opt->resync = atoi(value) != 0;
+        } else if (!strcmp(arg, "--impulse")) {
+            opt->impulse = atoi(value) != 0;
+        } else if (!strcmp(arg, "--restitution")) {
+            opt->restitution = (float) atof(value);
+        } else if (!strcmp(arg, "--gravity")) {
+            opt->gravity = (float) atof(value);
+        } else if (!strcmp(arg, "--friction")) {
+            opt->friction = (float) atof(value);
+        } else if (!strcmp(arg, "--damping")) {
+            opt->damping = (float) atof(value);
+        } else if (!strcmp(arg, "--sleep")) {
+            opt->sleep = atoi(value) != 0;
+        } else if (!strcmp(arg, "--radius-dist")) {
+            if (!parseRadiusDistribution(value, &opt->radiusDistribution)) {
+                fprintf(stderr, "unknown radius distribution %s\n", value);
+                return false;
+            }
+        } else if (!strcmp(arg, "--min-radius")) {
+            opt->minRadius = (float) atof(value);
+        } else if (!strcmp(arg, "--max-radius")) {
+            opt->maxRadius = (float) atof(value);
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    return opt->bubbles > 0 && opt->width > 0 && opt->height > 0;
+}
+
+static int record(const REPLAY_OPTIONS* opt, int version)
+{
+    worldWidth = opt->width;
+    worldHeight = opt->height;
+    BUBBLE_RADIUS = scaledBubbleRadius(opt->width, opt->height, opt->bubbles);
+    radiusDistribution = opt->radiusDistribution;
+    minBubbleRadius = opt->minRadius > 0 ? opt->minRadius : BUBBLE_RADIUS / 10.0f;
+    maxBubbleRadius = opt->maxRadius > 0 ? opt->maxRadius : BUBBLE_RADIUS * 10.0f;
+    if (minBubbleRadius < 1)
+        minBubbleRadius = 1;
+
+    seedBubbleRandom(opt->seed);
+    if (!allocateBubbles(opt->bubbles)) {
+        fprintf(stderr, "out of memory for %d bubbles\n", opt->bubbles);
+        return 2;
+    }
+    initializeBubbles(opt->bubbles);
+    continuousCollision = !strcmp(opt->mode, "ccd");
+    impulseResponse = opt->impulse;
+    restitution = opt->restitution;
+    gravity = opt->gravity;
+    friction = opt->friction;
+    damping = opt->damping;
+    sleepEnabled = opt->sleep;
+    parallelCollision = !strcmp(opt->mode, "parallel") && initParallelPhysics(opt->threads);
+
+    REPLAY_RECORDER recorder;
+    if (!openReplayRecorderVersion(&recorder, opt->path, opt->seed, version)) {
+        fprintf(stderr, "can't write %s\n", opt->path);
+        return 2;
+    }
+
+    for (int step = 1; step <= opt->steps; step++) {
+        stepBubbles();
+        replayRecordFrame(&recorder, step);
+    }
+
+    long size = ftell(recorder.file);
+    closeReplayRecorder(&recorder);
+
+    printf("{\"recorded\": \"%s\", \"bubbles\": %d, \"steps\": %d, \"bytes\": %ld, \"bytes_per_bubble_step\": %.2f}\n",
+        opt->path, opt->bubbles, opt->steps, size, (double) size / opt->steps / opt->bubbles);
+    return 0;
+}
+
+static int play(const REPLAY_OPTIONS* opt)
+{
+    REPLAY_PLAYER player;
+    if (!openReplayPlayer(&player, opt->path)) {
+        fprintf(stderr, "can't read %s\n", opt->path);
+        return 2;
+    }
+    if (player.header.flags & REPLAY_PARALLEL_COLLISION)
+        parallelCollision = initParallelPhysics(opt->threads);
+
+    long long stepNanos = 0;
+    long long divergedFrames = 0;
+    long long firstDivergence = -1;
+    int firstBubble = -1;
+    float maxError = 0;
+
+    int steps;
+    while (replayReadFrame(&player, &steps)) {
+        long long start = nowNanos();
+        for (int s = 0; s < steps; s++)
+            stepBubbles();
+        stepNanos += nowNanos() - start;
+
+        int worst;
+        float error = replayCompare(&player, &worst);
+        if (error >= 0 && error <= opt->tolerance)
+            continue;
+
+        divergedFrames++;
+        if (firstDivergence < 0) {
+            firstDivergence = player.step;
+            firstBubble = worst;
+        }
+        if (error < 0 || error > maxError)
+            maxError = error < 0 ? INFINITY : error;
+
+        if (!opt->resync)
+            break;
+        replayAdopt(&player);
+    }
+
+    printf("{\"replayed\": \"%s\", \"version\": %d, \"bubbles\": %d, \"frames\": %lld, \"steps\": %lld, \"ns_per_step\": %.1f, ",
+        opt->path, player.header.version, player.header.count, player.frames, player.step,
+        player.step ? (double) stepNanos / player.step : 0.0);
+    printf("\"diverged_frames\": %lld, \"first_divergence_step\": %lld, \"first_divergence_bubble\": %d, \"max_error\": %g}\n",
+        divergedFrames, firstDivergence, firstBubble, maxError);
+
+    closeReplayPlayer(&player);
+    if (parallelCollision)
+        freeParallelPhysics();
+    parallelCollision = false;
+    return divergedFrames ? 1 : 0;
+}
+
+static int compat(const REPLAY_OPTIONS* opt)
+{
+    REPLAY_OPTIONS old = *opt;
+    old.impulse = false;
+    old.restitution = 1;
+    old.gravity = 0;
+    old.friction = 1;
+    old.damping = 1;
+    old.sleep = false;
+    old.radiusDistribution = RADIUS_FIXED;
+
+    int result = 0;
+    for (int version = REPLAY_OLDEST_VERSION; version <= REPLAY_VERSION; version++) {
+        if (record(&old, version) != 0)
+            return 2;
+        if (parallelCollision)
+            freeParallelPhysics();
+        parallelCollision = false;
+
+        int played = play(&old);
+        if (played > result)
+            result = played;
+    }
+    return result ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    REPLAY_OPTIONS opt;
+    if (!parseOptions(argc, argv, &opt)) {
+        fprintf(stderr, "usage: BubbleReplay record|play file [options]\n");
+        return 2;
+    }
+
+    if (!strcmp(opt.command, "record"))
+        return record(&opt, REPLAY_VERSION);
+    if (!strcmp(opt.command, "play"))
+        return play(&opt);
+    if (!strcmp(opt.command, "compat"))
+        return compat(&opt);
+
+    fprintf(stderr, "unknown command %s\n", opt.command);
+    return 2;
+}
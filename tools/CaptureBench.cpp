@@ -0,0 +1,72 @@
+// headless benchmark for the desktop capture cache
+// stands a synthetic or PPM file source in for the GDI desktop grab and
+// reports how often it was grabbed vs reused and what that cost, as JSON
+//
+// usage: CaptureBench [--source synthetic|file.ppm] [--width 1920] [--height 1080]
+//                     [--frames 600] [--interval 15] [--change-every 0]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../CaptureSource.h"
+#include "../FrameStats.h"
+
+int main(int argc, char** argv)
+{
+    const char* sourceName = "synthetic";
+    int width = 1920;
+    int height = 1080;
+    int frames = 600;
+    int interval = 15;
+    int changeEvery = 0; // simulate a window event every N frames, 0 for none
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--source")) sourceName = argv[i + 1];
+        else if (!strcmp(argv[i], "--width")) width = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--height")) height = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--frames")) frames = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--interval")) interval = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--change-every")) changeEvery = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    CAPTURE_SOURCE source = strcmp(sourceName, "synthetic") ? createFileCapture(sourceName) : createSyntheticCapture();
+    if (!source.grab) {
+        fprintf(stderr, "couldn't load %s\n", sourceName);
+        return 1;
+    }
+
+    FRAMEBUFFER fb;
+    fb.width = width;
+    fb.height = height;
+    fb.stride = width;
+    fb.pixels = (uint32_t*) malloc(sizeof(uint32_t) * width * height);
+
+    CAPTURE_CACHE cache;
+    initCaptureCache(&cache, source, interval);
+
+    long long grabNanos = 0;
+    long long start = nowNanos();
+    for (int i = 0; i < frames; i++) {
+        if (changeEvery > 0 && i % changeEvery == changeEvery - 1)
+            captureInvalidate(&cache);
+
+        long long t0 = nowNanos();
+        if (captureFrame(&cache, &fb))
+            grabNanos += nowNanos() - t0;
+    }
+    double total = nowNanos() - start;
+
+    printf("{\"source\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %d, \"interval\": %d, \"change_every\": %d, ",
+        sourceName, width, height, frames, interval, changeEvery);
+    printf("\"grabs\": %lld, \"reuses\": %lld, \"avg_frame_us\": %.3f, \"avg_grab_us\": %.3f}\n",
+        cache.grabs, cache.reuses, total / frames / 1000, cache.grabs ? (double) grabNanos / cache.grabs / 1000 : 0.0);
+
+    freeCaptureCache(&cache);
+    free(fb.pixels);
+    return 0;
+}
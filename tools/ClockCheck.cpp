@@ -0,0 +1,133 @@
+// headless check that the fixed timestep makes the bubbles' paths independent
+// of the frame rate
+// the same seeded scene is run through SimClock with several sequences of frame
+// times (steady 30, 60 and 144 fps, a frame every few steps, random jitter,
+// stalls under SIM_MAX_FRAME_TIME) that all add up to the same real time.
+// every physics step's bubbles are hashed, and every sequence has to produce
+// the same hash at every step as the first one, and about the same number of
+// steps. simClockAlpha has to stay within 0 - 1
+//
+// usage: ClockCheck [--bubbles 500] [--seconds 20] [--seed 1]
+//
+// prints a line of JSON per sequence and exits with 1 on any mismatch
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../SimClock.h"
+#include "../BubblePhysics.h"
+
+static unsigned int hashBubbles()
+{
+    // FNV-1a over the whole state
+    unsigned int h = 2166136261u;
+    const unsigned char* p = (const unsigned char*) bubbles;
+    for (size_t i = 0; i < sizeof(BUBBLE) * numBubbles; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+enum SEQUENCE { STEADY_30, STEADY_60, STEADY_144, SLOW_10, JITTER, STALLS, NUM_SEQUENCES };
+static const char* sequenceNames[] = { "30fps", "60fps", "144fps", "10fps", "jitter", "stalls" };
+
+static unsigned int jitterState;
+
+static double frameTime(SEQUENCE s, long long frame)
+{
+    switch (s) {
+    case STEADY_30: return 1.0 / 30;
+    case STEADY_60: return 1.0 / 60;
+    case STEADY_144: return 1.0 / 144;
+    case SLOW_10: return 1.0 / 10;
+    case JITTER:
+        // 2 - 50 ms
+        jitterState = jitterState * 1664525u + 1013904223u;
+        return 0.002 + (jitterState >> 8) / 16777216.0 * 0.048;
+    default:
+        return frame % 50 == 49 ? 0.2 : 1.0 / 60;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int count = 500;
+    double seconds = 20;
+    unsigned int seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--bubbles")) count = atoi(value);
+        else if (!strcmp(argv[i], "--seconds")) seconds = atof(value);
+        else if (!strcmp(argv[i], "--seed")) seed = (unsigned int) strtoul(value, NULL, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (count < 1 || seconds <= 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    worldWidth = 1280;
+    worldHeight = 720;
+    BUBBLE_RADIUS = scaledBubbleRadius(worldWidth, worldHeight, count);
+    if (!allocateBubbles(count)) {
+        fprintf(stderr, "out of memory for %d bubbles\n", count);
+        return 1;
+    }
+
+    int maxSteps = (int) (seconds / SIM_DT) + 2;
+    unsigned int* reference = (unsigned int*) malloc(sizeof(unsigned int) * maxSteps);
+    int referenceSteps = 0;
+    bool ok = true;
+
+    for (int s = 0; s < NUM_SEQUENCES; s++) {
+        seedBubbleRandom(seed);
+        initializeBubbles(count);
+        jitterState = seed;
+
+        SIM_CLOCK clock;
+        initSimClock(&clock, SIM_DT);
+        int steps = 0;
+        int firstMismatch = -1;
+        bool alphaOk = true;
+        double elapsed = 0;
+
+        for (long long frame = 0; elapsed < seconds; frame++) {
+            double dt = frameTime((SEQUENCE) s, frame);
+            if (elapsed + dt > seconds)
+                dt = seconds - elapsed;
+            elapsed += dt;
+
+            int due = simClockAdvance(&clock, dt);
+            for (int i = 0; i < due && steps < maxSteps; i++) {
+                stepBubbles();
+                unsigned int h = hashBubbles();
+                if (s == 0)
+                    reference[steps] = h;
+                else if (steps < referenceSteps && h != reference[steps] && firstMismatch < 0)
+                    firstMismatch = steps;
+                steps++;
+            }
+
+            float alpha = simClockAlpha(&clock);
+            if (alpha < 0 || alpha > 1)
+                alphaOk = false;
+        }
+        if (s == 0)
+            referenceSteps = steps;
+
+        // adding frame times up in a different order can put the last step either side of the end
+        bool stepsOk = abs(steps - referenceSteps) <= 1;
+        printf("{\"frames\": \"%s\", \"seconds\": %g, \"steps\": %d, \"first_mismatch\": %d, \"alpha_ok\": %s}\n",
+            sequenceNames[s], seconds, steps, firstMismatch, alphaOk ? "true" : "false");
+        ok = ok && firstMismatch < 0 && alphaOk && stepsOk;
+    }
+
+    free(reference);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// headless benchmark for the live config (CONFIG_STORE in Config.h)
+// a reader thread stands in for the frame loop and takes a snapshot as fast
+// as it can while the main thread keeps rewriting the config file and
+// reloading it, then prints as JSON what a snapshot and a reload cost
+//
+// usage: ConfigBench [--reloads 200] [--edit-ms 1] [--path ConfigBench.cfg]
+//
+// every version of the file sets bubbles = n, max_bubbles = 2n and
+// background_color = n (written as 0x hex), so a reader that ever saw a half
+// built snapshot finds them out of step (torn_reads). the bench runs with "--damping 0.5" on
+// its command line, which has to win over the file's damping = 0.9 in every
+// snapshot (lost_overrides). rewriting the file with the same contents, or
+// deleting it, must not publish anything (spurious_reloads). the reader goes
+// by generation, which must only ever go up (generations_backwards), and a
+// snapshot held across several reloads must come out of them byte for byte
+// the same (held_rewritten). it exits with 1 if any of those aren't 0 or a
+// reload was missed. --edit-ms is the pause
+// between edits, the saver's watcher waits 50 ms after every change
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../Config.h"
+#include "../FrameStats.h"
+
+const int HELD_RELOADS = 8;
+
+struct READER {
+    CONFIG_STORE* store;
+    volatile bool stop;
+    long long reads;
+    long long tornReads;
+    long long lostOverrides;
+    long long snapshotsSeen; // times the generation changed
+    long long generationsBackwards;
+    long long nanos;
+};
+
+static void* readerLoop(void* arg)
+{
+    READER* r = (READER*) arg;
+    long long last = -1;
+    long long start = nowNanos();
+
+    while (!r->stop) {
+        const CONFIG* config = configSnapshot(r->store);
+        if (config->generation != last) {
+            r->generationsBackwards += config->generation < last;
+            r->snapshotsSeen++;
+            last = config->generation;
+        }
+        if (config->maxBubbles != 2 * config->bubbles || config->backgroundColor != (unsigned int) config->bubbles)
+            r->tornReads++;
+        if (config->damping != 0.5f)
+            r->lostOverrides++;
+        r->reads++;
+    }
+
+    r->nanos = nowNanos() - start;
+    return NULL;
+}
+
+static bool writeConfig(const char* path, int n)
+{
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f, "# written by ConfigBench\nbubbles = %d\nmax_bubbles = %d\nbackground_color = 0x%06x\ndamping = 0.9\n", n, 2 * n, n);
+    return fclose(f) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    int reloads = 200;
+    double editMs = 1;
+    const char* path = "ConfigBench.cfg";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--reloads")) reloads = atoi(value);
+        else if (!strcmp(argv[i], "--edit-ms")) editMs = atof(value);
+        else if (!strcmp(argv[i], "--path")) path = value;
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (reloads < 1 || editMs < 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    if (!writeConfig(path, 1)) {
+        fprintf(stderr, "can't write %s\n", path);
+        return 1;
+    }
+
+    // what the saver would get from its command line
+    char* storeArgv[] = { argv[0], (char*) "--config", (char*) path, (char*) "--damping", (char*) "0.5" };
+    static CONFIG_STORE store;
+    initConfigStore(&store, 5, storeArgv);
+
+    READER reader = {};
+    reader.store = &store;
+    pthread_t thread;
+    pthread_create(&thread, NULL, readerLoop, &reader);
+
+    long long spurious = 0;
+    long long missed = 0;
+    long long reloadNanos = 0;
+    long long reloadMax = 0;
+
+    for (int n = 2; n < reloads + 2; n++) {
+        writeConfig(path, n);
+
+        long long start = nowNanos();
+        bool reloaded = configReload(&store);
+        long long took = nowNanos() - start;
+        reloadNanos += took;
+        if (took > reloadMax)
+            reloadMax = took;
+        if (!reloaded || configSnapshot(&store)->bubbles != n)
+            missed++;
+
+        // the same contents again is no change
+        writeConfig(path, n);
+        spurious += configReload(&store);
+
+        usleep((useconds_t) (editMs * 1000));
+    }
+
+    reader.stop = true;
+    pthread_join(thread, NULL);
+
+    long long published = store.reloads;
+
+    // a reader holding on to a snapshot (the saver's main thread through a long
+    // frame) while the file is saved a few times over
+    const CONFIG* held = configSnapshot(&store);
+    CONFIG heldCopy;
+    memcpy(&heldCopy, held, sizeof(CONFIG));
+    for (int i = 0; i < HELD_RELOADS; i++) {
+        writeConfig(path, reloads + 2 + i);
+        configReload(&store);
+    }
+    bool heldRewritten = memcmp(&heldCopy, held, sizeof(CONFIG)) != 0;
+
+    // a file that went away keeps the current settings
+    remove(path);
+    const CONFIG* before = configSnapshot(&store);
+    spurious += configReload(&store);
+    spurious += configSnapshot(&store) != before;
+
+    printf("{\n  \"reloads\": %lld, \"edit_ms\": %g,\n", published, editMs);
+    printf("  \"reload_us\": %.2f, \"reload_max_us\": %.2f,\n", reloadNanos / 1e3 / reloads, reloadMax / 1e3);
+    printf("  \"reads\": %lld, \"ns_per_read\": %.2f, \"snapshots_seen\": %lld,\n",
+        reader.reads, reader.reads ? (double) reader.nanos / reader.reads : 0.0, reader.snapshotsSeen);
+    printf("  \"torn_reads\": %lld, \"lost_overrides\": %lld, \"spurious_reloads\": %lld, \"missed_reloads\": %lld,\n",
+        reader.tornReads, reader.lostOverrides, spurious, missed);
+    printf("  \"generations_backwards\": %lld, \"held_rewritten\": %s\n}\n",
+        reader.generationsBackwards, heldRewritten ? "true" : "false");
+
+    bool ok = reader.tornReads == 0 && reader.lostOverrides == 0 && spurious == 0 && missed == 0
+        && reader.generationsBackwards == 0 && !heldRewritten;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,491 @@
+// headless benchmark for the desktop field (BackgroundField.h)
+// builds the field from an image file, or from a made up desktop (a wallpaper
+// gradient with a few windows full of text lines and a taskbar), with each
+// scan kernel this cpu has, times scanning, rebuilding and the contact query,
+// then runs the bubbles with and without bouncing off it and prints it all
+// as JSON
+//
+// usage: FieldBench [--image desktop.ppm] [--width 1920] [--height 1080]
+//                   [--mode edges|bright] [--edge-threshold 48] [--bright-threshold 224]
+//                   [--bubbles 200] [--steps 600] [--reps 20] [--seed 1] [--dump field.png]
+//
+// --dump writes the field over the picture: solid cells red, the rest their
+// mean luminance
+//
+// checks, exiting with 1 if any fails:
+//   every kernel gives every cell the same luminance
+//   scanning the same picture again changes no cell and rebuilds nothing
+//   moving a window and scanning only the rect it covered before and after
+//   gives exactly the field a scan of the whole new picture gives
+//   scanning the picture as two frames (monitors) split on the cell grid
+//   gives the same field as one, and split off it still scans every cell once
+//   the contact query's totals match adding up the cells one by one
+//   grabbing the picture through the frame pipeline the way the saver does
+//   (background colour ANDed in) gives the field of the picture itself, and
+//   the background comes out masked. with the field off nothing is scanned
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../BackgroundField.h"
+#include "../ImageFile.h"
+#include "../FrameStats.h"
+#include "../Renderer.h"
+
+const int MAX_KERNELS = 3;
+const int WINDOW_MOVE = 40; // pixels the window moves for the incremental check
+const uint32_t SAVER_BACKGROUND = 0x191919; // the saver's default background_color
+
+struct FIELD_OPTIONS {
+    const char* image;
+    int width;
+    int height;
+    FIELD_MODE mode;
+    int edgeThreshold;
+    int brightThreshold;
+    int bubbles;
+    int steps;
+    int reps;
+    unsigned int seed;
+    const char* dump;
+};
+
+static bool allocFramebuffer(FRAMEBUFFER* fb, int width, int height)
+{
+    fb->width = width;
+    fb->height = height;
+    fb->stride = width;
+    fb->pixels = (uint32_t*) malloc(sizeof(uint32_t) * width * height);
+    return fb->pixels != NULL;
+}
+
+static void fillBox(FRAMEBUFFER* fb, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    DIRTY_RECT rect = { x0 < 0 ? 0 : x0, y0 < 0 ? 0 : y0, x1 > fb->width ? fb->width : x1, y1 > fb->height ? fb->height : y1 };
+    if (rect.left < rect.right && rect.top < rect.bottom)
+        fillRect(fb, rect, color);
+}
+
+// light window with a title bar and lines of "text"
+static void drawWindow(FRAMEBUFFER* fb, DIRTY_RECT w)
+{
+    fillBox(fb, w.left, w.top, w.right, w.bottom, 0xf0f0f0);
+    fillBox(fb, w.left, w.top, w.right, w.top + 30, 0x2b579a);
+    int line = 0;
+    for (int y = w.top + 44; y + 8 < w.bottom - 10; y += 18, line++)
+        fillBox(fb, w.left + 12, y, w.left + 12 + (w.right - w.left - 24) * (5 + line * 7 % 5) / 10, y + 8, 0x404040);
+}
+
+static void drawWallpaper(FRAMEBUFFER* fb)
+{
+    for (int y = 0; y < fb->height; y++) {
+        uint32_t* row = fb->pixels + (size_t) y * fb->stride;
+        for (int x = 0; x < fb->width; x++)
+            row[x] = ((uint32_t) (20 + 30 * y / fb->height) << 8) | (uint32_t) (60 + 60 * x / fb->width);
+    }
+}
+
+static DIRTY_RECT windowAt(int x, int y, int w, int h)
+{
+    DIRTY_RECT rect = { x, y, x + w, y + h };
+    return rect;
+}
+
+// the made up desktop, with the moving window (the last one) shifted by dx
+static void drawDesktop(FRAMEBUFFER* fb, int dx)
+{
+    int w = fb->width;
+    int h = fb->height;
+    drawWallpaper(fb);
+    drawWindow(fb, windowAt(w / 10, h / 8, w * 4 / 10, h / 2));
+    drawWindow(fb, windowAt(w * 6 / 10, h / 5, w * 3 / 10, h * 6 / 10));
+    fillBox(fb, 0, h - 40, w, h, 0x202020);
+    drawWindow(fb, windowAt(w / 3 + dx, h / 2, w / 4, h / 4));
+}
+
+static DIRTY_RECT movingWindow(const FRAMEBUFFER* fb, int dx)
+{
+    return windowAt(fb->width / 3 + dx, fb->height / 2, fb->width / 4, fb->height / 4);
+}
+
+static DIRTY_RECT wholeFrame(const FRAMEBUFFER* fb)
+{
+    DIRTY_RECT all = { 0, 0, fb->width, fb->height };
+    return all;
+}
+
+static bool sameField(const BACKGROUND_FIELD* a, const BACKGROUND_FIELD* b)
+{
+    size_t cells = (size_t) a->cols * a->rows;
+    size_t table = sizeof(int) * (a->cols + 1) * (a->rows + 1);
+    return a->cols == b->cols && a->rows == b->rows
+        && !memcmp(a->luminance, b->luminance, cells) && !memcmp(a->edge, b->edge, cells)
+        && !memcmp(a->solid, b->solid, cells) && !memcmp(a->solidCount, b->solidCount, table)
+        && !memcmp(a->solidX, b->solidX, table) && !memcmp(a->solidY, b->solidY, table);
+}
+
+// a fresh field built from the whole of fb
+static void buildField(BACKGROUND_FIELD* f, const FRAMEBUFFER* fb, const FIELD_OPTIONS* opt)
+{
+    initBackgroundField(f, fb->width, fb->height);
+    setBackgroundFieldMode(f, opt->mode, opt->edgeThreshold, opt->brightThreshold);
+    backgroundFieldScan(f, fb, 0, 0, wholeFrame(fb));
+    backgroundFieldRebuild(f);
+}
+
+// capture source handing out a copy of the picture in its context, for the saver's grab
+static bool grabPicture(void* context, FRAMEBUFFER* dst)
+{
+    const FRAMEBUFFER* picture = (const FRAMEBUFFER*) context;
+    for (int y = 0; y < dst->height; y++)
+        memcpy(dst->pixels + (size_t) y * dst->stride, picture->pixels + (size_t) y * picture->stride, sizeof(uint32_t) * dst->width);
+    return true;
+}
+
+// one frame of the saver's pipeline over picture, the field it scanned is left in f
+// returns how many background pixels didn't come out as the picture ANDed with mask
+static long long grabThroughPipeline(BACKGROUND_FIELD* f, const FRAMEBUFFER* picture, uint32_t mask, const FIELD_OPTIONS* opt)
+{
+    initBackgroundField(f, picture->width, picture->height);
+    setBackgroundFieldMode(f, opt->mode, opt->edgeThreshold, opt->brightThreshold);
+
+    CAPTURE_SOURCE source = { (void*) picture, grabPicture, NULL };
+    CAPTURE_CACHE capture;
+    initCaptureCache(&capture, source, 0);
+    FRAME_PIPELINE pipeline;
+    RENDERER renderer = createHeadlessRenderer(picture->width, picture->height, 0, NULL, 1);
+    BUBBLE_SNAPSHOT empty = {};
+    if (!renderer.frame.pixels || !initFramePipeline(&pipeline, renderer, &capture, 1, 0xffffff, NULL) || !initBubbleSnapshot(&empty, 1))
+        return -1;
+    pipeline.field = f;
+    pipeline.backgroundMask = mask;
+    renderFrame(&pipeline, &empty, 0);
+    backgroundFieldRebuild(f);
+
+    long long wrong = 0;
+    const FRAMEBUFFER* bg = &pipeline.renderer.background;
+    for (int y = 0; y < bg->height; y++) {
+        for (int x = 0; x < bg->width; x++)
+            wrong += bg->pixels[(size_t) y * bg->stride + x] != (picture->pixels[(size_t) y * picture->stride + x] & mask);
+    }
+
+    freeFramePipeline(&pipeline);
+    freeCaptureCache(&capture);
+    freeBubbleSnapshot(&empty);
+    return wrong;
+}
+
+static int countSolid(const BACKGROUND_FIELD* f)
+{
+    int solid = 0;
+    for (int i = 0; i < f->cols * f->rows; i++)
+        solid += f->solid[i];
+    return solid;
+}
+
+// random boxes summed from the tables and cell by cell
+static long long queryMismatches(const BACKGROUND_FIELD* f, int queries)
+{
+    long long mismatches = 0;
+    for (int q = 0; q < queries; q++) {
+        int c0 = (int) (bubbleRandom() % (f->cols + 4)) - 2;
+        int r0 = (int) (bubbleRandom() % (f->rows + 4)) - 2;
+        int c1 = c0 + (int) (bubbleRandom() % 40);
+        int r1 = r0 + (int) (bubbleRandom() % 40);
+
+        int sumX, sumY;
+        int count = backgroundFieldSolid(f, c0, r0, c1, r1, &sumX, &sumY);
+
+        int slowCount = 0, slowX = 0, slowY = 0;
+        for (int r = r0 < 0 ? 0 : r0; r <= r1 && r < f->rows; r++) {
+            for (int c = c0 < 0 ? 0 : c0; c <= c1 && c < f->cols; c++) {
+                if (f->solid[r * f->cols + c]) {
+                    slowCount++;
+                    slowX += c;
+                    slowY += r;
+                }
+            }
+        }
+        mismatches += count != slowCount || sumX != slowX || sumY != slowY;
+    }
+    return mismatches;
+}
+
+static void dumpField(const char* path, const BACKGROUND_FIELD* f, const FRAMEBUFFER* picture)
+{
+    FRAMEBUFFER out;
+    if (!allocFramebuffer(&out, picture->width, picture->height))
+        return;
+    for (int y = 0; y < out.height; y++) {
+        for (int x = 0; x < out.width; x++) {
+            int i = (y / FIELD_CELL) * f->cols + x / FIELD_CELL;
+            uint32_t l = f->luminance[i];
+            out.pixels[y * out.stride + x] = f->solid[i] ? 0xff0000 : (l << 16) | (l << 8) | l;
+        }
+    }
+    if (!savePNG(path, &out))
+        fprintf(stderr, "can't write %s\n", path);
+    free(out.pixels);
+}
+
+// ns per bubble step with the field on or off
+static double timeSteps(const FIELD_OPTIONS* opt, const BACKGROUND_FIELD* field)
+{
+    seedBubbleRandom(opt->seed);
+    initializeBubbles(opt->bubbles);
+    backgroundField = field;
+
+    long long start = nowNanos();
+    for (int s = 0; s < opt->steps; s++)
+        stepBubbles();
+    long long nanos = nowNanos() - start;
+
+    backgroundField = NULL;
+    return (double) nanos / opt->steps / opt->bubbles;
+}
+
+int main(int argc, char** argv)
+{
+    FIELD_OPTIONS opt = { NULL, 1920, 1080, FIELD_EDGES, 48, 224, 200, 600, 20, 1, NULL };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--image")) opt.image = value;
+        else if (!strcmp(argv[i], "--width")) opt.width = atoi(value);
+        else if (!strcmp(argv[i], "--height")) opt.height = atoi(value);
+        else if (!strcmp(argv[i], "--mode")) {
+            if (!parseFieldMode(value, &opt.mode)) {
+                fprintf(stderr, "unknown mode %s\n", value);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--edge-threshold")) opt.edgeThreshold = atoi(value);
+        else if (!strcmp(argv[i], "--bright-threshold")) opt.brightThreshold = atoi(value);
+        else if (!strcmp(argv[i], "--bubbles")) opt.bubbles = atoi(value);
+        else if (!strcmp(argv[i], "--steps")) opt.steps = atoi(value);
+        else if (!strcmp(argv[i], "--reps")) opt.reps = atoi(value);
+        else if (!strcmp(argv[i], "--seed")) opt.seed = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i], "--dump")) opt.dump = value;
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opt.width < FIELD_CELL * 4 || opt.height < FIELD_CELL * 4 || opt.bubbles < 1 || opt.steps < 1 || opt.reps < 1) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    // the picture, and the same with the moving window moved
+    FRAMEBUFFER picture, moved;
+    if (opt.image) {
+        if (!loadPPM(opt.image, &picture)) {
+            fprintf(stderr, "can't read %s\n", opt.image);
+            return 1;
+        }
+        if (!allocFramebuffer(&moved, picture.width, picture.height))
+            return 1;
+        drawWindow(&picture, movingWindow(&picture, 0));
+        memcpy(moved.pixels, picture.pixels, sizeof(uint32_t) * picture.stride * picture.height);
+        // what was under the window comes back from the original image
+        FRAMEBUFFER original;
+        loadPPM(opt.image, &original);
+        DIRTY_RECT before = movingWindow(&picture, 0);
+        copyRect(&moved, &original, before);
+        drawWindow(&moved, movingWindow(&picture, WINDOW_MOVE));
+        free(original.pixels);
+    } else {
+        if (!allocFramebuffer(&picture, opt.width, opt.height) || !allocFramebuffer(&moved, opt.width, opt.height))
+            return 1;
+        drawDesktop(&picture, 0);
+        drawDesktop(&moved, WINDOW_MOVE);
+    }
+    seedBubbleRandom(opt.seed);
+
+    bool ok = true;
+
+    // scanning with each kernel
+    const FIELD_KERNEL all[MAX_KERNELS] = { FIELD_KERNEL_SCALAR, FIELD_KERNEL_SSE2, FIELD_KERNEL_AVX2 };
+    BACKGROUND_FIELD reference = {};
+    long long kernelNanos[MAX_KERNELS] = {};
+    const char* kernelNames[MAX_KERNELS] = {};
+    int numKernels = 0;
+    long long kernelMismatches = 0;
+    for (int k = 0; k < MAX_KERNELS; k++) {
+        if (!useFieldKernel(all[k]))
+            continue;
+        kernelNames[numKernels] = fieldKernelName();
+
+        long long best = -1;
+        for (int rep = 0; rep < opt.reps; rep++) {
+            BACKGROUND_FIELD f;
+            initBackgroundField(&f, picture.width, picture.height);
+            long long start = nowNanos();
+            backgroundFieldScan(&f, &picture, 0, 0, wholeFrame(&picture));
+            long long took = nowNanos() - start;
+            if (best < 0 || took < best)
+                best = took;
+
+            if (rep == 0 && !reference.cols) {
+                reference = f;
+                continue;
+            }
+            if (rep == 0)
+                kernelMismatches += memcmp(f.luminance, reference.luminance, (size_t) f.cols * f.rows) != 0;
+            freeBackgroundField(&f);
+        }
+        kernelNanos[numKernels++] = best;
+    }
+    freeBackgroundField(&reference);
+    ok = ok && kernelMismatches == 0;
+
+    // from here on the fastest kernel this cpu has
+    useFieldKernel(all[0]);
+    for (int k = MAX_KERNELS - 1; k >= 0; k--) {
+        if (useFieldKernel(all[k]))
+            break;
+    }
+
+    BACKGROUND_FIELD field;
+    initBackgroundField(&field, picture.width, picture.height);
+    setBackgroundFieldMode(&field, opt.mode, opt.edgeThreshold, opt.brightThreshold);
+    backgroundFieldScan(&field, &picture, 0, 0, wholeFrame(&picture));
+    long long start = nowNanos();
+    backgroundFieldRebuild(&field);
+    long long rebuildNanos = nowNanos() - start;
+
+    // the same picture again
+    start = nowNanos();
+    int unchangedCells = backgroundFieldScan(&field, &picture, 0, 0, wholeFrame(&picture));
+    bool unchangedRebuilt = backgroundFieldRebuild(&field);
+    long long unchangedNanos = nowNanos() - start;
+    ok = ok && unchangedCells == 0 && !unchangedRebuilt;
+
+    // the window moved, only where it was and is now is scanned
+    DIRTY_RECT dirty = movingWindow(&picture, 0);
+    dirty.right += WINDOW_MOVE;
+    start = nowNanos();
+    int movedCells = backgroundFieldScan(&field, &moved, 0, 0, dirty);
+    backgroundFieldRebuild(&field);
+    long long incrementalNanos = nowNanos() - start;
+
+    BACKGROUND_FIELD fresh;
+    start = nowNanos();
+    buildField(&fresh, &moved, &opt);
+    long long freshNanos = nowNanos() - start;
+    bool incrementalSame = sameField(&field, &fresh);
+    ok = ok && incrementalSame;
+
+    // two monitors side by side. split on the cell grid the field is the same as
+    // from one frame, off it the cells across the seam only average the pixels of
+    // the frame their centre is in, but still every cell is scanned exactly once
+    bool splitSame = true;
+    long long splitCells[2];
+    for (int offGrid = 0; offGrid < 2; offGrid++) {
+        int seam = (moved.width / 2) / FIELD_CELL * FIELD_CELL + (offGrid ? 5 : 0);
+        FRAMEBUFFER left = moved;
+        left.width = seam;
+        FRAMEBUFFER right = moved;
+        right.pixels += seam;
+        right.width = moved.width - seam;
+
+        BACKGROUND_FIELD split;
+        initBackgroundField(&split, moved.width, moved.height);
+        setBackgroundFieldMode(&split, opt.mode, opt.edgeThreshold, opt.brightThreshold);
+        backgroundFieldScan(&split, &right, seam, 0, wholeFrame(&right));
+        backgroundFieldScan(&split, &left, 0, 0, wholeFrame(&left));
+        backgroundFieldRebuild(&split);
+        if (!offGrid)
+            splitSame = sameField(&split, &fresh);
+        splitCells[offGrid] = split.cellsScanned;
+        freeBackgroundField(&split);
+    }
+    long long totalCells = (long long) fresh.cols * fresh.rows;
+    bool splitCovered = splitCells[0] == totalCells && splitCells[1] == totalCells;
+    ok = ok && splitSame && splitCovered;
+
+    long long mismatches = queryMismatches(&fresh, 100000);
+    ok = ok && mismatches == 0;
+
+    // the saver's grab. scanning what's left after the background colour went in
+    // instead would find next to nothing (masked_scan_solid_cells)
+    BACKGROUND_FIELD grabbed;
+    long long maskMismatches = grabThroughPipeline(&grabbed, &moved, SAVER_BACKGROUND, &opt);
+    bool grabbedSame = sameField(&grabbed, &fresh);
+    ok = ok && grabbedSame && maskMismatches == 0;
+    freeBackgroundField(&grabbed);
+
+    // with the field off (the saver's default) a grab isn't scanned at all
+    FIELD_OPTIONS off = opt;
+    off.mode = FIELD_OFF;
+    maskMismatches += grabThroughPipeline(&grabbed, &moved, SAVER_BACKGROUND, &off);
+    long long offCells = grabbed.cellsScanned;
+    ok = ok && offCells == 0 && maskMismatches == 0;
+    freeBackgroundField(&grabbed);
+
+    FRAMEBUFFER masked;
+    if (!allocFramebuffer(&masked, moved.width, moved.height))
+        return 1;
+    for (int y = 0; y < moved.height; y++) {
+        for (int x = 0; x < moved.width; x++)
+            masked.pixels[(size_t) y * masked.stride + x] = moved.pixels[(size_t) y * moved.stride + x] & SAVER_BACKGROUND;
+    }
+    BACKGROUND_FIELD maskedField;
+    buildField(&maskedField, &masked, &opt);
+    int maskedSolid = countSolid(&maskedField);
+    freeBackgroundField(&maskedField);
+    free(masked.pixels);
+
+    // contact queries for bubbles all over the screen
+    const int QUERIES = 1000000;
+    float* qx = (float*) malloc(sizeof(float) * 3 * 1024);
+    for (int i = 0; i < 3 * 1024; i += 3) {
+        qx[i] = (float) (bubbleRandom() % moved.width);
+        qx[i + 1] = (float) (bubbleRandom() % moved.height);
+        qx[i + 2] = (float) (4 + bubbleRandom() % 300);
+    }
+    int contacts = 0;
+    start = nowNanos();
+    for (int q = 0; q < QUERIES; q++) {
+        const float* b = &qx[(q & 1023) * 3];
+        float nx, ny;
+        contacts += backgroundFieldContact(&fresh, b[0], b[1], b[2], &nx, &ny);
+    }
+    double queryNanos = (double) (nowNanos() - start) / QUERIES;
+    free(qx);
+
+    // bubbles on the moved picture
+    worldWidth = moved.width;
+    worldHeight = moved.height;
+    BUBBLE_RADIUS = scaledBubbleRadius(moved.width, moved.height, opt.bubbles);
+    allocateBubbles(opt.bubbles);
+    double stepOff = timeSteps(&opt, NULL);
+    double stepOn = timeSteps(&opt, &fresh);
+
+    if (opt.dump)
+        dumpField(opt.dump, &fresh, &moved);
+
+    printf("{\n  \"width\": %d, \"height\": %d, \"cols\": %d, \"rows\": %d, \"image\": \"%s\", \"mode\": \"%s\", \"solid_cells\": %d,\n",
+        moved.width, moved.height, fresh.cols, fresh.rows, opt.image ? opt.image : "synthetic", fieldModeName(opt.mode), countSolid(&fresh));
+    printf("  \"scan_us\": {");
+    for (int k = 0; k < numKernels; k++)
+        printf("%s\"%s\": %.1f", k ? ", " : "", kernelNames[k], kernelNanos[k] / 1e3);
+    printf("},\n");
+    printf("  \"rebuild_us\": %.1f, \"unchanged_rescan_us\": %.1f, \"unchanged_cells\": %d,\n",
+        rebuildNanos / 1e3, unchangedNanos / 1e3, unchangedCells);
+    printf("  \"window_move_us\": %.1f, \"window_move_cells\": %d, \"full_rebuild_us\": %.1f,\n",
+        incrementalNanos / 1e3, movedCells, freshNanos / 1e3);
+    printf("  \"contact_ns\": %.2f, \"contact_fraction\": %.3f,\n", queryNanos, (double) contacts / QUERIES);
+    printf("  \"ns_per_bubble_step\": {\"field_off\": %.1f, \"field_on\": %.1f},\n", stepOff, stepOn);
+    printf("  \"masked_scan_solid_cells\": %d, \"grabbed_same\": %s, \"mask_mismatches\": %lld, \"field_off_cells_scanned\": %lld,\n",
+        maskedSolid, grabbedSame ? "true" : "false", maskMismatches, offCells);
+    printf("  \"kernel_mismatches\": %lld, \"incremental_same\": %s, \"split_same\": %s, \"split_covered\": %s, \"query_mismatches\": %lld\n}\n",
+        kernelMismatches, incrementalSame ? "true" : "false", splitSame ? "true" : "false", splitCovered ? "true" : "false", mismatches);
+
+    freeBackgroundField(&field);
+    freeBackgroundField(&fresh);
+    free(picture.pixels);
+    free(moved.pixels);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// headless check that the grid broad phase finds the same contacts as the
+// brute force loop it replaced
+// every scene is seeded, and every step of it is run twice from the same state:
+// once through stepBubbles (collisionCheck on the grid) and once through the
+// same step with collisionCheckBruteForce. the pairs each one bounces, in the
+// order it bounces them, and the bubbles they leave behind have to be identical
+// bit for bit. scenes cover both collision responses, fixed and mixed radii
+// (so the hierarchical grid's levels) and the batched pair tests on and off
+//
+// usage: GridCheck [--steps 200] [--seeds 5] [--width 1280] [--height 720]
+//
+// prints a line of JSON per scene and exits with 1 on any mismatch
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../BubblePhysics.h"
+#include "../BubbleGrid.h"
+
+struct CONTACT_LOG {
+    int count;
+    int capacity;
+    int* pairs; // b, other, b, other...
+};
+
+static CONTACT_LOG* recording;
+
+static void recordContact(int b, int other)
+{
+    CONTACT_LOG* log = recording;
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 1024;
+        log->pairs = (int*) realloc(log->pairs, sizeof(int) * 2 * log->capacity);
+    }
+    log->pairs[2 * log->count] = b;
+    log->pairs[2 * log->count + 1] = other;
+    log->count++;
+}
+
+// stepBubbles with bubbleUpdate's collisionCheck swapped for the brute force loop
+static void stepBruteForce()
+{
+    for (int i = 0; i < numBubbles; i++) {
+        bubbles[i].prevX = bubbles[i].x;
+        bubbles[i].prevY = bubbles[i].y;
+    }
+
+    for (int i = 0; i < numBubbles; i++) {
+        BUBBLE* b = &bubbles[i];
+        if (b->sleeping)
+            continue;
+
+        accelerateBubble(b);
+        b->x += b->xVel;
+        b->y += b->yVel;
+        wallCheck(b);
+        bubbleGridMove(&bubbleGrid, i, b->x, b->y);
+        collisionCheckBruteForce(b);
+        updateBubbleSleep(b);
+    }
+}
+
+struct SCENE {
+    int bubbles;
+    RADIUS_DISTRIBUTION radii;
+    bool impulse;
+    bool batched;
+};
+
+int main(int argc, char** argv)
+{
+    int steps = 200;
+    int seeds = 5;
+    int width = 1280;
+    int height = 720;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--steps")) steps = atoi(value);
+        else if (!strcmp(argv[i], "--seeds")) seeds = atoi(value);
+        else if (!strcmp(argv[i], "--width")) width = atoi(value);
+        else if (!strcmp(argv[i], "--height")) height = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (steps < 1 || seeds < 1 || width < 1 || height < 1) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    const SCENE scenes[] = {
+        { 10, RADIUS_FIXED, false, true },
+        { 300, RADIUS_FIXED, false, true },
+        { 300, RADIUS_FIXED, false, false },
+        { 2000, RADIUS_FIXED, false, true },
+        { 300, RADIUS_FIXED, true, true },
+        { 300, RADIUS_BIMODAL, false, true },
+        { 300, RADIUS_POWER_LAW, true, true },
+        { 1000, RADIUS_UNIFORM, false, false },
+    };
+    const int numScenes = sizeof(scenes) / sizeof(scenes[0]);
+
+    worldWidth = width;
+    worldHeight = height;
+    CONTACT_LOG grid = {};
+    CONTACT_LOG brute = {};
+    contactObserver = recordContact;
+    bool ok = true;
+
+    for (int s = 0; s < numScenes; s++) {
+        const SCENE* scene = &scenes[s];
+        for (int seed = 1; seed <= seeds; seed++) {
+            BUBBLE_RADIUS = scaledBubbleRadius(width, height, scene->bubbles);
+            radiusDistribution = scene->radii;
+            minBubbleRadius = BUBBLE_RADIUS / 10.0f > 1 ? BUBBLE_RADIUS / 10.0f : 1;
+            maxBubbleRadius = BUBBLE_RADIUS * 10.0f;
+            float largest = (width < height ? width : height) / 4.0f;
+            if (maxBubbleRadius > largest)
+                maxBubbleRadius = largest;
+            impulseResponse = scene->impulse;
+            batchedPairTests = scene->batched;
+
+            seedBubbleRandom(seed);
+            if (!allocateBubbles(scene->bubbles)) {
+                fprintf(stderr, "out of memory for %d bubbles\n", scene->bubbles);
+                return 1;
+            }
+            initializeBubbles(scene->bubbles);
+            BUBBLE* start = (BUBBLE*) malloc(sizeof(BUBBLE) * numBubbles);
+            BUBBLE* gridResult = (BUBBLE*) malloc(sizeof(BUBBLE) * numBubbles);
+
+            long long contacts = 0;
+            int firstBadStep = -1;
+            for (int step = 0; step < steps && firstBadStep < 0; step++) {
+                memcpy(start, bubbles, sizeof(BUBBLE) * numBubbles);
+
+                grid.count = 0;
+                recording = &grid;
+                stepBubbles();
+                memcpy(gridResult, bubbles, sizeof(BUBBLE) * numBubbles);
+
+                // back to where the step started, grid included
+                memcpy(bubbles, start, sizeof(BUBBLE) * numBubbles);
+                for (int i = 0; i < numBubbles; i++)
+                    bubbleGridMove(&bubbleGrid, i, bubbles[i].x, bubbles[i].y);
+
+                brute.count = 0;
+                recording = &brute;
+                stepBruteForce();
+
+                contacts += grid.count;
+                bool same = grid.count == brute.count
+                    && !memcmp(grid.pairs, brute.pairs, sizeof(int) * 2 * grid.count)
+                    && !memcmp(gridResult, bubbles, sizeof(BUBBLE) * numBubbles);
+                if (!same)
+                    firstBadStep = step;
+            }
+
+            printf("{\"bubbles\": %d, \"radius_dist\": \"%s\", \"impulse\": %d, \"batched\": %d, \"seed\": %d, \"steps\": %d, \"contacts\": %lld, \"first_mismatch\": %d}\n",
+                scene->bubbles, radiusDistributionName(scene->radii), scene->impulse, scene->batched, seed, steps, contacts, firstBadStep);
+            ok = ok && firstBadStep < 0;
+            free(start);
+            free(gridResult);
+        }
+    }
+
+    free(grid.pairs);
+    free(brute.pairs);
+    return ok ? 0 : 1;
+}
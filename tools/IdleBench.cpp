@@ -0,0 +1,243 @@
+// headless benchmark for the idle detection
+// plays a made up day of someone using the machine (bursts of input with
+// breaks in between) against IdleDetector on a simulated clock, and against
+// the old loop that woke every 100 ms, and prints wakeups and how late the
+// saver showed and hid for each as JSON
+//
+// usage: IdleBench [--hours 8] [--idle-after 10000] [--warm-up 1000] [--seed 1]
+//
+// the detector should show the saver exactly idle-after ms after the last
+// input and hide it on the first input after that, so both its max
+// latencies are 0. on windows the hide latency is however long the input
+// hook takes to be called. with a warm up every show should come warm-up ms
+// after the saver was resumed (cold_shows counts the ones that didn't), it
+// exits with 1 if any of that doesn't hold. resident_fraction is how much of the day the saver's
+// buffers were allocated (warming up or shown)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IdleDetector.h"
+
+const long long POLL_INTERVAL = 100;  // the old CheckUserInteractionLoop's Sleep
+const long long POLL_RECENT_INPUT = 250; // it hid the saver on input this recent
+
+struct SIM_TIMELINE {
+    long long* inputs; // sorted input times
+    int count;
+    long long now;
+    int next;          // first input after now
+};
+
+static unsigned int idleRandomState;
+
+static unsigned int idleRandom()
+{
+    idleRandomState ^= idleRandomState << 13;
+    idleRandomState ^= idleRandomState >> 17;
+    idleRandomState ^= idleRandomState << 5;
+    return idleRandomState;
+}
+
+static long long randomBetween(long long low, long long high)
+{
+    return low + (long long) (idleRandom() % (unsigned int) (high - low + 1));
+}
+
+// sessions of 1 - 30 minutes typing and moving the mouse every 20 ms - 3 s
+// (with the odd 5 - 20 s pause for reading) and 10 s - 40 minute breaks
+static void makeTimeline(SIM_TIMELINE* t, long long end)
+{
+    int capacity = 1024;
+    t->inputs = (long long*) malloc(sizeof(long long) * capacity);
+    t->count = 0;
+
+    long long time = 0;
+    while (time < end) {
+        long long sessionEnd = time + randomBetween(60 * 1000, 30 * 60 * 1000);
+        while (time < sessionEnd && time < end) {
+            if (t->count == capacity) {
+                capacity *= 2;
+                t->inputs = (long long*) realloc(t->inputs, sizeof(long long) * capacity);
+            }
+            t->inputs[t->count++] = time;
+            time += idleRandom() % 50 == 0 ? randomBetween(5000, 20000) : randomBetween(20, 3000);
+        }
+        time += randomBetween(10 * 1000, 40 * 60 * 1000);
+    }
+    t->now = 0;
+    t->next = 0;
+}
+
+static void advance(SIM_TIMELINE* t, long long now)
+{
+    t->now = now;
+    while (t->next < t->count && t->inputs[t->next] <= now)
+        t->next++;
+}
+
+static long long simNow(void* context)
+{
+    return ((SIM_TIMELINE*) context)->now;
+}
+
+static long long simLastInput(void* context)
+{
+    SIM_TIMELINE* t = (SIM_TIMELINE*) context;
+    return t->next > 0 ? t->inputs[t->next - 1] : 0;
+}
+
+struct IDLE_RESULT {
+    long long wakeups;
+    long long shows;
+    long long hides;
+    long long maxShowLatency; // after the last input + idle-after
+    long long maxHideLatency; // after the first input while shown
+    long long warmUps;
+    long long coolDowns;
+    long long coldShows;      // shown without warm-up ms of warming up first
+    long long residentMs;     // warming up or shown
+};
+
+static void printResult(const char* name, const IDLE_RESULT* r, double hours, bool last)
+{
+    printf("    \"%s\": {\"wakeups\": %lld, \"wakeups_per_hour\": %.1f, \"shows\": %lld, \"hides\": %lld, "
+        "\"max_show_latency_ms\": %lld, \"max_hide_latency_ms\": %lld, \"warm_ups\": %lld, \"cool_downs\": %lld, "
+        "\"cold_shows\": %lld, \"resident_fraction\": %.4f}%s\n",
+        name, r->wakeups, r->wakeups / hours, r->shows, r->hides, r->maxShowLatency, r->maxHideLatency,
+        r->warmUps, r->coolDowns, r->coldShows, r->residentMs / (hours * 3600 * 1000), last ? "" : ",");
+}
+
+static IDLE_RESULT runDetector(SIM_TIMELINE* t, long long end, long long idleAfter, long long warmUp)
+{
+    IDLE_RESULT r = {};
+    IDLE_DETECTOR d;
+    IDLE_SOURCE source = { t, simNow, simLastInput };
+    initIdleDetector(&d, source, idleAfter, warmUp);
+    t->next = 0;
+    advance(t, 0);
+
+    long long wait;
+    long long residentSince = -1; // when the saver was last resumed, -1 while suspended
+    IDLE_ACTION action = idleTimer(&d, &wait);
+    while (true) {
+        if (action == IDLE_WARM_UP_SAVER) {
+            residentSince = t->now;
+        } else if (action == IDLE_SHOW_SAVER) {
+            long long late = t->now - (simLastInput(t) + idleAfter);
+            if (late > r.maxShowLatency)
+                r.maxShowLatency = late;
+            if (residentSince < 0 || t->now - residentSince < warmUp)
+                r.coldShows++;
+            if (residentSince < 0)
+                residentSince = t->now;
+        } else if (action == IDLE_COOL_DOWN_SAVER || action == IDLE_HIDE_SAVER) {
+            r.residentMs += t->now - residentSince;
+            residentSince = -1;
+        }
+
+        if (wait == IDLE_WAIT_FOR_INPUT) {
+            // the hooks deliver the next input as it happens
+            if (t->next == t->count)
+                break;
+            long long input = t->inputs[t->next];
+            advance(t, input);
+            action = idleInput(&d, &wait);
+            if (action == IDLE_HIDE_SAVER && t->now - input > r.maxHideLatency)
+                r.maxHideLatency = t->now - input;
+        } else {
+            // input while the saver is hidden isn't delivered, only the timer wakes it
+            if (t->now + wait > end)
+                break;
+            advance(t, t->now + wait);
+            action = idleTimer(&d, &wait);
+        }
+    }
+
+    if (residentSince >= 0)
+        r.residentMs += t->now - residentSince;
+    r.wakeups = d.wakeups;
+    r.shows = d.shows;
+    r.hides = d.hides;
+    r.warmUps = d.warmUps;
+    r.coolDowns = d.coolDowns;
+    return r;
+}
+
+// the loop this replaced: wake every 100 ms, show when idle for longer than
+// idle-after, hide when there was input in the last 250 ms
+static IDLE_RESULT runPolling(SIM_TIMELINE* t, long long end, long long idleAfter)
+{
+    IDLE_RESULT r = {};
+    bool shown = false;
+    int firstInputWhileShown = 0;
+    t->next = 0;
+
+    for (long long now = POLL_INTERVAL; now <= end; now += POLL_INTERVAL) {
+        advance(t, now);
+        r.wakeups++;
+        long long idle = now - simLastInput(t);
+
+        if (shown && idle < POLL_RECENT_INPUT) {
+            shown = false;
+            r.hides++;
+            long long late = now - t->inputs[firstInputWhileShown];
+            if (late > r.maxHideLatency)
+                r.maxHideLatency = late;
+        } else if (!shown && idle > idleAfter) {
+            shown = true;
+            r.shows++;
+            r.coldShows++; // the old saver kept everything allocated, but never warmed the capture
+            firstInputWhileShown = t->next;
+            long long late = now - (simLastInput(t) + idleAfter);
+            if (late > r.maxShowLatency)
+                r.maxShowLatency = late;
+        }
+    }
+    // and never freed anything
+    r.residentMs = end;
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    double hours = 8;
+    long long idleAfter = 10000;
+    long long warmUp = 1000;
+    unsigned int seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--hours")) hours = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--idle-after")) idleAfter = atoll(argv[i + 1]);
+        else if (!strcmp(argv[i], "--warm-up")) warmUp = atoll(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (hours <= 0 || idleAfter <= 0 || warmUp < 0 || warmUp > idleAfter) {
+        fprintf(stderr, "bad duration\n");
+        return 1;
+    }
+
+    idleRandomState = seed ? seed : 1;
+    long long end = (long long) (hours * 3600 * 1000);
+    SIM_TIMELINE timeline;
+    makeTimeline(&timeline, end);
+
+    IDLE_RESULT detector = runDetector(&timeline, end, idleAfter, warmUp);
+    IDLE_RESULT polling = runPolling(&timeline, end, idleAfter);
+
+    printf("{\n  \"hours\": %g, \"idle_after_ms\": %lld, \"warm_up_ms\": %lld, \"inputs\": %d,\n", hours, idleAfter, warmUp, timeline.count);
+    printf("  \"results\": {\n");
+    printResult("detector", &detector, hours, false);
+    printResult("polling", &polling, hours, true);
+    printf("  }\n}\n");
+
+    free(timeline.inputs);
+    bool ok = detector.maxShowLatency == 0 && detector.maxHideLatency == 0
+        && (warmUp == 0 || detector.coldShows == 0);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+// headless benchmark for the frame pacing
+// runs FrameScheduler against a simulated display and prints as JSON how
+// evenly the frames would have reached the screen, next to the old
+// Sleep(33) loop and to the scheduler without vblank syncing
+//
+// usage: PacingBench [--refresh 59.94] [--nominal 60] [--rate 0] [--seconds 60]
+//                    [--render-ms 4] [--spike-ms 25] [--spike-every 600]
+//                    [--jitter-ms 0.5] [--sync-every 60] [--seed 1] [--real 0]
+//
+// the display refreshes every 1 / --refresh seconds but says it runs at
+// --nominal Hz (like a 59.94 Hz panel reporting 60). --rate is the frame
+// rate asked for, 0 for the display's. drawing a frame takes --render-ms
+// (+-25%), every --spike-every-th frame takes --spike-ms instead, and every
+// wait returns up to --jitter-ms late
+//
+// a frame presented between two vblanks is shown at the second one. with
+// the frame rate at 1 / n of the refresh every frame should stay on screen
+// for n vblanks, uneven_intervals counts the ones that didn't and lost the
+// frames replaced before they were ever shown. frames the scheduler knows
+// it missed (a spike) account for some, the synced scheduler must not have
+// any others or lose any frame, it exits with 1 if it does
+//
+// --real 1 paces the scheduler on the real clock instead (render time is
+// spent spinning) and reports how late its waits returned and how many
+// deadlines it missed, for checking the timer on this machine
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../FrameScheduler.h"
+
+const long long OLD_SLEEP = 33 * 1000000LL; // WM_PAINT's Sleep(33)
+
+enum PACING { PACING_SLEEP, PACING_SCHEDULER, PACING_SYNCED };
+
+struct PACING_OPTIONS {
+    double refresh;
+    double nominal;
+    double rate;
+    double seconds;
+    double renderMs;
+    double spikeMs;
+    int spikeEvery;
+    double jitterMs;
+    int syncEvery;
+    unsigned int seed;
+    bool real;
+};
+
+struct SIM_DISPLAY {
+    long long now;
+    long long refresh; // the display's real period
+    long long jitter;
+    unsigned int random;
+};
+
+struct PACING_RESULT {
+    long long frames;
+    long long shown;           // frames that made it to the screen
+    long long lost;            // replaced before a vblank showed them
+    long long uneven;          // shown for a different number of vblanks than the rate means
+    long long dropped;         // deadlines the scheduler says it missed
+    long long dropEvents;      // frames that missed at least one
+    long long intervalCounts[5]; // frames shown for 1, 2, 3, 4 and 5+ vblanks
+};
+
+static unsigned int nextRandom(unsigned int* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static long long simNow(void* context)
+{
+    return ((SIM_DISPLAY*) context)->now;
+}
+
+static void simWaitUntil(void* context, long long time)
+{
+    SIM_DISPLAY* d = (SIM_DISPLAY*) context;
+    if (time > d->now)
+        d->now = time;
+    if (d->jitter > 0)
+        d->now += nextRandom(&d->random) % (d->jitter + 1);
+}
+
+static long long renderNanos(const PACING_OPTIONS* opt, long long frame, unsigned int* random)
+{
+    if (opt->spikeEvery > 0 && frame % opt->spikeEvery == opt->spikeEvery - 1)
+        return (long long) (opt->spikeMs * 1e6);
+    double spread = 0.75 + (nextRandom(random) % 1000) / 2000.0;
+    return (long long) (opt->renderMs * 1e6 * spread);
+}
+
+static PACING_RESULT runSimulated(const PACING_OPTIONS* opt, PACING pacing)
+{
+    PACING_RESULT r = {};
+    SIM_DISPLAY display = { 0, framePeriodForRate(opt->refresh), (long long) (opt->jitterMs * 1e6), opt->seed };
+    unsigned int renderRandom = opt->seed * 2654435761u + 1;
+
+    // what the scheduler is told, the display's nominal rate unless one was asked for
+    long long period = framePeriodForRate(opt->rate > 0 ? opt->rate : opt->nominal);
+    long long target = pacing == PACING_SLEEP ? 2 : (period + display.refresh / 2) / display.refresh;
+    if (target < 1)
+        target = 1;
+
+    FRAME_CLOCK clock = { &display, simNow, simWaitUntil };
+    FRAME_SCHEDULER s;
+    initFrameScheduler(&s, clock, period);
+
+    long long end = (long long) (opt->seconds * 1e9);
+    long long lastVblank = -1; // vblank the previous frame is shown at
+    long long shownAt = -1;    // vblank the frame on screen first appeared at
+    while (display.now < end) {
+        display.now += renderNanos(opt, r.frames, &renderRandom);
+        r.frames++;
+
+        // shown at the first vblank at or after the present
+        long long vblank = (display.now + display.refresh - 1) / display.refresh;
+        if (vblank == lastVblank) {
+            r.lost++;
+        } else {
+            if (shownAt >= 0) {
+                long long interval = vblank - shownAt;
+                r.intervalCounts[interval < 5 ? interval - 1 : 4]++;
+                if (interval != target)
+                    r.uneven++;
+            }
+            shownAt = vblank;
+            r.shown++;
+        }
+        lastVblank = vblank;
+
+        if (pacing == PACING_SLEEP) {
+            simWaitUntil(&display, display.now + OLD_SLEEP);
+            continue;
+        }
+
+        // the display reports its last vblank and real period, like DwmGetCompositionTimingInfo
+        if (pacing == PACING_SYNCED && r.frames % opt->syncEvery == 0)
+            frameSchedulerSync(&s, display.now / display.refresh * display.refresh, target * display.refresh);
+
+        if (frameSchedulerWait(&s) > 0)
+            r.dropEvents++;
+    }
+    r.dropped = s.dropped;
+    return r;
+}
+
+static void printResult(const char* name, const PACING_RESULT* r, const PACING_OPTIONS* opt, bool last)
+{
+    printf("    \"%s\": {\"frames\": %lld, \"shown\": %lld, \"shown_fps\": %.2f, \"lost\": %lld, \"uneven_intervals\": %lld, "
+        "\"dropped\": %lld, \"drop_events\": %lld, \"vblanks_on_screen\": [%lld, %lld, %lld, %lld, %lld]}%s\n",
+        name, r->frames, r->shown, r->shown / opt->seconds, r->lost, r->uneven, r->dropped, r->dropEvents,
+        r->intervalCounts[0], r->intervalCounts[1], r->intervalCounts[2], r->intervalCounts[3], r->intervalCounts[4],
+        last ? "" : ",");
+}
+
+//=======================Real clock=====================
+
+static long long realNow(void* context)
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void realWaitUntil(void* context, long long time)
+{
+    timespec t = { (time_t) (time / 1000000000LL), (long) (time % 1000000000LL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) != 0) {
+    }
+}
+
+static int runReal(const PACING_OPTIONS* opt)
+{
+    double rate = opt->rate > 0 ? opt->rate : opt->nominal;
+    FRAME_CLOCK clock = { NULL, realNow, realWaitUntil };
+    FRAME_SCHEDULER s;
+    initFrameScheduler(&s, clock, framePeriodForRate(rate));
+
+    unsigned int random = opt->seed;
+    long long end = realNow(NULL) + (long long) (opt->seconds * 1e9);
+    long long dropEvents = 0;
+    while (realNow(NULL) < end) {
+        long long busyUntil = realNow(NULL) + renderNanos(opt, s.frames, &random);
+        while (realNow(NULL) < busyUntil) {
+        }
+        if (frameSchedulerWait(&s) > 0)
+            dropEvents++;
+    }
+
+    printf("{\n  \"real\": {\"rate\": %g, \"seconds\": %g, \"frames\": %lld, \"fps\": %.2f, \"dropped\": %lld, \"drop_events\": %lld, "
+        "\"mean_late_wake_us\": %.3f, \"max_late_wake_us\": %.3f}\n}\n",
+        rate, opt->seconds, s.frames, s.frames / opt->seconds, s.dropped, dropEvents,
+        s.frames ? s.lateWakeSum / 1000.0 / s.frames : 0.0, s.lateWakeMax / 1000.0);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    PACING_OPTIONS opt = { 59.94, 60, 0, 60, 4, 25, 600, 0.5, 60, 1, false };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--refresh")) opt.refresh = atof(value);
+        else if (!strcmp(argv[i], "--nominal")) opt.nominal = atof(value);
+        else if (!strcmp(argv[i], "--rate")) opt.rate = atof(value);
+        else if (!strcmp(argv[i], "--seconds")) opt.seconds = atof(value);
+        else if (!strcmp(argv[i], "--render-ms")) opt.renderMs = atof(value);
+        else if (!strcmp(argv[i], "--spike-ms")) opt.spikeMs = atof(value);
+        else if (!strcmp(argv[i], "--spike-every")) opt.spikeEvery = atoi(value);
+        else if (!strcmp(argv[i], "--jitter-ms")) opt.jitterMs = atof(value);
+        else if (!strcmp(argv[i], "--sync-every")) opt.syncEvery = atoi(value);
+        else if (!strcmp(argv[i], "--seed")) opt.seed = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i], "--real")) opt.real = atoi(value) != 0;
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opt.refresh <= 0 || opt.nominal <= 0 || opt.seconds <= 0 || opt.syncEvery <= 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+    if (!opt.seed)
+        opt.seed = 1;
+
+    if (opt.real)
+        return runReal(&opt);
+
+    PACING_RESULT sleep = runSimulated(&opt, PACING_SLEEP);
+    PACING_RESULT scheduler = runSimulated(&opt, PACING_SCHEDULER);
+    PACING_RESULT synced = runSimulated(&opt, PACING_SYNCED);
+
+    printf("{\n  \"refresh\": %g, \"nominal\": %g, \"rate\": %g, \"seconds\": %g, \"render_ms\": %g, \"jitter_ms\": %g,\n",
+        opt.refresh, opt.nominal, opt.rate, opt.seconds, opt.renderMs, opt.jitterMs);
+    printf("  \"results\": {\n");
+    printResult("sleep33", &sleep, &opt, false);
+    printResult("scheduler", &scheduler, &opt, false);
+    printResult("synced", &synced, &opt, true);
+    printf("  }\n}\n");
+
+    bool ok = synced.lost == 0 && synced.uneven <= synced.dropEvents;
+    return ok ? 0 : 1;
+}
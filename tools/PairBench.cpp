@@ -0,0 +1,438 @@
+// headless micro benchmark for collisionCheck's narrow phase
+// builds a scene, collects the candidate lists the grid hands collisionCheck,
+// then runs the contact test over all of them with the original formulation
+// (sqrt(pow()) for the speed and the distance on every pair, in double), the
+// squared distance early-out, and pairTestBlock with each kernel this cpu has.
+// prints the cost per pair as JSON
+//
+// usage: PairBench [--bubbles 10000] [--width 1920] [--height 1080] [--seed 1]
+//                  [--reps 20] [--steps 300] [--boundary 1000000] [--impulse 0]
+//                  [--radius-dist fixed|uniform|power-law|bimodal] [--min-radius 0] [--max-radius 0]
+//
+// mixed sizes (see BubbleBench) give the big bubbles long candidate lists,
+// which is where testing them a block at a time pays off
+//
+// checks, exiting with 1 if any fails:
+//   every formulation finds exactly the same contacts in the scene
+//   --boundary random pairs placed within 1e-5 of touching (radii up to 200,
+//   positions up to 4096): no pair the exact test says touches is ruled out
+//   by any kernel
+//   trajectories: --steps steps of the full simulation (original and impulse
+//   response) with batchedPairTests off and then on with every kernel end up
+//   bit for bit the same, step by step
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../BubblePhysics.h"
+#include "../BubblePairs.h"
+#include "../FrameStats.h"
+
+const int MAX_KERNELS = 3;
+
+struct PAIR_OPTIONS {
+    int bubbles;
+    int width;
+    int height;
+    unsigned int seed;
+    int reps;
+    int steps;
+    int boundary;
+    bool impulse;
+    RADIUS_DISTRIBUTION radiusDistribution;
+    float minRadius;
+    float maxRadius;
+};
+
+// every bubble's candidate list, back to back
+struct PAIR_LISTS {
+    int* start; // bubble i's candidates are candidates[start[i], start[i + 1])
+    int* candidates;
+    long long pairs;
+};
+
+struct PAIR_RESULT {
+    long long nanos; // fastest rep
+    long long exactTests; // pairs that went on to the square root test
+    long long hits;
+    unsigned int hitHash;
+};
+
+static volatile unsigned int sink;
+
+static unsigned int hashHit(unsigned int hash, int a, int b)
+{
+    return (hash ^ (unsigned int) (a * 40503 + b)) * 16777619u;
+}
+
+static void collectCandidates(PAIR_LISTS* lists)
+{
+    int* scratch = (int*) malloc(sizeof(int) * numBubbles);
+    lists->start = (int*) malloc(sizeof(int) * (numBubbles + 1));
+
+    // two passes, count then fill
+    lists->pairs = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        long long total = 0;
+        for (int i = 0; i < numBubbles; i++) {
+            const BUBBLE* b = &bubbles[i];
+            float velLength = sqrtf(b->xVel * b->xVel + b->yVel * b->yVel);
+            // the same query collisionCheck starts with
+            int count = bubbleGridQuery(&bubbleGrid, b->x, b->y, b->r + velLength * 2 + 1, scratch);
+            if (pass == 0) {
+                lists->start[i] = (int) total;
+            } else {
+                int k = lists->start[i];
+                for (int c = 0; c < count; c++) {
+                    if (scratch[c] != i)
+                        lists->candidates[k++] = scratch[c];
+                }
+            }
+            for (int c = 0; c < count; c++)
+                total += scratch[c] != i;
+        }
+        if (pass == 0) {
+            lists->start[numBubbles] = (int) total;
+            lists->pairs = total;
+            lists->candidates = (int*) malloc(sizeof(int) * (total > 0 ? total : 1));
+        }
+    }
+
+    free(scratch);
+}
+
+// the contact test from before the early-out, speed and distance worked out for every pair
+static bool originalHit(const BUBBLE* b, const BUBBLE* other)
+{
+    float velLength = sqrt(pow(b->xVel, 2) + pow(b->yVel, 2));
+    return sqrt(pow((b->x - other->x), 2) + pow((b->y - other->y), 2)) < (b->r + other->r + velLength);
+}
+
+static bool exactHit(const BUBBLE* b, const BUBBLE* other, float velLength)
+{
+    return sqrt(pow((b->x - other->x), 2) + pow((b->y - other->y), 2)) < (b->r + other->r + velLength);
+}
+
+enum FORMULATION { FORM_ORIGINAL, FORM_SQUARED, FORM_BLOCK };
+
+static void runPass(const PAIR_LISTS* lists, FORMULATION form, PAIR_RESULT* r)
+{
+    r->exactTests = 0;
+    r->hits = 0;
+    r->hitHash = 2166136261u;
+
+    for (int i = 0; i < numBubbles; i++) {
+        const BUBBLE* b = &bubbles[i];
+        const int* list = lists->candidates + lists->start[i];
+        int count = lists->start[i + 1] - lists->start[i];
+
+        if (form == FORM_ORIGINAL) {
+            for (int c = 0; c < count; c++) {
+                r->exactTests++;
+                if (originalHit(b, &bubbles[list[c]])) {
+                    r->hits++;
+                    r->hitHash = hashHit(r->hitHash, i, list[c]);
+                }
+            }
+            continue;
+        }
+
+        float velLength = sqrt(pow(b->xVel, 2) + pow(b->yVel, 2));
+        if (form == FORM_SQUARED) {
+            for (int c = 0; c < count; c++) {
+                const BUBBLE* other = &bubbles[list[c]];
+                float dx = b->x - other->x;
+                float dy = b->y - other->y;
+                float reach = b->r + other->r + velLength;
+                if (dx * dx + dy * dy > reach * reach * PAIR_TEST_MARGIN)
+                    continue;
+                r->exactTests++;
+                if (exactHit(b, other, velLength)) {
+                    r->hits++;
+                    r->hitHash = hashHit(r->hitHash, i, list[c]);
+                }
+            }
+            continue;
+        }
+
+        for (int begin = 0; begin < count; begin += PAIR_BLOCK) {
+            int n = count - begin < PAIR_BLOCK ? count - begin : PAIR_BLOCK;
+            unsigned int near = pairTestBlock(bubbles, list + begin, n, b->x, b->y, b->r + velLength);
+            while (near) {
+                int c = begin + __builtin_ctz(near);
+                near &= near - 1;
+                r->exactTests++;
+                if (exactHit(b, &bubbles[list[c]], velLength)) {
+                    r->hits++;
+                    r->hitHash = hashHit(r->hitHash, i, list[c]);
+                }
+            }
+        }
+    }
+}
+
+static PAIR_RESULT timeFormulation(const PAIR_LISTS* lists, FORMULATION form, int reps)
+{
+    PAIR_RESULT r = {};
+    r.nanos = -1;
+    for (int rep = 0; rep < reps; rep++) {
+        long long start = nowNanos();
+        runPass(lists, form, &r);
+        long long nanos = nowNanos() - start;
+        if (r.nanos < 0 || nanos < r.nanos)
+            r.nanos = nanos;
+    }
+    sink = r.hitHash;
+    return r;
+}
+
+//=======================Boundary pairs=====================
+
+static unsigned int benchRandomState;
+
+static float randomFloat(float range)
+{
+    benchRandomState ^= benchRandomState << 13;
+    benchRandomState ^= benchRandomState >> 17;
+    benchRandomState ^= benchRandomState << 5;
+    return (benchRandomState >> 8) * (range / 16777216.0f);
+}
+
+// pairs a hair either side of touching, for both responses' tests
+static long long boundaryMisses(int pairs, const PAIR_KERNEL* kernels, int numKernels, long long* exactHits)
+{
+    BUBBLE* others = (BUBBLE*) calloc(PAIR_BLOCK, sizeof(BUBBLE));
+    int index[PAIR_BLOCK];
+    for (int k = 0; k < PAIR_BLOCK; k++)
+        index[k] = k;
+
+    long long missed = 0;
+    *exactHits = 0;
+    for (int done = 0; done < pairs; done += PAIR_BLOCK) {
+        BUBBLE b = {};
+        b.x = randomFloat(4096);
+        b.y = randomFloat(4096);
+        b.r = 1 + randomFloat(199);
+        b.xVel = randomFloat(20) - 10;
+        b.yVel = randomFloat(20) - 10;
+        bool impulse = (done / PAIR_BLOCK) & 1;
+        float velLength = impulse ? 0 : sqrt(pow(b.xVel, 2) + pow(b.yVel, 2));
+
+        for (int k = 0; k < PAIR_BLOCK; k++) {
+            BUBBLE* o = &others[k];
+            o->r = 1 + randomFloat(199);
+            float angle = randomFloat(6.2831853f);
+            float distance = (b.r + o->r + velLength) * (1 + (randomFloat(2) - 1) * 1e-5f);
+            o->x = b.x + cosf(angle) * distance;
+            o->y = b.y + sinf(angle) * distance;
+        }
+
+        unsigned int touching = 0;
+        for (int k = 0; k < PAIR_BLOCK; k++) {
+            const BUBBLE* o = &others[k];
+            bool hit;
+            if (impulse) {
+                float dx = b.x - o->x;
+                float dy = b.y - o->y;
+                float reach = b.r + o->r;
+                hit = dx * dx + dy * dy < reach * reach;
+            } else {
+                hit = exactHit(&b, o, velLength);
+            }
+            if (hit) {
+                touching |= 1u << k;
+                (*exactHits)++;
+            }
+        }
+
+        for (int k = 0; k < numKernels; k++) {
+            usePairKernel(kernels[k]);
+            unsigned int near = pairTestBlock(others, index, PAIR_BLOCK, b.x, b.y, b.r + velLength);
+            missed += __builtin_popcount(touching & ~near);
+        }
+    }
+
+    free(others);
+    return missed;
+}
+
+//=======================Trajectories=====================
+
+static unsigned int stateHash()
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < numBubbles; i++) {
+        float values[4] = { bubbles[i].x, bubbles[i].y, bubbles[i].xVel, bubbles[i].yVel };
+        const unsigned char* bytes = (const unsigned char*) values;
+        for (int k = 0; k < (int) sizeof(values); k++)
+            hash = (hash ^ bytes[k]) * 16777619u;
+    }
+    return hash;
+}
+
+static void startScene(const PAIR_OPTIONS* opt, bool impulse)
+{
+    worldWidth = opt->width;
+    worldHeight = opt->height;
+    BUBBLE_RADIUS = scaledBubbleRadius(opt->width, opt->height, opt->bubbles);
+    radiusDistribution = opt->radiusDistribution;
+    minBubbleRadius = opt->minRadius > 0 ? opt->minRadius : BUBBLE_RADIUS / 10.0f;
+    maxBubbleRadius = opt->maxRadius > 0 ? opt->maxRadius : BUBBLE_RADIUS * 10.0f;
+    if (minBubbleRadius < 1)
+        minBubbleRadius = 1;
+    impulseResponse = impulse;
+    seedBubbleRandom(opt->seed);
+    initializeBubbles(opt->bubbles);
+    // something other than everyone moving right at 0.5
+    for (int i = 0; i < numBubbles; i++) {
+        bubbles[i].xVel = (int) (bubbleRandom() % 2001 - 1000) / 250.0f;
+        bubbles[i].yVel = (int) (bubbleRandom() % 2001 - 1000) / 250.0f;
+    }
+}
+
+// steps where any run's state differed from the one without batching
+static int trajectoryDivergence(const PAIR_OPTIONS* opt, bool impulse, const PAIR_KERNEL* kernels, int numKernels, float* maxError)
+{
+    unsigned int* reference = (unsigned int*) malloc(sizeof(unsigned int) * opt->steps);
+    BUBBLE* final = (BUBBLE*) malloc(sizeof(BUBBLE) * opt->bubbles);
+
+    batchedPairTests = false;
+    startScene(opt, impulse);
+    for (int s = 0; s < opt->steps; s++) {
+        stepBubbles();
+        reference[s] = stateHash();
+    }
+    memcpy(final, bubbles, sizeof(BUBBLE) * numBubbles);
+
+    int diverged = 0;
+    *maxError = 0;
+    for (int k = 0; k < numKernels; k++) {
+        usePairKernel(kernels[k]);
+        batchedPairTests = true;
+        startScene(opt, impulse);
+        for (int s = 0; s < opt->steps; s++) {
+            stepBubbles();
+            if (stateHash() != reference[s])
+                diverged++;
+        }
+        for (int i = 0; i < numBubbles; i++) {
+            float e = fmaxf(fabsf(bubbles[i].x - final[i].x), fabsf(bubbles[i].y - final[i].y));
+            if (e > *maxError)
+                *maxError = e;
+        }
+    }
+
+    free(reference);
+    free(final);
+    return diverged;
+}
+
+static const char* kernelName(PAIR_KERNEL kernel)
+{
+    usePairKernel(kernel);
+    return pairKernelName();
+}
+
+static void printResult(const char* name, const PAIR_RESULT* r, const PAIR_LISTS* lists, int bubbleCount, bool last)
+{
+    printf("    \"%s\": {\"ns_per_pair\": %.3f, \"ns_per_bubble\": %.3f, \"exact_tests\": %lld, \"hits\": %lld}%s\n",
+        name, (double) r->nanos / (lists->pairs > 0 ? lists->pairs : 1), (double) r->nanos / bubbleCount,
+        r->exactTests, r->hits, last ? "" : ",");
+}
+
+int main(int argc, char** argv)
+{
+    PAIR_OPTIONS opt = { 10000, 1920, 1080, 1, 20, 300, 1000000, false, RADIUS_FIXED, 0, 0 };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (!strcmp(argv[i], "--bubbles")) opt.bubbles = atoi(value);
+        else if (!strcmp(argv[i], "--width")) opt.width = atoi(value);
+        else if (!strcmp(argv[i], "--height")) opt.height = atoi(value);
+        else if (!strcmp(argv[i], "--seed")) opt.seed = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i], "--reps")) opt.reps = atoi(value);
+        else if (!strcmp(argv[i], "--steps")) opt.steps = atoi(value);
+        else if (!strcmp(argv[i], "--boundary")) opt.boundary = atoi(value);
+        else if (!strcmp(argv[i], "--impulse")) opt.impulse = atoi(value) != 0;
+        else if (!strcmp(argv[i], "--min-radius")) opt.minRadius = (float) atof(value);
+        else if (!strcmp(argv[i], "--max-radius")) opt.maxRadius = (float) atof(value);
+        else if (!strcmp(argv[i], "--radius-dist")) {
+            if (!parseRadiusDistribution(value, &opt.radiusDistribution)) {
+                fprintf(stderr, "unknown radius distribution %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opt.bubbles < 1 || opt.width <= 0 || opt.height <= 0 || opt.reps < 1 || opt.steps < 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    PAIR_KERNEL kernels[MAX_KERNELS];
+    int numKernels = 0;
+    const PAIR_KERNEL all[MAX_KERNELS] = { PAIR_KERNEL_SCALAR, PAIR_KERNEL_SSE2, PAIR_KERNEL_AVX2 };
+    for (int k = 0; k < MAX_KERNELS; k++) {
+        if (usePairKernel(all[k]))
+            kernels[numKernels++] = all[k];
+    }
+
+    if (!allocateBubbles(opt.bubbles)) {
+        fprintf(stderr, "out of memory for %d bubbles\n", opt.bubbles);
+        return 1;
+    }
+
+    // a scene that has had time to bump into itself
+    startScene(&opt, opt.impulse);
+    for (int s = 0; s < 60; s++)
+        stepBubbles();
+
+    PAIR_LISTS lists;
+    collectCandidates(&lists);
+
+    PAIR_RESULT original = timeFormulation(&lists, FORM_ORIGINAL, opt.reps);
+    PAIR_RESULT squared = timeFormulation(&lists, FORM_SQUARED, opt.reps);
+    PAIR_RESULT blocks[MAX_KERNELS];
+    for (int k = 0; k < numKernels; k++) {
+        usePairKernel(kernels[k]);
+        blocks[k] = timeFormulation(&lists, FORM_BLOCK, opt.reps);
+    }
+
+    bool ok = squared.hits == original.hits && squared.hitHash == original.hitHash;
+    for (int k = 0; k < numKernels; k++)
+        ok = ok && blocks[k].hits == original.hits && blocks[k].hitHash == original.hitHash;
+
+    printf("{\n  \"bubbles\": %d, \"width\": %d, \"height\": %d, \"radius\": %d, \"radius_dist\": \"%s\", \"candidate_pairs\": %lld,\n",
+        opt.bubbles, opt.width, opt.height, BUBBLE_RADIUS, radiusDistributionName(radiusDistribution), lists.pairs);
+    printf("  \"results\": {\n");
+    printResult("original", &original, &lists, opt.bubbles, false);
+    printResult("squared", &squared, &lists, opt.bubbles, numKernels == 0);
+    for (int k = 0; k < numKernels; k++) {
+        char name[32];
+        snprintf(name, sizeof(name), "block_%s", kernelName(kernels[k]));
+        printResult(name, &blocks[k], &lists, opt.bubbles, k == numKernels - 1);
+    }
+    printf("  },\n  \"same_contacts\": %s,\n", ok ? "true" : "false");
+
+    benchRandomState = opt.seed ? opt.seed : 1;
+    long long boundaryHits;
+    long long missed = boundaryMisses(opt.boundary, kernels, numKernels, &boundaryHits);
+    printf("  \"boundary\": {\"pairs\": %d, \"touching\": %lld, \"missed\": %lld},\n", opt.boundary, boundaryHits, missed);
+    ok = ok && missed == 0;
+
+    float originalError, impulseError;
+    int originalDiverged = trajectoryDivergence(&opt, false, kernels, numKernels, &originalError);
+    int impulseDiverged = trajectoryDivergence(&opt, true, kernels, numKernels, &impulseError);
+    printf("  \"trajectories\": {\"steps\": %d, \"kernels\": %d, \"original_diverged_steps\": %d, \"original_max_error\": %g, "
+        "\"impulse_diverged_steps\": %d, \"impulse_max_error\": %g}\n}\n",
+        opt.steps, numKernels, originalDiverged, originalError, impulseDiverged, impulseError);
+    ok = ok && originalDiverged == 0 && impulseDiverged == 0;
+
+    free(lists.start);
+    free(lists.candidates);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,373 @@
+// headless benchmark for the circle rasterizers
+// draws the same random circles with drawCircleAA and with a BubbleSprites atlas
+// into two plain framebuffers and reports, as JSON, the cost per circle of each
+// and how far apart the results are
+//
+// usage: RasterBench [--width 1920] [--height 1080] [--circles 100000]
+//                    [--radius 10] [--seed 1] [--snap 1]
+//
+// with --snap 1 the centres are put on the sprites' phase grid so the two
+// should agree to within a level per channel (max_diff <= 1), without it
+// max_diff also includes the up to 1/8 pixel the sprites move each centre by
+//
+// checks, exiting with 1 if any fails:
+//   with --snap 1 a single circle's sprite is within a level of drawCircleAA
+//   drawing the colour key (black) with hard edges, by drawCircleHard or a hard
+//   sprite, leaves every pixel either untouched or exactly the key (key_blends,
+//   which drawCircleAA is reported against for comparison, has to be 0), and
+//   the two agree pixel for pixel on the phase grid
+//   bubbles moving for a while and redrawn only in their dirty rects end up
+//   with the same frame as drawing everything again every frame, with the
+//   draw list and without it, blended and hard
+//   circles of a thousand different radii all get a sprite (from the radius
+//   buckets), none of them draws outside its circleBounds and none is further
+//   from drawCircleAA than the edge being 0.43 px off allows (bucket_max_diff)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../BubbleRaster.h"
+#include "../BubbleSprites.h"
+#include "../FrameStats.h"
+
+// coverage falls 256 levels over a pixel of edge, so an edge 0.43 px off (see
+// BubbleSprites.h) is up to 110 levels out, and one more for rounding
+const int BUCKET_MAX_DIFF = 111;
+
+static unsigned int rasterRandomState;
+
+static float randomFloat(float range)
+{
+    rasterRandomState ^= rasterRandomState << 13;
+    rasterRandomState ^= rasterRandomState >> 17;
+    rasterRandomState ^= rasterRandomState << 5;
+    return (rasterRandomState >> 8) * (range / 16777216.0f);
+}
+
+// a gradient so the blend has something to mix with
+static void fillGradient(FRAMEBUFFER* fb)
+{
+    for (int y = 0; y < fb->height; y++) {
+        for (int x = 0; x < fb->width; x++)
+            fb->pixels[y * fb->stride + x] = ((x & 0xff) << 16) | ((y & 0xff) << 8) | ((x + y) & 0xff);
+    }
+}
+
+static void initFramebuffer(FRAMEBUFFER* fb, int width, int height)
+{
+    fb->width = width;
+    fb->height = height;
+    fb->stride = width;
+    fb->pixels = (uint32_t*) malloc(sizeof(uint32_t) * width * height);
+    fillGradient(fb);
+}
+
+// pixels of fb that are neither what background had nor exactly key
+static long long countKeyBlends(const FRAMEBUFFER* fb, const FRAMEBUFFER* background, uint32_t key)
+{
+    long long blends = 0;
+    for (int i = 0; i < fb->width * fb->height; i++) {
+        if (fb->pixels[i] != background->pixels[i] && fb->pixels[i] != key)
+            blends++;
+    }
+    return blends;
+}
+
+// random bubbles drifting around, redrawn from their dirty rects every frame
+// and compared with a full redraw. returns the pixels that differed
+static long long checkDirtyRedraw(int width, int height, bool hardEdges, bool drawList, SPRITE_ATLAS* atlas)
+{
+    const int count = 200;
+    const int frames = 60;
+    FRAMEBUFFER background, partial, full;
+    initFramebuffer(&background, width, height);
+    initFramebuffer(&partial, width, height);
+    initFramebuffer(&full, width, height);
+
+    BUBBLE_SNAPSHOT snap;
+    initBubbleSnapshot(&snap, count);
+    snap.count = count;
+    BUBBLE_DRAWN* drawn = (BUBBLE_DRAWN*) calloc(count, sizeof(BUBBLE_DRAWN));
+    BUBBLE_DRAWN* list = (BUBBLE_DRAWN*) malloc(sizeof(BUBBLE_DRAWN) * count);
+    int drawnCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        BUBBLE* b = &snap.bubbles[i];
+        memset(b, 0, sizeof(BUBBLE));
+        b->x = b->prevX = randomFloat((float) width);
+        b->y = b->prevY = randomFloat((float) height);
+        b->r = 2 + randomFloat(30);
+        // some stand still, so not everything is dirty every frame
+        if (i % 3) {
+            b->xVel = randomFloat(8) - 4;
+            b->yVel = randomFloat(8) - 4;
+        }
+    }
+
+    DIRTY_RECTS dirty;
+    DIRTY_RECTS all;
+    clearDirtyRects(&all);
+    markAllDirty(&all, width, height);
+    long long differing = 0;
+    uint32_t color = hardEdges ? 0 : 0x40a0ff;
+
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < count; i++) {
+            BUBBLE* b = &snap.bubbles[i];
+            b->prevX = b->x;
+            b->prevY = b->y;
+            b->x += b->xVel;
+            b->y += b->yVel;
+        }
+        // one goes away and comes back, so removed bubbles get erased too
+        snap.count = f % 20 == 10 ? count - 1 : count;
+        float alpha = (f % 4) / 4.0f;
+
+        clearDirtyRects(&dirty);
+        if (f == 0)
+            markAllDirty(&dirty, width, height);
+        markBubbleDirtyRects(&dirty, drawn, &drawnCount, &snap, alpha, width, height);
+        restoreDirtyRects(&partial, &background, &dirty);
+        if (drawList) {
+            int listed = listBubblesInDirtyRects(list, &dirty, drawn, drawnCount);
+            drawBubbleList(&partial, &dirty, list, listed, color, hardEdges, atlas);
+        } else {
+            drawBubblesInDirtyRects(&partial, &dirty, &snap, alpha, color, hardEdges, atlas);
+        }
+
+        redrawDirtyRects(&full, &background, &all, &snap, alpha, color, hardEdges, atlas);
+        for (int i = 0; i < width * height; i++)
+            differing += partial.pixels[i] != full.pixels[i];
+    }
+
+    free(list);
+    free(drawn);
+    freeBubbleSnapshot(&snap);
+    free(background.pixels);
+    free(partial.pixels);
+    free(full.pixels);
+    return differing;
+}
+
+static int channelDiff(uint32_t a, uint32_t b)
+{
+    int worst = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int d = (int) ((a >> shift) & 0xff) - (int) ((b >> shift) & 0xff);
+        if (d < 0)
+            d = -d;
+        if (d > worst)
+            worst = d;
+    }
+    return worst;
+}
+
+// circles of count random radii (and centres) drawn from one atlas, each on a
+// cleared patch. returns the pixels drawn outside circleBounds, *misses gets
+// the circles that had no sprite and *maxDiff the furthest any was from drawCircleAA
+static long long checkRadiusBuckets(int count, SPRITE_ATLAS* atlas, int* misses, int* maxDiff)
+{
+    const int size = 2 * 48 + 8;
+    FRAMEBUFFER sprite, reference;
+    initFramebuffer(&sprite, size, size);
+    initFramebuffer(&reference, size, size);
+    DIRTY_RECT all = { 0, 0, size, size };
+    long long outside = 0;
+    *misses = 0;
+    *maxDiff = 0;
+
+    for (int i = 0; i < count; i++) {
+        float r = 0.5f + randomFloat(47.5f);
+        float cx = size / 2 + randomFloat(1);
+        float cy = size / 2 + randomFloat(1);
+        fillRect(&sprite, all, 0);
+        fillRect(&reference, all, 0);
+
+        const CIRCLE_SPRITE* s = atlasSprite(atlas, r, false);
+        if (!s) {
+            (*misses)++;
+            continue;
+        }
+        drawCircleSprite(&sprite, s, cx, cy, 0xffffff, all);
+        drawCircleAA(&reference, cx, cy, r, 0xffffff, all);
+
+        DIRTY_RECT bounds = circleBounds(cx, cy, r);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                uint32_t p = sprite.pixels[y * size + x];
+                if (p && (x < bounds.left || x >= bounds.right || y < bounds.top || y >= bounds.bottom))
+                    outside++;
+                int d = channelDiff(p, reference.pixels[y * size + x]);
+                if (d > *maxDiff)
+                    *maxDiff = d;
+            }
+        }
+    }
+
+    free(sprite.pixels);
+    free(reference.pixels);
+    return outside;
+}
+
+int main(int argc, char** argv)
+{
+    int width = 1920;
+    int height = 1080;
+    int circles = 100000;
+    float radius = 10;
+    unsigned int seed = 1;
+    bool snap = true;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--width")) width = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--height")) height = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--circles")) circles = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--radius")) radius = (float) atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], NULL, 10);
+        else if (!strcmp(argv[i], "--snap")) snap = atoi(argv[i + 1]) != 0;
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || circles <= 0 || radius <= 0) {
+        fprintf(stderr, "bad size\n");
+        return 1;
+    }
+
+    float* centres = (float*) malloc(sizeof(float) * 2 * circles);
+    rasterRandomState = seed ? seed : 1;
+    for (int i = 0; i < circles; i++) {
+        float x = randomFloat((float) width);
+        float y = randomFloat((float) height);
+        if (snap) {
+            x = (int) (x * SPRITE_PHASES) / (float) SPRITE_PHASES;
+            y = (int) (y * SPRITE_PHASES) / (float) SPRITE_PHASES;
+        }
+        centres[2 * i] = x;
+        centres[2 * i + 1] = y;
+    }
+
+    FRAMEBUFFER reference, sprites;
+    initFramebuffer(&reference, width, height);
+    initFramebuffer(&sprites, width, height);
+    DIRTY_RECT all = { 0, 0, width, height };
+    uint32_t color = 0x40a0ff;
+
+    long long t0 = nowNanos();
+    for (int i = 0; i < circles; i++)
+        drawCircleAA(&reference, centres[2 * i], centres[2 * i + 1], radius, color, all);
+    long long referenceNanos = nowNanos() - t0;
+
+    SPRITE_ATLAS atlas;
+    initSpriteAtlas(&atlas);
+    t0 = nowNanos();
+    const CIRCLE_SPRITE* sprite = atlasSprite(&atlas, radius, false);
+    long long buildNanos = nowNanos() - t0;
+    if (!sprite) {
+        fprintf(stderr, "radius %g is too big for the atlas\n", radius);
+        return 1;
+    }
+
+    t0 = nowNanos();
+    for (int i = 0; i < circles; i++)
+        drawCircleSprite(&sprites, sprite, centres[2 * i], centres[2 * i + 1], color, all);
+    long long spriteNanos = nowNanos() - t0;
+
+    int maxDiff = 0;
+    long long pixelsDiffering = 0;
+    for (int i = 0; i < width * height; i++) {
+        int d = channelDiff(reference.pixels[i], sprites.pixels[i]);
+        if (d > maxDiff)
+            maxDiff = d;
+        if (d)
+            pixelsDiffering++;
+    }
+
+    // overlapping circles compound the rounding and mostly end up fully covered,
+    // so also measure a single circle's worth by drawing some of them again on
+    // a fresh background
+    fillGradient(&reference);
+    fillGradient(&sprites);
+    int maxSingleDiff = 0;
+    int singles = circles < 1000 ? circles : 1000;
+    for (int i = 0; i < singles; i++) {
+        DIRTY_RECT rect = circleBounds(centres[2 * i], centres[2 * i + 1], radius);
+        DIRTY_RECT grown = { rect.left - 1, rect.top - 1, rect.right + 1, rect.bottom + 1 };
+        drawCircleAA(&reference, centres[2 * i], centres[2 * i + 1], radius, color, all);
+        drawCircleSprite(&sprites, sprite, centres[2 * i], centres[2 * i + 1], color, all);
+        for (int y = grown.top < 0 ? 0 : grown.top; y < grown.bottom && y < height; y++) {
+            for (int x = grown.left < 0 ? 0 : grown.left; x < grown.right && x < width; x++) {
+                int d = channelDiff(reference.pixels[y * width + x], sprites.pixels[y * width + x]);
+                if (d > maxSingleDiff)
+                    maxSingleDiff = d;
+            }
+        }
+        copyRect(&reference, &sprites, grown);
+    }
+
+    printf("{\"width\": %d, \"height\": %d, \"circles\": %d, \"radius\": %g, \"snap\": %s, \"kernel\": \"%s\", ",
+        width, height, circles, radius, snap ? "true" : "false", spriteKernelName());
+    printf("\"reference_ns_per_circle\": %.1f, \"sprite_ns_per_circle\": %.1f, \"speedup\": %.2f, \"atlas_build_us\": %.1f, ",
+        (double) referenceNanos / circles, (double) spriteNanos / circles,
+        spriteNanos ? (double) referenceNanos / spriteNanos : 0.0, buildNanos / 1000.0);
+    // the colour key drawn three ways over the same background, on the phase grid
+    FRAMEBUFFER background;
+    initFramebuffer(&background, width, height);
+    fillGradient(&reference);
+    fillGradient(&sprites);
+    const CIRCLE_SPRITE* hardSprite = atlasSprite(&atlas, radius, true);
+    int keyCircles = circles < 1000 ? circles : 1000;
+    for (int i = 0; i < keyCircles; i++) {
+        float x = (int) (centres[2 * i] * SPRITE_PHASES) / (float) SPRITE_PHASES;
+        float y = (int) (centres[2 * i + 1] * SPRITE_PHASES) / (float) SPRITE_PHASES;
+        drawCircleHard(&reference, x, y, radius, 0, all);
+        drawCircleSprite(&sprites, hardSprite, x, y, 0, all);
+    }
+    long long hardBlends = countKeyBlends(&reference, &background, 0) + countKeyBlends(&sprites, &background, 0);
+    long long hardDiffering = 0;
+    for (int i = 0; i < width * height; i++)
+        hardDiffering += reference.pixels[i] != sprites.pixels[i];
+    fillGradient(&reference);
+    for (int i = 0; i < keyCircles; i++)
+        drawCircleAA(&reference, centres[2 * i], centres[2 * i + 1], radius, 0, all);
+    long long aaBlends = countKeyBlends(&reference, &background, 0);
+    free(background.pixels);
+
+    // smaller frames, the full redraws add up
+    long long redrawDiffering = 0;
+    SPRITE_ATLAS redrawAtlas;
+    initSpriteAtlas(&redrawAtlas);
+    for (int hard = 0; hard < 2; hard++) {
+        for (int drawList = 0; drawList < 2; drawList++) {
+            redrawDiffering += checkDirtyRedraw(320, 240, hard, drawList, NULL);
+            redrawDiffering += checkDirtyRedraw(320, 240, hard, drawList, &redrawAtlas);
+        }
+    }
+    freeSpriteAtlas(&redrawAtlas);
+
+    SPRITE_ATLAS bucketAtlas;
+    initSpriteAtlas(&bucketAtlas);
+    int bucketMisses, bucketMaxDiff;
+    long long bucketOutside = checkRadiusBuckets(1000, &bucketAtlas, &bucketMisses, &bucketMaxDiff);
+    int bucketSprites = bucketAtlas.count;
+    size_t bucketBytes = spriteAtlasBytes(&bucketAtlas);
+    freeSpriteAtlas(&bucketAtlas);
+
+    printf("\"max_diff\": %d, \"pixels_differing\": %lld, \"max_diff_single\": %d, ",
+        maxDiff, pixelsDiffering, maxSingleDiff);
+    printf("\"key_blends\": %lld, \"key_blends_aa\": %lld, \"hard_sprite_differing\": %lld, \"redraw_differing\": %lld, ",
+        hardBlends, aaBlends, hardDiffering, redrawDiffering);
+    printf("\"bucket_sprites\": %d, \"bucket_atlas_kb\": %zu, \"bucket_misses\": %d, \"bucket_outside_bounds\": %lld, \"bucket_max_diff\": %d}\n",
+        bucketSprites, bucketBytes / 1024, bucketMisses, bucketOutside, bucketMaxDiff);
+
+    bool ok = (!snap || maxSingleDiff <= 1) && hardBlends == 0 && hardDiffering == 0 && redrawDiffering == 0
+        && bucketMisses == 0 && bucketOutside == 0 && bucketMaxDiff <= BUCKET_MAX_DIFF;
+
+    freeSpriteAtlas(&atlas);
+    free(reference.pixels);
+    free(sprites.pixels);
+    free(centres);
+    return ok ? 0 : 1;
+}